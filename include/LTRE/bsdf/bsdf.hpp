@@ -1,18 +1,22 @@
 #ifndef _LTRE_BSDF_H
 #define _LTRE_BSDF_H
-#include <memory>
-
 #include "LTRE/bsdf/bxdf/bxdf.hpp"
+#include "LTRE/core/memory-arena.hpp"
 
 namespace LTRE {
 
+// storage of BxDFs and their Fresnel terms and microfacet distributions
+// NOTE: enough for the largest material(DisneyPrincipledBRDF)
+using BSDFArena = MemoryArena<1024>;
+
 // TODO: handle BTDF case
+// NOTE: BxDFs are not owned, they must outlive BSDF(e.g. created in BSDFArena)
 class BSDF {
  private:
   static constexpr int MAX_NUM_BXDFS = 8;
 
   int nBxDF;
-  std::shared_ptr<BxDF> bxdfs[MAX_NUM_BXDFS];
+  const BxDF* bxdfs[MAX_NUM_BXDFS];
   float coefficients[MAX_NUM_BXDFS];
 
  public:
@@ -20,7 +24,7 @@ class BSDF {
 
   void reset();
 
-  void add(const std::shared_ptr<BxDF>& bxdf, float coefficient);
+  void add(const BxDF* bxdf, float coefficient);
 
   Vec3 f(const Vec3& wo, const Vec3& wi) const;
   Vec3 sample(Sampler& sampler, const Vec3& wo, Vec3& wi, float& pdf) const;
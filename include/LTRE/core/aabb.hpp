@@ -1,11 +1,21 @@
 #ifndef _LTRE_AABB_H
 #define _LTRE_AABB_H
 
+#include <limits>
+
 #include "LTRE/core/ray.hpp"
 #include "LTRE/math/vec3.hpp"
 
 namespace LTRE {
 
+// far distance of slab test is scaled by 1 + 2 * gamma(3), so that rounding
+// error never culls AABB which ray actually touches
+// https://jcgt.org/published/0002/02/02/
+inline constexpr float SLAB_FAR_SCALE = [] {
+  constexpr float eps = 0.5f * std::numeric_limits<float>::epsilon();
+  return 1.0f + 2.0f * (3.0f * eps) / (1.0f - 3.0f * eps);
+}();
+
 struct AABB {
   Vec3 bounds[2];
 
@@ -16,15 +26,25 @@ struct AABB {
 
   int longestAxis() const;
 
+  // true if this AABB contains no point
+  bool isEmpty() const;
+
   float surfaceArea() const;
 
   bool intersect(const Ray& ray, const Vec3& dirInv,
                  const int dirInvSign[3]) const;
+
+  // same as above, but also returns the distance where ray enters this AABB
+  bool intersect(const Ray& ray, const Vec3& dirInv, const int dirInvSign[3],
+                 float& tEntry) const;
 };
 
 AABB mergeAABB(const AABB& bbox, const Vec3& p);
 AABB mergeAABB(const AABB& bbox1, const AABB& bbox2);
 
+// AABB of region shared by both AABBs, empty if they don't overlap
+AABB overlapAABB(const AABB& bbox1, const AABB& bbox2);
+
 std::ostream& operator<<(std::ostream& stream, const AABB& bbox);
 
 }  // namespace LTRE
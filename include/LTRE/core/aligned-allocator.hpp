@@ -0,0 +1,41 @@
+#ifndef _LTRE_ALIGNED_ALLOCATOR_H
+#define _LTRE_ALIGNED_ALLOCATOR_H
+#include <cstddef>
+#include <new>
+
+namespace LTRE {
+
+// allocator which aligns storage to ALIGNMENT bytes, used when alignment
+// stronger than the element type is needed(e.g. pairs of elements sharing a
+// cache line)
+template <typename T, std::size_t ALIGNMENT>
+struct AlignedAllocator {
+  using value_type = T;
+
+  template <typename U>
+  struct rebind {
+    using other = AlignedAllocator<U, ALIGNMENT>;
+  };
+
+  AlignedAllocator() noexcept {}
+  template <typename U>
+  AlignedAllocator(const AlignedAllocator<U, ALIGNMENT>&) noexcept {}
+
+  T* allocate(std::size_t n) {
+    return static_cast<T*>(
+        ::operator new(n * sizeof(T), std::align_val_t(ALIGNMENT)));
+  }
+
+  void deallocate(T* p, std::size_t) noexcept {
+    ::operator delete(p, std::align_val_t(ALIGNMENT));
+  }
+
+  template <typename U>
+  bool operator==(const AlignedAllocator<U, ALIGNMENT>&) const noexcept {
+    return true;
+  }
+};
+
+}  // namespace LTRE
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef _LTRE_ALLOCATION_COUNTER_H
+#define _LTRE_ALLOCATION_COUNTER_H
+#include <cstdint>
+
+namespace LTRE {
+
+// number of heap allocations, counted only when LTRE_COUNT_ALLOCATIONS is
+// defined
+// NOTE: when enabled, global operator new is replaced to count allocations of
+// each thread. it's meant for checking that render loop doesn't allocate
+class AllocationCounter {
+ public:
+#ifdef LTRE_COUNT_ALLOCATIONS
+  static constexpr bool ENABLED = true;
+#else
+  static constexpr bool ENABLED = false;
+#endif
+
+  // number of allocations made by calling thread so far
+  // NOTE: always 0 when disabled
+  static uint64_t count();
+};
+
+}  // namespace LTRE
+
+#endif
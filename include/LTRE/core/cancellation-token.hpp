@@ -0,0 +1,26 @@
+#ifndef _LTRE_CANCELLATION_TOKEN_H
+#define _LTRE_CANCELLATION_TOKEN_H
+#include <atomic>
+#include <memory>
+
+namespace LTRE {
+
+// flag to request cancellation of long running work(e.g. rendering) from
+// another thread, copies of token share the same flag
+class CancellationToken {
+ private:
+  std::shared_ptr<std::atomic<bool>> cancelled;
+
+ public:
+  CancellationToken() : cancelled{std::make_shared<std::atomic<bool>>(false)} {}
+
+  void cancel() const { cancelled->store(true, std::memory_order_relaxed); }
+
+  bool isCancelled() const {
+    return cancelled->load(std::memory_order_relaxed);
+  }
+};
+
+}  // namespace LTRE
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef _LTRE_FILM_H
+#define _LTRE_FILM_H
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "LTRE/core/image.hpp"
+#include "LTRE/core/tile-scheduler.hpp"
+#include "LTRE/math/vec3.hpp"
+
+namespace LTRE {
+
+// criterion of pixel convergence for adaptive sampling
+// pixel is converged when relative standard error of mean of its luminance is
+// below threshold
+struct ConvergenceCriterion {
+  float threshold{0.0f};  // 0 disables adaptive sampling
+  unsigned int minSamples{16};
+};
+
+// accumulation of radiance samples for progressive rendering, double
+// buffered so that image can be taken while rendering continues
+// render thread adds samples of a tile to back buffer, and publishes average
+// of the tile to front buffer when its pass is finished
+// NOTE: front buffer is locked for each tile, so that publish only contends
+// with snapshot copying the same tile
+class Film {
+ private:
+  struct Pixel {
+    Vec3 sum;  // sum of radiance
+    unsigned int nSamples{0};
+    // running mean and sum of squared deviations of luminance(Welford's
+    // algorithm)
+    float mean{0};
+    float m2{0};
+    bool converged{false};
+  };
+
+  unsigned int width;
+  unsigned int height;
+  ConvergenceCriterion criterion;
+
+  // NOTE: pixel is only touched by the thread rendering its tile
+  std::vector<Pixel> pixels;
+
+  // tiles which are published at once
+  std::vector<Tile> tiles;
+
+  // average radiance of published passes
+  Image<Vec3> published;
+  // NOTE: i-th mutex guards pixels of i-th tile in published
+  std::unique_ptr<std::mutex[]> tileMutexes;
+
+ public:
+  // tiles must cover the image without overlap
+  Film(unsigned int width, unsigned int height, const std::vector<Tile>& tiles);
+
+  void setConvergenceCriterion(const ConvergenceCriterion& criterion);
+
+  void clear();
+
+  // return true if the pixel is converged by this sample
+  bool addSample(unsigned int i, unsigned int j, const Vec3& radiance);
+
+  bool isConverged(unsigned int i, unsigned int j) const;
+
+  // copy average of each pixel of tileIdx-th tile into front buffer
+  void publish(std::size_t tileIdx);
+
+  // copy of front buffer
+  // NOTE: pixels may have different number of samples, pixels which are not
+  // published yet are black
+  Image<Vec3> snapshot() const;
+
+  // number of samples of each pixel
+  // NOTE: must not be called while rendering
+  Image<float> sampleCounts() const;
+};
+
+}  // namespace LTRE
+
+#endif
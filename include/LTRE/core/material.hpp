@@ -13,7 +13,9 @@ class Material {
  public:
   Material() {}
 
-  virtual BSDF prepareBSDF(const SurfaceInfo& info) const = 0;
+  // BxDFs of returned BSDF are created in arena
+  virtual BSDF prepareBSDF(const SurfaceInfo& info,
+                           BSDFArena& arena) const = 0;
   virtual Vec3 baseColor(const SurfaceInfo& info) const = 0;
 
   Vec3 f(const Vec3& wo, const Vec3& wi, const SurfaceInfo& info) const;
@@ -29,7 +31,7 @@ class Diffuse : public Material {
  public:
   Diffuse(const std::shared_ptr<Texture<Vec3>>& baseColor, float roughness);
 
-  BSDF prepareBSDF(const SurfaceInfo& info) const override;
+  BSDF prepareBSDF(const SurfaceInfo& info, BSDFArena& arena) const override;
   Vec3 baseColor(const SurfaceInfo& info) const override;
 };
 
@@ -41,7 +43,7 @@ class Metal : public Material {
  public:
   Metal(const std::shared_ptr<Texture<Vec3>>& baseColor, float roughness);
 
-  BSDF prepareBSDF(const SurfaceInfo& info) const override;
+  BSDF prepareBSDF(const SurfaceInfo& info, BSDFArena& arena) const override;
   Vec3 baseColor(const SurfaceInfo& info) const override;
 };
 
@@ -56,7 +58,7 @@ class Glass : public Material {
  public:
   Glass(float ior, float roughness);
 
-  BSDF prepareBSDF(const SurfaceInfo& info) const override;
+  BSDF prepareBSDF(const SurfaceInfo& info, BSDFArena& arena) const override;
   Vec3 baseColor(const SurfaceInfo& info) const override;
 };
 
@@ -80,7 +82,7 @@ class DisneyPrincipledBRDF : public Material {
                        float specularTint, float clearcoat,
                        float clearcoatGloss);
 
-  BSDF prepareBSDF(const SurfaceInfo& info) const override;
+  BSDF prepareBSDF(const SurfaceInfo& info, BSDFArena& arena) const override;
   Vec3 baseColor(const SurfaceInfo& info) const override;
 };
 
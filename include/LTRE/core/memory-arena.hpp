@@ -0,0 +1,52 @@
+#ifndef _LTRE_MEMORY_ARENA_H
+#define _LTRE_MEMORY_ARENA_H
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "spdlog/spdlog.h"
+
+namespace LTRE {
+
+// fixed capacity storage, objects are constructed in place one after another
+// and released all at once by reset()
+// NOTE: destructors are not called, so only trivially destructible objects
+// can be created
+template <std::size_t CAPACITY>
+class MemoryArena {
+ private:
+  alignas(std::max_align_t) std::byte buffer[CAPACITY];
+  std::size_t used{0};
+
+ public:
+  MemoryArena() {}
+
+  MemoryArena(const MemoryArena&) = delete;
+  MemoryArena& operator=(const MemoryArena&) = delete;
+
+  template <typename T, typename... Args>
+  T* create(Args&&... args) {
+    static_assert(std::is_trivially_destructible_v<T>,
+                  "destructor of object in arena is not called");
+    static_assert(alignof(T) <= alignof(std::max_align_t),
+                  "alignment of object in arena is too strong");
+
+    const std::size_t offset =
+        (used + alignof(T) - 1) / alignof(T) * alignof(T);
+    if (offset + sizeof(T) > CAPACITY) {
+      spdlog::error("[MemoryArena] capacity exceeded");
+      std::exit(EXIT_FAILURE);
+    }
+    used = offset + sizeof(T);
+    return new (buffer + offset) T(std::forward<Args>(args)...);
+  }
+
+  // release all objects
+  void reset() { used = 0; }
+};
+
+}  // namespace LTRE
+
+#endif
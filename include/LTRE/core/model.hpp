@@ -10,6 +10,7 @@
 //
 #include "LTRE/core/material.hpp"
 #include "LTRE/core/texture.hpp"
+#include "LTRE/core/transform.hpp"
 #include "LTRE/light/area-light.hpp"
 #include "LTRE/math/vec2.hpp"
 #include "LTRE/math/vec3.hpp"
@@ -21,8 +22,8 @@ class Model {
  private:
   void loadModel(const std::filesystem::path& filepath);
 
-  void processNode(const aiNode* node, const aiScene* scene,
-                   const std::filesystem::path& parentPath);
+  // collect instances of meshes from scene graph
+  void processNode(const aiNode* node, const Transform& parentTransform);
 
   void processMesh(const aiMesh* mesh, const aiScene* scene,
                    const std::filesystem::path& parentPath);
@@ -61,15 +62,26 @@ class Model {
     MaterialM() : shininess(0), reflectivity(0), ior(0) {}
   };
 
+  // mesh placed in the scene by transform of scene graph
+  struct MeshInstance {
+    unsigned int meshIdx;  // index of meshes
+    Transform transform;   // local to world transform
+  };
+
+  // NOTE: each mesh is loaded only once, and shared by its instances
   std::vector<std::shared_ptr<Mesh>> meshes;
   std::vector<MaterialM> materials;
   std::vector<std::shared_ptr<ImageTexture>> textures;
+  std::vector<MeshInstance> instances;
 
   Model();
   Model(const std::filesystem::path& filepath);
 
   std::shared_ptr<Material> createMaterial(unsigned int idx) const;
   std::shared_ptr<AreaLight> createAreaLight(unsigned int idx) const;
+  // create area light of the mesh, which emits light from given shape
+  std::shared_ptr<AreaLight> createAreaLight(
+      unsigned int idx, const std::shared_ptr<Shape>& shape) const;
 };
 
 }  // namespace LTRE
@@ -19,12 +19,22 @@ class Primitive {
             const std::shared_ptr<Material>& material,
             const std::shared_ptr<AreaLight>& areaLight = nullptr);
 
+  std::shared_ptr<Shape> getShapePtr() const;
   std::shared_ptr<AreaLight> getAreaLightPtr() const;
+  const Material* getMaterial() const;
   AABB aabb() const;
 
   bool intersect(const Ray& ray, IntersectInfo& info) const;
   bool intersectP(const Ray& ray) const;
 
+  // test closest intersection of rays in activeMask, return mask of hit rays
+  uint32_t intersectPacket(const RayPacket& packet, uint32_t activeMask,
+                           IntersectInfo info[RayPacket::SIZE]) const;
+
+  // compute surface info of the hit recorded by intersect
+  SurfaceInfo computeSurfaceInfo(const Ray& ray,
+                                 const IntersectInfo& info) const;
+
   Vec3 evaluateBSDF(const Vec3& wo, const Vec3& wi,
                     const SurfaceInfo& info) const;
 
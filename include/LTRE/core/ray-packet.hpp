@@ -0,0 +1,43 @@
+#ifndef _LTRE_RAY_PACKET_H
+#define _LTRE_RAY_PACKET_H
+#include <cstdint>
+
+#include "LTRE/core/aabb.hpp"
+#include "LTRE/core/ray.hpp"
+
+namespace LTRE {
+
+// packet of coherent rays, which are traced together through acceleration
+// structure
+// NOTE: which rays are traced is given by active mask(i-th bit for i-th ray)
+struct RayPacket {
+  static constexpr int SIZE = 8;
+
+  Ray rays[SIZE];
+};
+
+// rays of packet in SoA layout, precomputed once before traversal
+class RayPacketData {
+ private:
+  alignas(32) float orig[3][RayPacket::SIZE];
+  alignas(32) float dirInv[3][RayPacket::SIZE];
+  alignas(32) float tmin[RayPacket::SIZE];
+  alignas(32) float tmax[RayPacket::SIZE];
+
+ public:
+  // sign of direction of the first active ray, used to order children
+  // NOTE: rays of packet are coherent, so they mostly share the sign
+  int dirInvSign[3];
+
+  RayPacketData(const RayPacket& packet, uint32_t activeMask);
+
+  // reload tmax of rays in mask after they are shortened by hits
+  void updateTmax(const RayPacket& packet, uint32_t mask);
+
+  // test AABB with rays in mask at once, return mask of hit rays
+  uint32_t intersect(const AABB& bbox, uint32_t mask) const;
+};
+
+}  // namespace LTRE
+
+#endif
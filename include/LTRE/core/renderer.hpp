@@ -1,10 +1,17 @@
 #ifndef _LTRE_RENDERER_H
 #define _LTRE_RENDERER_H
+#include <atomic>
+#include <functional>
 #include <memory>
+#include <thread>
+#include <vector>
 
 #include "LTRE/camera/camera.hpp"
+#include "LTRE/core/cancellation-token.hpp"
+#include "LTRE/core/film.hpp"
 #include "LTRE/core/image.hpp"
 #include "LTRE/core/scene.hpp"
+#include "LTRE/core/tile-scheduler.hpp"
 #include "LTRE/integrator/integrator.hpp"
 #include "LTRE/sampling/sampler.hpp"
 
@@ -17,7 +24,9 @@ enum class AOVType {
   NORMAL,
   BARYCENTRIC,
   TEXCOORDS,
-  BASECOLOR
+  BASECOLOR,
+  TRAVERSAL_COST,
+  SAMPLE_COUNT
 };
 
 struct AOV {
@@ -28,11 +37,20 @@ struct AOV {
   Image<Vec2> barycentric;
   Image<Vec2> texcoords;
   Image<Vec3> baseColor;
+  // visited nodes and tested primitives of camera ray
+  // NOTE: only measured when LTRE_TRAVERSAL_STATS is defined
+  Image<float> traversalCost;
+  // samples taken by each pixel, which differ with adaptive sampling
+  Image<float> sampleCount;
 
   AOV(unsigned int width, unsigned int height);
 };
 
 class Renderer {
+ public:
+  // called with number of sample passes completed by all pixels
+  using PassCallback = std::function<void(unsigned int)>;
+
  private:
   unsigned int width;
   unsigned int height;
@@ -42,13 +60,76 @@ class Renderer {
 
   AOV aov;
 
+  // camera rays of pixels in a tile are traced as one packet
+  static constexpr unsigned int TILE_WIDTH = 4;
+  static constexpr unsigned int TILE_HEIGHT = RayPacket::SIZE / TILE_WIDTH;
+
+  // tiles of scheduler consist of whole packet tiles
+  TileScheduler scheduler;
+
+  // call f(tileX, tileY) for each packet tile in the tile of scheduler
+  template <typename F>
+  void forEachPacketTile(const Tile& tile, const F& f) const {
+    for (unsigned int tileY = tile.y0 / TILE_HEIGHT;
+         TILE_HEIGHT * tileY < tile.y1; ++tileY) {
+      for (unsigned int tileX = tile.x0 / TILE_WIDTH;
+           TILE_WIDTH * tileX < tile.x1; ++tileX) {
+        f(tileX, tileY);
+      }
+    }
+  }
+
+  // pixel of k-th ray in the tile, return false if it's outside of image
+  bool tilePixel(unsigned int tileX, unsigned int tileY, int k,
+                 unsigned int& i, unsigned int& j) const;
+
+  // sample camera rays of pixels in the tile and integrate them as a
+  // packet, return mask of pixels whose radiance is computed
+  // NOTE: samplers[k] is nullptr for pixel outside of image or pixel which is
+  // not sampled
+  uint32_t integrateTile(const Scene& scene, unsigned int tileX,
+                         unsigned int tileY,
+                         Sampler* const samplers[RayPacket::SIZE],
+                         Vec3 radiance[RayPacket::SIZE]) const;
+
+  // clone n samplers from sampler
+  // NOTE: samplers are allocated before render loop, and reseeded in place
+  std::vector<std::unique_ptr<Sampler>> cloneSamplers(unsigned int n) const;
+
   void renderFirstHitAOV(const Scene& scene);
 
+  // progressive rendering
+  ConvergenceCriterion convergence;
+  Film film;
+  std::thread renderThread;
+  CancellationToken renderToken;
+  std::atomic<bool> rendering{false};
+  std::atomic<unsigned int> completedPasses{0};
+
+  // heap allocations made by render loop of last rendering
+  std::atomic<uint64_t> renderAllocations{0};
+
+  // render first hit AOV, and clear film
+  void beginProgressive(const Scene& scene);
+
+  // add sample passes to film until token is cancelled
+  // token is cancelled when sampleBudget(0 is unlimited) of samples are taken
+  // in total or all pixels are converged
+  // NOTE: converged pixels are skipped, so that their samples are spent on
+  // pixels which are not converged
+  void renderProgressive(const Scene& scene, const PassCallback& onPass,
+                         const CancellationToken& token,
+                         uint64_t sampleBudget);
+
  public:
+  // tileSize is rounded up to multiple of packet tile
   Renderer(unsigned int width, unsigned int height,
            const std::shared_ptr<Camera>& camera,
            const std::shared_ptr<Integrator>& integrator,
-           const std::shared_ptr<Sampler>& sampler);
+           const std::shared_ptr<Sampler>& sampler,
+           unsigned int tileSize = 32,
+           TileOrder tileOrder = TileOrder::HILBERT);
+  ~Renderer();
 
   // focus at specified point
   void focus(const Vec3& p);
@@ -59,11 +140,46 @@ class Renderer {
   // focus at camera direction
   void focus(const Scene& scene);
 
+  // adaptive sampling stops sampling pixels which are converged, disabled
+  // when threshold is 0
+  void setAdaptiveSampling(const ConvergenceCriterion& criterion);
+
+  // with adaptive sampling, samples is average budget of each pixel
   void render(const Scene& scene, unsigned int samples);
 
   // limitTime [ms]
   void renderWithInLimitTime(const Scene& scene, unsigned int limitTime);
 
+  // start progressive rendering in background thread, sample passes are
+  // added until stop() is called, token is cancelled or all pixels are
+  // converged by adaptive sampling
+  // onPass is called from render thread, while rendering of other tiles
+  // continues
+  // NOTE: scene must outlive rendering
+  void start(const Scene& scene, const PassCallback& onPass = {},
+             const CancellationToken& token = CancellationToken());
+
+  // cancel progressive rendering, and wait until it finishes
+  void stop();
+
+  bool isRendering() const;
+
+  unsigned int getCompletedPasses() const;
+
+  // heap allocations made by render loop of last rendering
+  // NOTE: only counted when LTRE_COUNT_ALLOCATIONS is defined, and rendering
+  // aborts when render loop allocates
+  uint64_t getRenderAllocations() const;
+
+  // current image of progressive rendering, can be taken while rendering
+  // NOTE: tiles may have different number of samples
+  Image<Vec3> snapshot() const;
+
+  void writeSnapshotPPM(const std::filesystem::path& filepath) const;
+
+  // AOV of last rendering
+  const AOV& getAOV() const;
+
   void writePPM(const std::filesystem::path& filepath, const AOVType& aovType);
 };
 
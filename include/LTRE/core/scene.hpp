@@ -4,6 +4,7 @@
 
 #include "LTRE/core/model.hpp"
 #include "LTRE/intersector/intersector.hpp"
+#include "LTRE/shape/mesh.hpp"
 
 namespace LTRE {
 
@@ -12,20 +13,42 @@ class Scene {
   const std::shared_ptr<Intersector<Primitive>> intersector;
   const std::shared_ptr<Light> sky;
 
+  // when flattened, triangles of all meshes are put in one BVH instead of
+  // BVH of meshes, so that rays traverse single level of tree
+  // NOTE: primitives which are not mesh(e.g. analytic shapes, instances) are
+  // still put in intersector
+  const bool flatten;
+  // primitives of meshes in triangleIntersector, indexed by primID
+  std::vector<Primitive> meshPrimitives;
+  // NOTE: replaced by binary BVH when it fails to build(e.g. QBVH can't
+  // encode that many triangles)
+  std::shared_ptr<Intersector<SceneTriangle>> triangleIntersector;
+
   std::vector<std::shared_ptr<Light>> lights;
 
  public:
   Scene();
+  // flatten scene only when meshes are static and not instanced
+  // NOTE: flattened triangles are put in QBVH
+  Scene(const std::shared_ptr<Intersector<Primitive>>& intersector,
+        const std::shared_ptr<Light>& sky, bool flatten = false);
+  // flatten meshes into given intersector of triangles
   Scene(const std::shared_ptr<Intersector<Primitive>>& intersector,
-        const std::shared_ptr<Light>& sky);
+        const std::shared_ptr<Light>& sky,
+        const std::shared_ptr<Intersector<SceneTriangle>>& triangleIntersector);
 
   void addPrimitive(const Primitive& primitive);
   void addModel(const Model& model);
 
   void build();
+  // update bounds of scene after shapes are moved or deformed
+  void refit();
 
   bool intersect(const Ray& ray, IntersectInfo& info) const;
   bool intersectP(const Ray& ray) const;
+  // test closest intersection of rays in activeMask, return mask of hit rays
+  uint32_t intersectPacket(const RayPacket& packet, uint32_t activeMask,
+                           IntersectInfo info[RayPacket::SIZE]) const;
 
   Vec3 getSkyRadiance(const Ray& ray) const;
 
@@ -0,0 +1,139 @@
+#ifndef _LTRE_TILE_SCHEDULER_H
+#define _LTRE_TILE_SCHEDULER_H
+#include <omp.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "LTRE/core/cancellation-token.hpp"
+
+namespace LTRE {
+
+// order in which tiles are handed out
+enum class TileOrder { SCANLINE, MORTON, HILBERT };
+
+// rectangle of pixels [x0, x1) x [y0, y1)
+struct Tile {
+  unsigned int x0;
+  unsigned int y0;
+  unsigned int x1;
+  unsigned int y1;
+};
+
+// split image into square tiles ordered along space filling curve, and run
+// them in parallel
+// each thread starts with contiguous run of tiles, so that neighboring
+// tiles(which touch the same part of BVH and textures) are rendered by the
+// same thread. thread which runs out of tiles steals the latter half of
+// tiles left to another thread
+// when tiles are repeated, thread which runs out of tiles refills its range
+// with the next pass of its own run of tiles
+class TileScheduler {
+ private:
+  std::vector<Tile> tiles;  // in the order of TileOrder
+
+  // tiles[begin, end) left to a thread, the owner takes tiles from the front
+  // and thieves take them from the back
+  // tiles[first, last) is run of tiles given to the thread, pending is number
+  // of them which have not finished pass
+  // NOTE: aligned to cache line, so that threads don't share lines
+  struct alignas(64) WorkRange {
+    std::mutex mutex;
+    uint32_t begin{0};
+    uint32_t end{0};
+    uint32_t first{0};
+    uint32_t last{0};
+    uint32_t pending{0};
+    // NOTE: written only by the owner, read by others without lock
+    std::atomic<uint32_t> pass{0};
+  };
+
+  // NOTE: ranges are kept between calls, so that scheduling doesn't allocate
+  // unless number of threads changes
+  std::unique_ptr<WorkRange[]> ranges;
+  int nRanges{0};
+
+  // split tiles into n contiguous ranges, one for each thread
+  void distributeTiles(int n);
+
+  // take the next tile of own range
+  bool popTile(int id, uint32_t& tileIdx);
+
+  // steal the latter half of range of other thread, first stolen tile is
+  // returned and the rest becomes own range
+  bool stealTiles(int id, uint32_t& tileIdx);
+
+  // start the next pass of own run of tiles, first tile is returned
+  // NOTE: pass is started only when all tiles of the previous pass have
+  // finished, and no other run is behind it
+  bool refillTiles(int id, uint32_t& tileIdx);
+
+  // mark tile as finished the pass of its run
+  void finishTile(uint32_t tileIdx);
+
+ public:
+  TileScheduler(unsigned int width, unsigned int height,
+                unsigned int tileSize, TileOrder order);
+
+  const std::vector<Tile>& getTiles() const;
+
+  // number of threads used by parallelForEach
+  static int maxThreads();
+
+  // call f(tile, thread) once for each tile in parallel, thread is index of
+  // calling thread in [0, maxThreads())
+  // NOTE: f is not type erased, so that calling it doesn't allocate
+  template <typename F>
+  void parallelForEach(const F& f) {
+    distributeTiles(maxThreads());
+
+    // NOTE: ranges of threads which are not started are stolen by others
+#pragma omp parallel num_threads(nRanges)
+    {
+      const int id = omp_get_thread_num();
+      uint32_t tileIdx;
+      while (popTile(id, tileIdx) || stealTiles(id, tileIdx)) {
+        f(tiles[tileIdx], id);
+      }
+    }
+  }
+
+  // call f(tileIdx, thread) repeatedly until token is cancelled, tileIdx is
+  // index of getTiles(). each run of tiles is handed out pass by pass, and
+  // passes of runs differ by one at most, without barrier between passes
+  // NOTE: calls for the same tile never run concurrently, and cancellation
+  // is checked between calls
+  template <typename F>
+  void parallelRepeat(const F& f, const CancellationToken& token) {
+    if (tiles.empty()) return;
+
+#pragma omp parallel num_threads(maxThreads())
+    {
+      // NOTE: tiles are split among threads actually started, so that every
+      // run is refilled by its owner
+#pragma omp single
+      distributeTiles(omp_get_num_threads());
+
+      const int id = omp_get_thread_num();
+      uint32_t tileIdx;
+      while (!token.isCancelled()) {
+        if (popTile(id, tileIdx) || refillTiles(id, tileIdx) ||
+            stealTiles(id, tileIdx)) {
+          f(tileIdx, id);
+          finishTile(tileIdx);
+        } else {
+          // wait for other threads to finish tiles of the pass
+          std::this_thread::yield();
+        }
+      }
+    }
+  }
+};
+
+}  // namespace LTRE
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef _LTRE_TRANSFORM_H
+#define _LTRE_TRANSFORM_H
+
+#include "LTRE/core/aabb.hpp"
+#include "LTRE/math/vec3.hpp"
+
+namespace LTRE {
+
+// affine transform, represented by 3x4 matrix(row major) and its inverse
+class Transform {
+ private:
+  float m[3][4];
+  float mInv[3][4];
+
+  explicit Transform(const float m[3][4], const float mInv[3][4]);
+
+ public:
+  // identity transform
+  explicit Transform();
+  // NOTE: m must be invertible
+  explicit Transform(const float m[3][4]);
+
+  bool isIdentity() const;
+
+  // determinant of linear part
+  float determinant() const;
+
+  Transform inverse() const;
+
+  // compose transforms, (t1 * t2) applies t2 first
+  Transform operator*(const Transform& t) const;
+
+  Vec3 applyPoint(const Vec3& p) const;
+  Vec3 applyVector(const Vec3& v) const;
+  // transform normal by inverse transpose, result is not normalized
+  Vec3 applyNormal(const Vec3& n) const;
+  // AABB which bounds transformed AABB
+  AABB applyAABB(const AABB& bbox) const;
+};
+
+Transform translate(const Vec3& t);
+Transform scale(const Vec3& s);
+// rotation around axis, angle is given in radians
+Transform rotate(float angle, const Vec3& axis);
+
+}  // namespace LTRE
+
+#endif
@@ -1,5 +1,6 @@
 #ifndef _INTERSECT_INFO_H
 #define _INTERSECT_INFO_H
+#include <cstdint>
 #include <iostream>
 
 #include "LTRE/math/vec2.hpp"
@@ -15,10 +16,14 @@ struct SurfaceInfo {
   Vec2 uv;
 };
 
+// NOTE: during traversal only t, barycentric, faceID(and primID) are
+// recorded, surfaceInfo is computed once for the closest hit
 struct IntersectInfo {
   float t;
   SurfaceInfo surfaceInfo;
   Vec2 barycentric;
+  unsigned int faceID;  // which face of the shape is hit
+  uint32_t primID;      // which primitive is hit(only in flattened scene)
   const Primitive* hitPrimitive;
 };
 
@@ -0,0 +1,102 @@
+#ifndef _LTRE_WAVEFRONT_RENDERER_H
+#define _LTRE_WAVEFRONT_RENDERER_H
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+#include "LTRE/camera/camera.hpp"
+#include "LTRE/core/image.hpp"
+#include "LTRE/core/scene.hpp"
+#include "LTRE/sampling/sampler.hpp"
+
+namespace LTRE {
+
+// state of paths in flight, stored as SoA so that each stage only touches
+// the arrays it needs
+struct PathQueue {
+  std::vector<uint32_t> pixel;
+  std::vector<Vec3> cameraWeight;  // We * cos / pdf of camera ray
+  std::vector<Ray> ray;
+  std::vector<Vec3> throughput;
+  std::vector<Vec3> radiance;
+  std::vector<int> depth;
+  std::vector<IntersectInfo> info;
+  std::vector<uint8_t> hit;
+
+  void resize(std::size_t size);
+};
+
+// shadow rays of next event estimation, path[k] receives contribution[k] if
+// ray[k] is not occluded
+struct ShadowQueue {
+  std::vector<uint32_t> path;
+  std::vector<Ray> ray;
+  std::vector<Vec3> contribution;
+
+  void resize(std::size_t size);
+};
+
+// path tracer with next event estimation(same estimator as NEE), which
+// processes many paths at once by running each stage as a parallel loop over
+// queue instead of tracing one path at a time
+// 1. regenerate: accumulate finished paths, start camera paths in free slots
+// 2. extend: find closest hit of path rays
+// 3. shade: sample light and BSDF, paths are sorted by material
+// 4. shadow: test visibility of shadow rays generated in shade
+class WavefrontRenderer {
+ private:
+  unsigned int width;
+  unsigned int height;
+  std::shared_ptr<Camera> camera;
+  std::shared_ptr<Sampler> sampler;
+  const int maxDepth;
+  const unsigned int queueSize;
+
+  Image<Vec3> beauty;
+
+  // sampler of each pixel
+  // NOTE: a pixel has at most one path in flight, so that its sampler is
+  // consumed in path order
+  std::vector<std::unique_ptr<Sampler>> samplers;
+
+  PathQueue paths;
+  ShadowQueue shadowRays;
+  std::vector<uint32_t> activePaths;  // slots which have ray to extend
+  std::vector<uint32_t> nextPaths;    // slots which continue after shade
+  std::vector<uint32_t> freeSlots;    // slots which finished their path
+  uint32_t nActive;
+  uint32_t nNext;
+  uint32_t nFree;
+  uint32_t nShadowRays;
+
+  // sort key of shading, paths of the same material are shaded together
+  std::vector<std::pair<std::size_t, const Material*>> materialKeys;
+  // merge buffer of parallel sort
+  std::vector<uint32_t> sortScratch;
+
+  // start paths of pixels in [nextPixel, width * height)
+  void regenerate(uint32_t& nextPixel);
+  void extend(const Scene& scene);
+  void shade(const Scene& scene);
+  void shadow(const Scene& scene);
+
+ public:
+  WavefrontRenderer(unsigned int width, unsigned int height,
+                    const std::shared_ptr<Camera>& camera,
+                    const std::shared_ptr<Sampler>& sampler,
+                    int maxDepth = 100, unsigned int queueSize = 1 << 20);
+
+  // focus at camera direction
+  void focus(const Scene& scene);
+
+  void render(const Scene& scene, unsigned int samples);
+
+  // image of last rendering
+  const Image<Vec3>& getBeauty() const;
+
+  void writePPM(const std::filesystem::path& filepath);
+};
+
+}  // namespace LTRE
+
+#endif
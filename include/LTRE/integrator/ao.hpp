@@ -8,11 +8,21 @@ class AO : public Integrator {
  private:
   float occulusionDistance;
 
+  // compute AO at the first hit of the ray
+  Vec3 shade(const Ray& ray_in, const IntersectInfo& info, const Scene& scene,
+             Sampler& sampler) const;
+
  public:
   AO(float occulusionDistance);
 
   Vec3 integrate(const Ray& ray_in, const Scene& scene,
                  Sampler& sampler) const override;
+
+  // NOTE: first hits of the packet are found by packet traversal
+  void integratePacket(const RayPacket& packet, uint32_t activeMask,
+                       const Scene& scene,
+                       Sampler* const samplers[RayPacket::SIZE],
+                       Vec3 radiance[RayPacket::SIZE]) const override;
 };
 
 }  // namespace LTRE
@@ -1,5 +1,6 @@
 #ifndef _LTRE_INTEGRATOR_H
 #define _LTRE_INTEGRATOR_H
+#include <bit>
 #include <memory>
 
 #include "LTRE/core/ray.hpp"
@@ -12,6 +13,18 @@ class Integrator {
  public:
   virtual Vec3 integrate(const Ray& ray, const Scene& scene,
                          Sampler& sampler) const = 0;
+
+  // integrate rays of packet in activeMask, i-th ray uses samplers[i]
+  // NOTE: default implementation integrates rays one by one
+  virtual void integratePacket(const RayPacket& packet, uint32_t activeMask,
+                               const Scene& scene,
+                               Sampler* const samplers[RayPacket::SIZE],
+                               Vec3 radiance[RayPacket::SIZE]) const {
+    for (; activeMask > 0; activeMask &= activeMask - 1) {
+      const int r = std::countr_zero(activeMask);
+      radiance[r] = integrate(packet.rays[r], scene, *samplers[r]);
+    }
+  }
 };
 
 }  // namespace LTRE
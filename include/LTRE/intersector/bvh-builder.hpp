@@ -0,0 +1,1010 @@
+#ifndef _LTRE_BVH_BUILDER_H
+#define _LTRE_BVH_BUILDER_H
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+#include "LTRE/core/aabb.hpp"
+#include "LTRE/intersector/intersector.hpp"
+#include "spdlog/spdlog.h"
+
+namespace LTRE {
+
+// NOTE: SBVH considers spatial splits in addition to SAH object splits,
+// which clip references and may put a primitive into several leaves
+// NOTE: LBVH sorts references by Morton code of centroids and splits them at
+// the highest differing bit, much faster to build but lower quality than SAH
+enum class BVHSplitStrategy { CENTER, EQUAL, SAH, SBVH, LBVH };
+
+// binary BVH built by BVHBuilder is never deeper than this(root is depth 0)
+// NOTE: traversal stacks of every intersector are sized from this
+inline constexpr int BVH_MAX_DEPTH = 64;
+
+// reference to primitive during BVH construction
+// NOTE: bounds and centroid are computed only once per primitive
+struct BVHPrimitiveRef {
+  AABB bounds;
+  Vec3 centroid;
+  uint32_t primIdx;  // index of referenced primitive
+};
+
+// node of binary BVH produced by BVHBuilder
+struct BVHBuildNode {
+  AABB bbox;
+  uint32_t child[2]{0, 0};  // index of children(internal node only)
+  uint32_t refStart{0};     // index of first reference(leaf node only)
+  uint32_t nRefs{0};        // number of references(0 means internal node)
+  uint8_t axis{0};          // splitting axis(x=0, y=1, z=2)
+
+  bool isLeaf() const { return nRefs > 0; }
+};
+
+// builds binary BVH over references of primitives
+// large nodes are binned in parallel and subtrees are built as OpenMP tasks
+template <Intersectable T, BVHSplitStrategy strategy>
+class BVHBuilder {
+ public:
+  // minimum number of references to build subtree as separate task
+  static constexpr int PARALLEL_TASK_THRESHOLD = 4096;
+  // minimum number of references to process node with parallel chunks
+  static constexpr int PARALLEL_CHUNK_THRESHOLD = 65536;
+  // number of references processed by each chunk
+  static constexpr int CHUNK_SIZE = 16384;
+  // nodes with less than or equal to this number becomes leaf
+  static constexpr int MIN_PRIMITIVES_IN_LEAF = 4;
+  // SAH never makes leaf bigger than this
+  static constexpr int MAX_PRIMITIVES_IN_LEAF = 8;
+  static constexpr int SAH_NUM_BINS = 36;
+  static constexpr int SPATIAL_NUM_BINS = 32;
+  // spatial split is tried only when children of object split overlap more
+  // than this ratio of root surface area
+  static constexpr float SPATIAL_SPLIT_ALPHA = 1e-5f;
+  // number of extra references allowed by spatial splits, relative to number
+  // of primitives
+  static constexpr float DEFAULT_REFERENCE_BUDGET = 0.3f;
+  // refit falls back to full rebuild when SAH cost of refitted tree exceeds
+  // this ratio of cost right after build
+  static constexpr float DEFAULT_REBUILD_THRESHOLD = 1.5f;
+  // cost of SAH, also used to evaluate quality of built tree
+  static constexpr float TRAVERSE_COST = 0.125f;
+  static constexpr float INTERSECT_COST = 1.0f;
+  // number of bits of Morton code per axis
+  static constexpr int MORTON_BITS = 21;
+  // number of bits sorted by each pass of radix sort
+  static constexpr int RADIX_BITS = 8;
+  // nodes deeper than this are split at the median, which halves number of
+  // references per level and keeps the tree within BVH_MAX_DEPTH
+  static constexpr int MEDIAN_SPLIT_DEPTH = BVH_MAX_DEPTH - 32;
+
+ private:
+  struct SAHBin {
+    int nRefs{0};
+    AABB bounds;
+  };
+
+  struct SpatialBin {
+    AABB bounds;
+    int nEntries{0};  // number of references starting in this bin
+    int nExits{0};    // number of references ending in this bin
+  };
+
+  struct ObjectSplit {
+    int axis{0};
+    int binIdx{-1};  // split after this bin
+    float binStart{0};
+    float binScale{0};
+    float cost{std::numeric_limits<float>::max()};
+    AABB leftBounds;
+    AABB rightBounds;
+  };
+
+  struct SpatialSplit {
+    int axis{0};
+    int binIdx{-1};  // split after this bin
+    float binStart{0};
+    float binScale{0};
+    float cost{std::numeric_limits<float>::max()};
+    AABB leftBounds;
+    AABB rightBounds;
+    int nLeft{0};   // number of references overlapping left side
+    int nRight{0};  // number of references overlapping right side
+  };
+
+  const std::vector<T>* primitives{nullptr};
+  const float referenceBudget;
+
+  std::vector<BVHPrimitiveRef> refs;
+  std::vector<BVHBuildNode> nodes;
+  std::atomic<uint32_t> nNodes{0};
+
+  // SBVH only
+  float rootSurfaceArea{0};
+  uint32_t maxRefs{0};                  // maximum number of references
+  std::atomic<uint32_t> nTotalRefs{0};  // number of references in the tree
+  std::atomic<uint32_t> nLeafRefs{0};   // number of references put in leaves
+
+  // LBVH only
+  std::vector<uint64_t> mortonCodes;  // sorted Morton code of each reference
+
+  // call f(chunkIdx, start, end) for each chunk of n elements
+  // chunks are processed as separate tasks when n is large
+  template <typename F>
+  static void forEachChunk(int n, const F& f) {
+    const int nChunks = (n + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    if (n < PARALLEL_CHUNK_THRESHOLD) {
+      for (int c = 0; c < nChunks; ++c) {
+        f(c, c * CHUNK_SIZE, std::min((c + 1) * CHUNK_SIZE, n));
+      }
+      return;
+    }
+
+    for (int c = 0; c < nChunks; ++c) {
+#pragma omp task default(shared) firstprivate(c)
+      f(c, c * CHUNK_SIZE, std::min((c + 1) * CHUNK_SIZE, n));
+    }
+#pragma omp taskwait
+  }
+
+  // compute AABB and AABB of centroids of references
+  void computeBounds(std::span<const BVHPrimitiveRef> nodeRefs, AABB& bbox,
+                     AABB& centroidBox) const {
+    const auto computeChunk = [&](int start, int end, AABB& bbox,
+                                  AABB& centroidBox) {
+      for (int i = start; i < end; ++i) {
+        bbox = mergeAABB(bbox, nodeRefs[i].bounds);
+        centroidBox = mergeAABB(centroidBox, nodeRefs[i].centroid);
+      }
+    };
+
+    const int nRefs = nodeRefs.size();
+    if (nRefs < PARALLEL_CHUNK_THRESHOLD) {
+      computeChunk(0, nRefs, bbox, centroidBox);
+      return;
+    }
+
+    const int nChunks = (nRefs + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    std::vector<AABB> chunkBoxes(nChunks);
+    std::vector<AABB> chunkCentroidBoxes(nChunks);
+    for (int c = 0; c < nChunks; ++c) {
+#pragma omp task default(shared) firstprivate(c)
+      {
+        const int start = c * CHUNK_SIZE;
+        const int end = std::min(start + CHUNK_SIZE, nRefs);
+        computeChunk(start, end, chunkBoxes[c], chunkCentroidBoxes[c]);
+      }
+    }
+#pragma omp taskwait
+
+    for (int c = 0; c < nChunks; ++c) {
+      bbox = mergeAABB(bbox, chunkBoxes[c]);
+      centroidBox = mergeAABB(centroidBox, chunkCentroidBoxes[c]);
+    }
+  }
+
+  template <int NUM_BINS>
+  static int computeBinIdx(float pos, float binStart, float binScale) {
+    const int binIdx = binScale * (pos - binStart);
+    return std::clamp(binIdx, 0, NUM_BINS - 1);
+  }
+
+  // populate SAH bins of references
+  void populateBins(std::span<const BVHPrimitiveRef> nodeRefs, int axis,
+                    float binStart, float binScale,
+                    SAHBin bins[SAH_NUM_BINS]) const {
+    const auto populateChunk = [&](int start, int end, SAHBin* bins) {
+      for (int i = start; i < end; ++i) {
+        const int binIdx = computeBinIdx<SAH_NUM_BINS>(
+            nodeRefs[i].centroid[axis], binStart, binScale);
+        bins[binIdx].nRefs++;
+        bins[binIdx].bounds =
+            mergeAABB(bins[binIdx].bounds, nodeRefs[i].bounds);
+      }
+    };
+
+    const int nRefs = nodeRefs.size();
+    if (nRefs < PARALLEL_CHUNK_THRESHOLD) {
+      populateChunk(0, nRefs, bins);
+      return;
+    }
+
+    const int nChunks = (nRefs + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    std::vector<SAHBin> chunkBins(nChunks * SAH_NUM_BINS);
+    for (int c = 0; c < nChunks; ++c) {
+#pragma omp task default(shared) firstprivate(c)
+      {
+        const int start = c * CHUNK_SIZE;
+        const int end = std::min(start + CHUNK_SIZE, nRefs);
+        populateChunk(start, end, &chunkBins[c * SAH_NUM_BINS]);
+      }
+    }
+#pragma omp taskwait
+
+    for (int c = 0; c < nChunks; ++c) {
+      for (int b = 0; b < SAH_NUM_BINS; ++b) {
+        const SAHBin& bin = chunkBins[c * SAH_NUM_BINS + b];
+        bins[b].nRefs += bin.nRefs;
+        bins[b].bounds = mergeAABB(bins[b].bounds, bin.bounds);
+      }
+    }
+  }
+
+  // find the best object split by binned SAH
+  // NOTE: binIdx of returned split is -1 if references can't be split
+  ObjectSplit findObjectSplit(std::span<const BVHPrimitiveRef> nodeRefs,
+                              const AABB& nodeAABB,
+                              const AABB& centroidAABB) const {
+    ObjectSplit split;
+    split.axis = centroidAABB.longestAxis();
+    const float centroidStart = centroidAABB.bounds[0][split.axis];
+    const float centroidEnd = centroidAABB.bounds[1][split.axis];
+    if (centroidEnd <= centroidStart) return split;
+
+    // populate SAH bins
+    split.binStart = centroidStart;
+    split.binScale = SAH_NUM_BINS / (centroidEnd - centroidStart);
+    SAHBin bins[SAH_NUM_BINS];
+    populateBins(nodeRefs, split.axis, split.binStart, split.binScale, bins);
+
+    // sweep from right to get bounds, number of references of right side
+    AABB rightBounds[SAH_NUM_BINS];
+    int rightCounts[SAH_NUM_BINS];
+    {
+      AABB bounds;
+      int count = 0;
+      for (int i = SAH_NUM_BINS - 1; i > 0; --i) {
+        bounds = mergeAABB(bounds, bins[i].bounds);
+        count += bins[i].nRefs;
+        rightBounds[i] = bounds;
+        rightCounts[i] = count;
+      }
+    }
+
+    // sweep from left and compute SAH cost of splitting after bin i
+    AABB bounds;
+    int count = 0;
+    for (int i = 0; i < SAH_NUM_BINS - 1; ++i) {
+      bounds = mergeAABB(bounds, bins[i].bounds);
+      count += bins[i].nRefs;
+      if (count == 0 || rightCounts[i + 1] == 0) continue;
+
+      const float cost =
+          TRAVERSE_COST +
+          (count * INTERSECT_COST * bounds.surfaceArea() +
+           rightCounts[i + 1] * INTERSECT_COST *
+               rightBounds[i + 1].surfaceArea()) /
+              nodeAABB.surfaceArea();
+      if (cost < split.cost) {
+        split.cost = cost;
+        split.binIdx = i;
+        split.leftBounds = bounds;
+        split.rightBounds = rightBounds[i + 1];
+      }
+    }
+
+    return split;
+  }
+
+  // partition references by object split, return number of left side
+  static int partitionObjects(std::span<BVHPrimitiveRef> nodeRefs,
+                              const ObjectSplit& split) {
+    return std::partition(nodeRefs.begin(), nodeRefs.end(),
+                          [&](const BVHPrimitiveRef& ref) {
+                            return computeBinIdx<SAH_NUM_BINS>(
+                                       ref.centroid[split.axis],
+                                       split.binStart,
+                                       split.binScale) <= split.binIdx;
+                          }) -
+           nodeRefs.begin();
+  }
+
+  // split references into two groups, return number of left side
+  // return -1 when node should be leaf
+  int splitRefs(std::span<BVHPrimitiveRef> nodeRefs, const AABB& nodeAABB,
+                const AABB& centroidAABB, int& splitAxis) const {
+    const int nRefs = nodeRefs.size();
+    if (nRefs <= MIN_PRIMITIVES_IN_LEAF) return -1;
+
+    // compute split axis
+    splitAxis = centroidAABB.longestAxis();
+    const float centroidStart = centroidAABB.bounds[0][splitAxis];
+    const float centroidEnd = centroidAABB.bounds[1][splitAxis];
+
+    // all centroids are at the same position, we can't split them spatially
+    if (centroidEnd <= centroidStart) {
+      if (nRefs <= MAX_PRIMITIVES_IN_LEAF) return -1;
+      return splitEqual(nodeRefs, splitAxis);
+    }
+
+    int nLeft = 0;
+    if constexpr (strategy == BVHSplitStrategy::EQUAL) {
+      return splitEqual(nodeRefs, splitAxis);
+    } else if constexpr (strategy == BVHSplitStrategy::CENTER) {
+      const float center = 0.5f * (centroidStart + centroidEnd);
+      nLeft = std::partition(nodeRefs.begin(), nodeRefs.end(),
+                             [&](const BVHPrimitiveRef& ref) {
+                               return ref.centroid[splitAxis] < center;
+                             }) -
+              nodeRefs.begin();
+    } else {
+      const ObjectSplit split =
+          findObjectSplit(nodeRefs, nodeAABB, centroidAABB);
+
+      // make leaf node if it's cheaper than splitting
+      const float leafCost = nRefs * INTERSECT_COST;
+      if ((split.binIdx < 0 || split.cost >= leafCost) &&
+          nRefs <= MAX_PRIMITIVES_IN_LEAF) {
+        return -1;
+      }
+
+      // NOTE: cost overflows when surface area is huge, no split is found
+      if (split.binIdx >= 0) nLeft = partitionObjects(nodeRefs, split);
+    }
+
+    // if splitting failed, fall back to equal number splitting
+    if (nLeft == 0 || nLeft == nRefs) {
+      return splitEqual(nodeRefs, splitAxis);
+    }
+
+    return nLeft;
+  }
+
+  // split references into two groups which have same number of references
+  static int splitEqual(std::span<BVHPrimitiveRef> nodeRefs, int splitAxis) {
+    const int nLeft = nodeRefs.size() / 2;
+    std::nth_element(nodeRefs.begin(), nodeRefs.begin() + nLeft,
+                     nodeRefs.end(),
+                     [&](const BVHPrimitiveRef& ref1,
+                         const BVHPrimitiveRef& ref2) {
+                       return ref1.centroid[splitAxis] <
+                              ref2.centroid[splitAxis];
+                     });
+    return nLeft;
+  }
+
+  // split references at the median of the longest axis, return number of
+  // left side
+  // return -1 when node should be leaf
+  static int splitMedian(std::span<BVHPrimitiveRef> nodeRefs,
+                         const AABB& centroidAABB, int& splitAxis) {
+    if (nodeRefs.size() <= MAX_PRIMITIVES_IN_LEAF) return -1;
+    splitAxis = centroidAABB.longestAxis();
+    return splitEqual(nodeRefs, splitAxis);
+  }
+
+  // build bvh node recursively
+  void buildNode(uint32_t nodeIdx, int refStart, int refEnd, int depth) {
+    const std::span<BVHPrimitiveRef> nodeRefs(refs.data() + refStart,
+                                              refEnd - refStart);
+
+    // compute AABB
+    AABB nodeAABB, centroidAABB;
+    computeBounds(nodeRefs, nodeAABB, centroidAABB);
+    nodes[nodeIdx].bbox = nodeAABB;
+
+    // split references
+    int splitAxis = 0;
+    const int nLeft =
+        depth < MEDIAN_SPLIT_DEPTH
+            ? splitRefs(nodeRefs, nodeAABB, centroidAABB, splitAxis)
+            : splitMedian(nodeRefs, centroidAABB, splitAxis);
+
+    // make leaf node
+    if (nLeft < 0) {
+      nodes[nodeIdx].refStart = refStart;
+      nodes[nodeIdx].nRefs = refEnd - refStart;
+      return;
+    }
+
+    // allocate children
+    const uint32_t child0 = nNodes.fetch_add(2);
+    const uint32_t child1 = child0 + 1;
+    nodes[nodeIdx].child[0] = child0;
+    nodes[nodeIdx].child[1] = child1;
+    nodes[nodeIdx].axis = splitAxis;
+
+    // build children, large subtree is built as separate task
+    const int splitIdx = refStart + nLeft;
+    if (refEnd - refStart >= PARALLEL_TASK_THRESHOLD) {
+#pragma omp task default(shared) firstprivate(child0, refStart, splitIdx)
+      buildNode(child0, refStart, splitIdx, depth + 1);
+      buildNode(child1, splitIdx, refEnd, depth + 1);
+#pragma omp taskwait
+    } else {
+      buildNode(child0, refStart, splitIdx, depth + 1);
+      buildNode(child1, splitIdx, refEnd, depth + 1);
+    }
+  }
+
+  // split reference by axis-aligned plane
+  // NOTE: triangle is clipped exactly, other primitives clip their bounds
+  void splitReference(const BVHPrimitiveRef& ref, int axis, float pos,
+                      BVHPrimitiveRef& left, BVHPrimitiveRef& right) const {
+    pos = std::clamp(pos, ref.bounds.bounds[0][axis],
+                     ref.bounds.bounds[1][axis]);
+
+    AABB leftBounds, rightBounds;
+    if constexpr (TriangleLike<T>) {
+      const auto [v0, v1, v2] = (*primitives)[ref.primIdx].getPositions();
+      const Vec3 v[3] = {v0, v1, v2};
+      for (int i = 0; i < 3; ++i) {
+        const Vec3& p0 = v[i];
+        const Vec3& p1 = v[(i + 1) % 3];
+        if (p0[axis] <= pos) leftBounds = mergeAABB(leftBounds, p0);
+        if (p0[axis] >= pos) rightBounds = mergeAABB(rightBounds, p0);
+
+        // edge crosses splitting plane
+        if ((p0[axis] < pos && pos < p1[axis]) ||
+            (p1[axis] < pos && pos < p0[axis])) {
+          const float t = (pos - p0[axis]) / (p1[axis] - p0[axis]);
+          Vec3 p = p0 + t * (p1 - p0);
+          p[axis] = pos;
+          leftBounds = mergeAABB(leftBounds, p);
+          rightBounds = mergeAABB(rightBounds, p);
+        }
+      }
+      leftBounds = overlapAABB(leftBounds, ref.bounds);
+      rightBounds = overlapAABB(rightBounds, ref.bounds);
+    }
+
+    // clip bounds of reference when primitive itself can't be clipped
+    if (leftBounds.isEmpty()) {
+      leftBounds = ref.bounds;
+      leftBounds.bounds[1][axis] = pos;
+    }
+    if (rightBounds.isEmpty()) {
+      rightBounds = ref.bounds;
+      rightBounds.bounds[0][axis] = pos;
+    }
+
+    left = {leftBounds, leftBounds.center(), ref.primIdx};
+    right = {rightBounds, rightBounds.center(), ref.primIdx};
+  }
+
+  // find the best spatial split among all axes
+  // NOTE: binIdx of returned split is -1 if there is no valid split
+  SpatialSplit findSpatialSplit(std::span<const BVHPrimitiveRef> nodeRefs,
+                                const AABB& nodeAABB) const {
+    SpatialSplit split;
+    for (int axis = 0; axis < 3; ++axis) {
+      const float binStart = nodeAABB.bounds[0][axis];
+      const float extent = nodeAABB.bounds[1][axis] - binStart;
+      if (extent <= 0) continue;
+      const float binScale = SPATIAL_NUM_BINS / extent;
+
+      // populate bins, reference is clipped by each bin it straddles
+      SpatialBin bins[SPATIAL_NUM_BINS];
+      for (const BVHPrimitiveRef& ref : nodeRefs) {
+        const int entryBin = computeBinIdx<SPATIAL_NUM_BINS>(
+            ref.bounds.bounds[0][axis], binStart, binScale);
+        const int exitBin = computeBinIdx<SPATIAL_NUM_BINS>(
+            ref.bounds.bounds[1][axis], binStart, binScale);
+
+        BVHPrimitiveRef remaining = ref;
+        for (int b = entryBin; b < exitBin; ++b) {
+          BVHPrimitiveRef left, right;
+          splitReference(remaining, axis, binStart + (b + 1) / binScale, left,
+                         right);
+          bins[b].bounds = mergeAABB(bins[b].bounds, left.bounds);
+          remaining = right;
+        }
+        bins[exitBin].bounds =
+            mergeAABB(bins[exitBin].bounds, remaining.bounds);
+        bins[entryBin].nEntries++;
+        bins[exitBin].nExits++;
+      }
+
+      // sweep from right to get bounds, number of references of right side
+      AABB rightBounds[SPATIAL_NUM_BINS];
+      int rightCounts[SPATIAL_NUM_BINS];
+      {
+        AABB bounds;
+        int count = 0;
+        for (int i = SPATIAL_NUM_BINS - 1; i > 0; --i) {
+          bounds = mergeAABB(bounds, bins[i].bounds);
+          count += bins[i].nExits;
+          rightBounds[i] = bounds;
+          rightCounts[i] = count;
+        }
+      }
+
+      // sweep from left and compute SAH cost of splitting after bin i
+      AABB bounds;
+      int count = 0;
+      for (int i = 0; i < SPATIAL_NUM_BINS - 1; ++i) {
+        bounds = mergeAABB(bounds, bins[i].bounds);
+        count += bins[i].nEntries;
+        if (count == 0 || rightCounts[i + 1] == 0) continue;
+
+        const float cost =
+            TRAVERSE_COST +
+            (count * INTERSECT_COST * bounds.surfaceArea() +
+             rightCounts[i + 1] * INTERSECT_COST *
+                 rightBounds[i + 1].surfaceArea()) /
+                nodeAABB.surfaceArea();
+        if (cost < split.cost) {
+          split.axis = axis;
+          split.binIdx = i;
+          split.binStart = binStart;
+          split.binScale = binScale;
+          split.cost = cost;
+          split.leftBounds = bounds;
+          split.rightBounds = rightBounds[i + 1];
+          split.nLeft = count;
+          split.nRight = rightCounts[i + 1];
+        }
+      }
+    }
+
+    return split;
+  }
+
+  // distribute references by spatial split, straddling reference is split
+  // into both sides unless keeping it on one side is cheaper(unsplitting)
+  void performSpatialSplit(std::span<const BVHPrimitiveRef> nodeRefs,
+                           const SpatialSplit& split,
+                           std::vector<BVHPrimitiveRef>& leftRefs,
+                           std::vector<BVHPrimitiveRef>& rightRefs) const {
+    const float pos = split.binStart + (split.binIdx + 1) / split.binScale;
+    AABB leftBounds = split.leftBounds;
+    AABB rightBounds = split.rightBounds;
+    int nLeft = split.nLeft;
+    int nRight = split.nRight;
+    for (const BVHPrimitiveRef& ref : nodeRefs) {
+      const int entryBin = computeBinIdx<SPATIAL_NUM_BINS>(
+          ref.bounds.bounds[0][split.axis], split.binStart, split.binScale);
+      const int exitBin = computeBinIdx<SPATIAL_NUM_BINS>(
+          ref.bounds.bounds[1][split.axis], split.binStart, split.binScale);
+
+      if (exitBin <= split.binIdx) {
+        leftRefs.push_back(ref);
+      } else if (entryBin > split.binIdx) {
+        rightRefs.push_back(ref);
+      } else {
+        // compare cost of splitting with cost of keeping on one side
+        const AABB leftMerged = mergeAABB(leftBounds, ref.bounds);
+        const AABB rightMerged = mergeAABB(rightBounds, ref.bounds);
+        const float splitCost = leftBounds.surfaceArea() * nLeft +
+                                rightBounds.surfaceArea() * nRight;
+        const float leftCost = leftMerged.surfaceArea() * nLeft +
+                               rightBounds.surfaceArea() * (nRight - 1);
+        const float rightCost = leftBounds.surfaceArea() * (nLeft - 1) +
+                                rightMerged.surfaceArea() * nRight;
+
+        // NOTE: unsplitting never makes one side empty
+        if (leftCost < splitCost && leftCost <= rightCost && nRight > 1) {
+          leftRefs.push_back(ref);
+          leftBounds = leftMerged;
+          nRight--;
+        } else if (rightCost < splitCost && nLeft > 1) {
+          rightRefs.push_back(ref);
+          rightBounds = rightMerged;
+          nLeft--;
+        } else {
+          BVHPrimitiveRef left, right;
+          splitReference(ref, split.axis, pos, left, right);
+          leftRefs.push_back(left);
+          rightRefs.push_back(right);
+        }
+      }
+    }
+  }
+
+  // try to reserve extra references for spatial split within budget
+  bool reserveRefs(uint32_t nExtraRefs) {
+    uint32_t current = nTotalRefs.load();
+    while (current + nExtraRefs <= maxRefs) {
+      if (nTotalRefs.compare_exchange_weak(current, current + nExtraRefs)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // split references by object split or spatial split
+  // return false when node should be leaf
+  bool splitSpatialRefs(std::vector<BVHPrimitiveRef>& nodeRefs,
+                        const AABB& nodeAABB, const AABB& centroidAABB,
+                        std::vector<BVHPrimitiveRef>& leftRefs,
+                        std::vector<BVHPrimitiveRef>& rightRefs,
+                        int& splitAxis) {
+    const int nRefs = nodeRefs.size();
+    if (nRefs <= MIN_PRIMITIVES_IN_LEAF) return false;
+
+    const ObjectSplit objectSplit =
+        findObjectSplit(nodeRefs, nodeAABB, centroidAABB);
+
+    // spatial split is worth trying only when children of object split
+    // overlap considerably, and reference budget still remains
+    SpatialSplit spatialSplit;
+    const AABB overlap =
+        overlapAABB(objectSplit.leftBounds, objectSplit.rightBounds);
+    const bool overlapped =
+        objectSplit.binIdx < 0 ||
+        (!overlap.isEmpty() &&
+         overlap.surfaceArea() > SPATIAL_SPLIT_ALPHA * rootSurfaceArea);
+    if (overlapped && nTotalRefs < maxRefs) {
+      spatialSplit = findSpatialSplit(nodeRefs, nodeAABB);
+    }
+
+    const float leafCost = nRefs * INTERSECT_COST;
+    const bool canBeLeaf = nRefs <= MAX_PRIMITIVES_IN_LEAF;
+
+    // spatial split
+    if (spatialSplit.binIdx >= 0 && spatialSplit.cost < objectSplit.cost &&
+        (spatialSplit.cost < leafCost || !canBeLeaf)) {
+      const uint32_t nExtraRefs =
+          spatialSplit.nLeft + spatialSplit.nRight - nRefs;
+      if (reserveRefs(nExtraRefs)) {
+        performSpatialSplit(nodeRefs, spatialSplit, leftRefs, rightRefs);
+
+        // give back references saved by unsplitting
+        const uint32_t nSplitRefs = leftRefs.size() + rightRefs.size();
+        nTotalRefs -= nExtraRefs - (nSplitRefs - nRefs);
+        splitAxis = spatialSplit.axis;
+        return true;
+      }
+    }
+
+    // object split
+    if (objectSplit.binIdx >= 0 &&
+        (objectSplit.cost < leafCost || !canBeLeaf)) {
+      const int nLeft = partitionObjects(nodeRefs, objectSplit);
+      leftRefs.assign(nodeRefs.begin(), nodeRefs.begin() + nLeft);
+      rightRefs.assign(nodeRefs.begin() + nLeft, nodeRefs.end());
+      splitAxis = objectSplit.axis;
+      return true;
+    }
+
+    if (canBeLeaf) return false;
+
+    // fall back to equal number splitting
+    splitAxis = centroidAABB.longestAxis();
+    const int nLeft = splitEqual(nodeRefs, splitAxis);
+    leftRefs.assign(nodeRefs.begin(), nodeRefs.begin() + nLeft);
+    rightRefs.assign(nodeRefs.begin() + nLeft, nodeRefs.end());
+    return true;
+  }
+
+  // build bvh node recursively with spatial splits
+  // NOTE: references of each node are held by its own array, since spatial
+  // split increases number of references
+  void buildSpatialNode(uint32_t nodeIdx,
+                        std::vector<BVHPrimitiveRef>& nodeRefs, int depth) {
+    // compute AABB
+    AABB nodeAABB, centroidAABB;
+    computeBounds(nodeRefs, nodeAABB, centroidAABB);
+    nodes[nodeIdx].bbox = nodeAABB;
+
+    // split references
+    int splitAxis = 0;
+    std::vector<BVHPrimitiveRef> leftRefs, rightRefs;
+    bool split = false;
+    if (depth < MEDIAN_SPLIT_DEPTH) {
+      split = splitSpatialRefs(nodeRefs, nodeAABB, centroidAABB, leftRefs,
+                               rightRefs, splitAxis);
+    } else {
+      const int nLeft = splitMedian(nodeRefs, centroidAABB, splitAxis);
+      if (nLeft >= 0) {
+        leftRefs.assign(nodeRefs.begin(), nodeRefs.begin() + nLeft);
+        rightRefs.assign(nodeRefs.begin() + nLeft, nodeRefs.end());
+        split = true;
+      }
+    }
+    if (!split) {
+      // make leaf node, copy references into leaf order
+      const uint32_t refStart = nLeafRefs.fetch_add(nodeRefs.size());
+      std::copy(nodeRefs.begin(), nodeRefs.end(), refs.begin() + refStart);
+      nodes[nodeIdx].refStart = refStart;
+      nodes[nodeIdx].nRefs = nodeRefs.size();
+      return;
+    }
+    const int nRefs = nodeRefs.size();
+    std::vector<BVHPrimitiveRef>().swap(nodeRefs);
+
+    // allocate children
+    const uint32_t child0 = nNodes.fetch_add(2);
+    const uint32_t child1 = child0 + 1;
+    nodes[nodeIdx].child[0] = child0;
+    nodes[nodeIdx].child[1] = child1;
+    nodes[nodeIdx].axis = splitAxis;
+
+    // build children, large subtree is built as separate task
+    if (nRefs >= PARALLEL_TASK_THRESHOLD) {
+#pragma omp task default(shared) firstprivate(child0)
+      buildSpatialNode(child0, leftRefs, depth + 1);
+      buildSpatialNode(child1, rightRefs, depth + 1);
+#pragma omp taskwait
+    } else {
+      buildSpatialNode(child0, leftRefs, depth + 1);
+      buildSpatialNode(child1, rightRefs, depth + 1);
+    }
+  }
+
+  // insert two zero bits between each of lower MORTON_BITS bits
+  static uint64_t expandBits(uint64_t x) {
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffff;
+    x = (x | x << 16) & 0x1f0000ff0000ff;
+    x = (x | x << 8) & 0x100f00f00f00f00f;
+    x = (x | x << 4) & 0x10c30c30c30c30c3;
+    x = (x | x << 2) & 0x1249249249249249;
+    return x;
+  }
+
+  // Morton code of position normalized by centroidAABB
+  // NOTE: bit 3i + 2, 3i + 1, 3i holds i-th bit of x, y, z respectively
+  static uint64_t encodeMorton(const Vec3& p, const AABB& centroidAABB) {
+    constexpr float MAX_COORD = (1 << MORTON_BITS) - 1;
+    uint64_t code = 0;
+    for (int i = 0; i < 3; ++i) {
+      const float start = centroidAABB.bounds[0][i];
+      const float extent = centroidAABB.bounds[1][i] - start;
+      const float coord =
+          extent > 0 ? std::clamp(MAX_COORD * (p[i] - start) / extent, 0.0f,
+                                  MAX_COORD)
+                     : 0.0f;
+      code |= expandBits(static_cast<uint64_t>(coord)) << (2 - i);
+    }
+    return code;
+  }
+
+  // sort references by Morton code of their centroids, sorted codes are
+  // stored in mortonCodes
+  // NOTE: (code, index) pairs are sorted by LSD radix sort, then references
+  // are gathered only once
+  void sortByMortonCode() {
+    constexpr int RADIX_SIZE = 1 << RADIX_BITS;
+    const int nRefs = refs.size();
+    const int nChunks = (nRefs + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+    AABB bbox, centroidAABB;
+    computeBounds(refs, bbox, centroidAABB);
+
+    std::vector<uint64_t> keys(nRefs), tmpKeys(nRefs);
+    std::vector<uint32_t> indices(nRefs), tmpIndices(nRefs);
+    forEachChunk(nRefs, [&](int, int start, int end) {
+      for (int i = start; i < end; ++i) {
+        keys[i] = encodeMorton(refs[i].centroid, centroidAABB);
+        indices[i] = i;
+      }
+    });
+
+    // each pass sorts RADIX_BITS bits stably, offsets of each chunk are
+    // computed from histograms of all chunks
+    std::vector<uint32_t> offsets(nChunks * RADIX_SIZE);
+    for (int shift = 0; shift < 3 * MORTON_BITS; shift += RADIX_BITS) {
+      std::fill(offsets.begin(), offsets.end(), 0);
+      forEachChunk(nRefs, [&](int c, int start, int end) {
+        uint32_t* counts = &offsets[c * RADIX_SIZE];
+        for (int i = start; i < end; ++i) {
+          counts[(keys[i] >> shift) & (RADIX_SIZE - 1)]++;
+        }
+      });
+
+      // exclusive scan in order of (digit, chunk)
+      uint32_t sum = 0;
+      bool sorted = false;
+      for (int d = 0; d < RADIX_SIZE; ++d) {
+        const uint32_t digitStart = sum;
+        for (int c = 0; c < nChunks; ++c) {
+          const uint32_t count = offsets[c * RADIX_SIZE + d];
+          offsets[c * RADIX_SIZE + d] = sum;
+          sum += count;
+        }
+        // all keys have the same digit, nothing to do in this pass
+        if (sum - digitStart == static_cast<uint32_t>(nRefs)) sorted = true;
+      }
+      if (sorted) continue;
+
+      forEachChunk(nRefs, [&](int c, int start, int end) {
+        uint32_t* chunkOffsets = &offsets[c * RADIX_SIZE];
+        for (int i = start; i < end; ++i) {
+          const uint32_t dst =
+              chunkOffsets[(keys[i] >> shift) & (RADIX_SIZE - 1)]++;
+          tmpKeys[dst] = keys[i];
+          tmpIndices[dst] = indices[i];
+        }
+      });
+      keys.swap(tmpKeys);
+      indices.swap(tmpIndices);
+    }
+
+    // gather references in sorted order
+    std::vector<BVHPrimitiveRef> sortedRefs(nRefs);
+    forEachChunk(nRefs, [&](int, int start, int end) {
+      for (int i = start; i < end; ++i) {
+        sortedRefs[i] = refs[indices[i]];
+      }
+    });
+    refs.swap(sortedRefs);
+    mortonCodes = std::move(keys);
+  }
+
+  // emit bvh node recursively from references sorted by Morton code
+  // references are split at the highest bit differing in the range, so
+  // both children are always non-empty
+  // NOTE: AABB of internal node is merged from its children after they are
+  // built, each reference is visited only once
+  void buildMortonNode(uint32_t nodeIdx, int refStart, int refEnd, int depth) {
+    const int nRefs = refEnd - refStart;
+
+    // make leaf node
+    if (nRefs <= MIN_PRIMITIVES_IN_LEAF) {
+      AABB bbox;
+      for (int i = refStart; i < refEnd; ++i) {
+        bbox = mergeAABB(bbox, refs[i].bounds);
+      }
+      nodes[nodeIdx].bbox = bbox;
+      nodes[nodeIdx].refStart = refStart;
+      nodes[nodeIdx].nRefs = nRefs;
+      return;
+    }
+
+    // since codes are sorted, the first and the last code differ the most
+    int splitIdx = refStart + nRefs / 2;
+    int splitAxis = 0;
+    const uint64_t diff = mortonCodes[refStart] ^ mortonCodes[refEnd - 1];
+    if (diff != 0 && depth < MEDIAN_SPLIT_DEPTH) {
+      const int bit = 63 - std::countl_zero(diff);
+      splitIdx = std::partition_point(
+                     mortonCodes.begin() + refStart,
+                     mortonCodes.begin() + refEnd,
+                     [&](uint64_t code) { return ((code >> bit) & 1) == 0; }) -
+                 mortonCodes.begin();
+      splitAxis = 2 - bit % 3;
+    }
+
+    // allocate children
+    const uint32_t child0 = nNodes.fetch_add(2);
+    const uint32_t child1 = child0 + 1;
+    nodes[nodeIdx].child[0] = child0;
+    nodes[nodeIdx].child[1] = child1;
+    nodes[nodeIdx].axis = splitAxis;
+
+    // build children, large subtree is built as separate task
+    if (nRefs >= PARALLEL_TASK_THRESHOLD) {
+#pragma omp task default(shared) firstprivate(child0, refStart, splitIdx)
+      buildMortonNode(child0, refStart, splitIdx, depth + 1);
+      buildMortonNode(child1, splitIdx, refEnd, depth + 1);
+#pragma omp taskwait
+    } else {
+      buildMortonNode(child0, refStart, splitIdx, depth + 1);
+      buildMortonNode(child1, splitIdx, refEnd, depth + 1);
+    }
+
+    nodes[nodeIdx].bbox = mergeAABB(nodes[child0].bbox, nodes[child1].bbox);
+  }
+
+ public:
+  explicit BVHBuilder(float referenceBudget = DEFAULT_REFERENCE_BUDGET)
+      : referenceBudget(referenceBudget) {}
+
+  // build binary bvh over primitives, root node is nodes[0]
+  void build(const std::vector<T>& primitives) {
+    this->primitives = &primitives;
+    const int nPrimitives = primitives.size();
+
+    // precompute bounds and centroid of each primitive
+    refs.resize(nPrimitives);
+#pragma omp parallel for
+    for (int i = 0; i < nPrimitives; ++i) {
+      refs[i].bounds = primitives[i].aabb();
+      refs[i].centroid = refs[i].bounds.center();
+      refs[i].primIdx = i;
+    }
+
+    // NOTE: binary tree has at most 2N - 1 nodes for N references
+    maxRefs = nPrimitives;
+    if constexpr (strategy == BVHSplitStrategy::SBVH) {
+      maxRefs += static_cast<uint32_t>(referenceBudget * nPrimitives);
+    }
+    nodes.clear();
+    nodes.resize(std::max(2 * static_cast<int>(maxRefs) - 1, 0));
+    nNodes = 0;
+    if (nPrimitives == 0) return;
+
+    // start building bvh from root node
+    nNodes = 1;
+    if constexpr (strategy == BVHSplitStrategy::SBVH) {
+      std::vector<BVHPrimitiveRef> rootRefs = std::move(refs);
+      refs.resize(maxRefs);
+      nTotalRefs = nPrimitives;
+      nLeafRefs = 0;
+      AABB rootAABB, rootCentroidAABB;
+      computeBounds(rootRefs, rootAABB, rootCentroidAABB);
+      rootSurfaceArea = rootAABB.surfaceArea();
+
+#pragma omp parallel
+#pragma omp single
+      buildSpatialNode(0, rootRefs, 0);
+
+      refs.resize(nLeafRefs);
+    } else if constexpr (strategy == BVHSplitStrategy::LBVH) {
+#pragma omp parallel
+#pragma omp single
+      {
+        sortByMortonCode();
+        buildMortonNode(0, 0, nPrimitives, 0);
+      }
+
+      std::vector<uint64_t>().swap(mortonCodes);
+    } else {
+#pragma omp parallel
+#pragma omp single
+      buildNode(0, 0, nPrimitives, 0);
+    }
+
+    nodes.resize(nNodes);
+    this->primitives = nullptr;
+  }
+
+  // nodes of binary bvh
+  const std::vector<BVHBuildNode>& getNodesRef() const { return nodes; }
+
+  // references in leaf order
+  const std::vector<BVHPrimitiveRef>& getRefsRef() const { return refs; }
+
+  // reorder primitives in leaf order
+  // when spatial splits put a primitive into several leaves, primitives are
+  // kept as they are and leafPrimIndices maps each leaf slot to its
+  // primitive instead. otherwise leafPrimIndices is left empty
+  // NOTE: permutation is applied in place by following its cycles, so each
+  // primitive is moved only once and no copy of primitives is made
+  void reorderPrimitives(std::vector<T>& primitives,
+                         std::vector<uint32_t>& leafPrimIndices) const {
+    reorderSlots(primitives, leafPrimIndices,
+                 [](std::size_t slot) { return slot; });
+  }
+
+  // reorder primitives as above, except that i-th slot takes
+  // slotOrder[i]-th reference in leaf order(e.g. wide bvh which places
+  // leaves of a node next to each other)
+  // NOTE: slotOrder must be permutation of references
+  void reorderPrimitives(std::vector<T>& primitives,
+                         std::vector<uint32_t>& leafPrimIndices,
+                         const std::vector<uint32_t>& slotOrder) const {
+    reorderSlots(primitives, leafPrimIndices,
+                 [&](std::size_t slot) { return slotOrder[slot]; });
+  }
+
+ private:
+  // reorder primitives so that i-th slot holds primitive of refOf(i)-th
+  // reference
+  template <typename F>
+  void reorderSlots(std::vector<T>& primitives,
+                    std::vector<uint32_t>& leafPrimIndices,
+                    const F& refOf) const {
+    leafPrimIndices.clear();
+    if (refs.size() != primitives.size()) {
+      leafPrimIndices.resize(refs.size());
+      for (std::size_t i = 0; i < refs.size(); ++i) {
+        leafPrimIndices[i] = refs[refOf(i)].primIdx;
+      }
+      return;
+    }
+
+    std::vector<bool> done(refs.size(), false);
+    for (std::size_t i = 0; i < refs.size(); ++i) {
+      if (done[i]) continue;
+
+      T tmp = std::move(primitives[i]);
+      std::size_t j = i;
+      while (refs[refOf(j)].primIdx != i) {
+        const std::size_t k = refs[refOf(j)].primIdx;
+        primitives[j] = std::move(primitives[k]);
+        done[j] = true;
+        j = k;
+      }
+      primitives[j] = std::move(tmp);
+      done[j] = true;
+    }
+  }
+};
+
+}  // namespace LTRE
+
+#endif
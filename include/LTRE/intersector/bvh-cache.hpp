@@ -0,0 +1,182 @@
+#ifndef _LTRE_BVH_CACHE_H
+#define _LTRE_BVH_CACHE_H
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include "LTRE/intersector/triangle-blocks.hpp"
+#include "spdlog/spdlog.h"
+
+namespace LTRE {
+
+// incremented whenever format or meaning of cached data changes
+constexpr uint32_t BVH_CACHE_VERSION = 2;
+
+// 64bit FNV-1a hash of data, used as key of cache
+// NOTE: data is consumed by 8 bytes at once, so that hashing huge meshes
+// doesn't dominate loading time
+class ContentHash {
+ private:
+  uint64_t value;
+
+ public:
+  explicit ContentHash(uint64_t seed = 0xcbf29ce484222325) : value(seed) {}
+
+  ContentHash& add(const void* data, std::size_t size);
+
+  template <typename T>
+  ContentHash& add(const T& x) {
+    return add(&x, sizeof(T));
+  }
+
+  template <typename T>
+  ContentHash& add(const std::vector<T>& v) {
+    add(v.size());
+    return add(v.data(), v.size() * sizeof(T));
+  }
+
+  uint64_t get() const { return value; }
+};
+
+// header of cache file, followed by node array and faceID of each primitive
+// NOTE: nodes refer each other and primitives by indices, so the file is
+// position independent(but not endian independent)
+struct BVHCacheHeader {
+  char magic[8];         // "LTREBVH"
+  uint32_t version;      // BVH_CACHE_VERSION
+  uint32_t nodeSize;     // size of node, differs when node layout changes
+  char layout[8];        // name of intersector which wrote the file
+  uint64_t key;          // hash of primitives and build parameters
+  uint64_t nNodes;       // number of nodes
+  uint64_t nPrimitives;  // number of primitives(faceIDs)
+};
+
+// cache file mapped into memory
+// NOTE: falls back to reading whole file where mmap is not available
+class BVHCacheFile {
+ private:
+  const char* data{nullptr};
+  std::size_t size{0};
+  std::vector<char> buffer;  // used only without mmap
+
+  void close();
+
+ public:
+  // offset of node array, aligned to cache line
+  static constexpr std::size_t NODES_OFFSET = 64;
+
+  BVHCacheFile() {}
+  BVHCacheFile(const BVHCacheFile&) = delete;
+  BVHCacheFile& operator=(const BVHCacheFile&) = delete;
+  ~BVHCacheFile();
+
+  // map file and validate its header, return false if file can't be used
+  bool open(const std::filesystem::path& filepath, const char* layout,
+            uint32_t nodeSize, uint64_t key);
+
+  const BVHCacheHeader& header() const;
+  const void* nodes() const;
+  const uint32_t* faceIDs() const;
+
+  // write cache file
+  // NOTE: file is written to temporary path then renamed, so that readers
+  // never see partially written file
+  static bool write(const std::filesystem::path& filepath,
+                    const BVHCacheHeader& header, const void* nodes,
+                    const std::vector<uint32_t>& faceIDs);
+};
+
+// copy string into fixed size field of header, truncated so that the field
+// is always NUL terminated
+template <std::size_t N>
+void copyCacheTag(char (&dst)[N], const char* src) {
+  const std::size_t length = std::min(std::strlen(src), N - 1);
+  std::memcpy(dst, src, length);
+  dst[length] = '\0';
+}
+
+// save nodes and faceID of primitive of each leaf slot into cache file
+// NOTE: leafPrimIndices is empty when primitives are in leaf order
+template <typename Node, typename Allocator, TriangleLike T>
+bool saveBVHCache(const std::filesystem::path& filepath, const char* layout,
+                  uint64_t key, const std::vector<Node, Allocator>& nodes,
+                  const std::vector<T>& primitives,
+                  const std::vector<uint32_t>& leafPrimIndices) {
+  const std::size_t nSlots =
+      leafPrimIndices.empty() ? primitives.size() : leafPrimIndices.size();
+
+  BVHCacheHeader header{};
+  copyCacheTag(header.magic, "LTREBVH");
+  header.version = BVH_CACHE_VERSION;
+  header.nodeSize = sizeof(Node);
+  copyCacheTag(header.layout, layout);
+  header.key = key;
+  header.nNodes = nodes.size();
+  header.nPrimitives = nSlots;
+
+  std::vector<uint32_t> faceIDs(nSlots);
+  for (std::size_t i = 0; i < nSlots; ++i) {
+    faceIDs[i] = leafPrimIndices.empty()
+                     ? primitives[i].faceID
+                     : primitives[leafPrimIndices[i]].faceID;
+  }
+
+  return BVHCacheFile::write(filepath, header, nodes.data(), faceIDs);
+}
+
+// load nodes from cache file, primitives are recreated from faceID in leaf
+// order by makePrimitive
+// cache is ignored when faceID is not less than nFaces, or
+// isValidTree(nSlots) rejects loaded nodes, so that broken file never makes
+// traversal read out of bounds
+// NOTE: nodes and primitives are copied out of the file(copy-on-load), so
+// that the mapping is released right after loading
+// NOTE: face referred by several leaf slots is recreated only once, and
+// leafPrimIndices maps leaf slots to primitives then
+template <typename Node, typename Allocator, TriangleLike T, typename F,
+          typename V>
+bool loadBVHCache(const std::filesystem::path& filepath, const char* layout,
+                  uint64_t key, unsigned int nFaces,
+                  std::vector<Node, Allocator>& nodes,
+                  std::vector<T>& primitives,
+                  std::vector<uint32_t>& leafPrimIndices,
+                  const F& makePrimitive, const V& isValidTree) {
+  BVHCacheFile file;
+  if (!file.open(filepath, layout, sizeof(Node), key)) return false;
+
+  const BVHCacheHeader& header = file.header();
+  const uint32_t* faceIDs = file.faceIDs();
+  const bool validFaceIDs =
+      std::all_of(faceIDs, faceIDs + header.nPrimitives,
+                  [&](uint32_t faceID) { return faceID < nFaces; });
+  nodes.resize(header.nNodes);
+  std::memcpy(nodes.data(), file.nodes(), header.nNodes * sizeof(Node));
+  if (!validFaceIDs || !isValidTree(header.nPrimitives)) {
+    spdlog::warn("[BVHCacheFile] " + filepath.string() +
+                 " refers out of bounds, ignored.");
+    nodes.clear();
+    return false;
+  }
+
+  std::vector<uint32_t> primIdxOfFace(nFaces, UINT32_MAX);
+  primitives.clear();
+  leafPrimIndices.resize(header.nPrimitives);
+  for (uint64_t i = 0; i < header.nPrimitives; ++i) {
+    uint32_t& primIdx = primIdxOfFace[faceIDs[i]];
+    if (primIdx == UINT32_MAX) {
+      primIdx = primitives.size();
+      primitives.push_back(makePrimitive(faceIDs[i]));
+    }
+    leafPrimIndices[i] = primIdx;
+  }
+  // every face appeared once, primitives are already in leaf order
+  if (primitives.size() == header.nPrimitives) leafPrimIndices.clear();
+
+  return true;
+}
+
+}  // namespace LTRE
+
+#endif
@@ -1,14 +1,21 @@
 #ifndef _LTRE_BVH_H
 #define _LTRE_BVH_H
+#include <immintrin.h>
+
+#include <queue>
+
 #include "LTRE/core/aabb.hpp"
+#include "LTRE/core/aligned-allocator.hpp"
+#include "LTRE/intersector/bvh-builder.hpp"
+#include "LTRE/intersector/bvh-cache.hpp"
 #include "LTRE/intersector/intersector.hpp"
 
 namespace LTRE {
 
-enum class BVHSplitStrategy { CENTER, EQUAL, SAH };
-
 template <Intersectable T, BVHSplitStrategy strategy>
 class BVH : public Intersector<T> {
+  using LeafRay = typename Intersector<T>::LeafRay;
+
  public:
   struct BVHStatistics {
     int nNodes{0};          // number of nodes
@@ -16,294 +23,413 @@ class BVH : public Intersector<T> {
     int nLeafNodes{0};      // number of leaf nodes
   };
 
-  static AABB computeAABB(const std::vector<T>& primitives, int primStart,
-                          int primEnd) {
-    AABB ret;
-    for (int i = primStart; i < primEnd; ++i) {
-      ret = mergeAABB(ret, primitives[i].aabb());
-    }
-    return ret;
-  }
+ private:
+  // NOTE: 32Byte alighment to make node cache conscious
+  struct alignas(32) BVHNode {
+    AABB bbox;
+    union {
+      uint32_t primIndicesOffset;  // index of primIndices
+      uint32_t childOffset;        // index of first child, second one follows
+    };
+    uint16_t nPrimitives{0};  // number of primitives in this node
+    uint8_t axis{0};          // splitting axis(x=0, y=1, z=2)
+  };
 
-  static AABB computeCentroidAABB(const std::vector<T>& primitives,
-                                  int primStart, int primEnd) {
-    AABB ret;
-    for (int i = primStart; i < primEnd; ++i) {
-      ret = mergeAABB(ret, primitives[i].aabb().center());
-    }
-    return ret;
-  }
+  // siblings are stored next to each other, so that a pair of children
+  // shares one cache line
+  static constexpr std::size_t CACHE_LINE_SIZE = 64;
+  // number of sibling pairs in a treelet, which fills one page
+  static constexpr int TREELET_SIZE = 4096 / CACHE_LINE_SIZE;
+  // root is stored alone, node next to it is padding to align pairs
+  static constexpr uint32_t PADDING_NODE = 1;
 
-  static void splitAABB(const AABB& nodeAABB, std::vector<T>& primitives,
-                        int primStart, int primEnd, int& splitAxis,
-                        int& splitIdx, bool& makeLeaf,
-                        bool forceInternal = false) {
-    // if there are only few primitives, make leaf node
-    const int nPrims = primEnd - primStart;
-    if (nPrims <= 4 && !forceInternal) {
-      makeLeaf = true;
-      return;
+  // node array(page-sized treelets of sibling pairs)
+  std::vector<BVHNode, AlignedAllocator<BVHNode, CACHE_LINE_SIZE>> nodes;
+  BVHStatistics stats;
+  // number of extra references allowed by spatial splits(SBVH only)
+  float referenceBudget{BVHBuilder<T, strategy>::DEFAULT_REFERENCE_BUDGET};
+  // refit rebuilds tree when SAH cost exceeds this ratio of builtSAHCost
+  float rebuildThreshold{BVHBuilder<T, strategy>::DEFAULT_REBUILD_THRESHOLD};
+  float builtSAHCost{0};  // SAH cost right after build
+
+  // subtrees shallower than this depth are refitted as separate tasks
+  static constexpr int PARALLEL_REFIT_DEPTH = 10;
+
+  // copy build node into node array, children are placed later
+  void setBVHNode(uint32_t nodeIdx, const BVHBuildNode& buildNode) {
+    BVHNode& node = nodes[nodeIdx];
+    node.bbox = buildNode.bbox;
+    if (buildNode.isLeaf()) {
+      node.primIndicesOffset = buildNode.refStart;
+      node.nPrimitives = buildNode.nRefs;
+      stats.nLeafNodes++;
+    } else {
+      node.axis = buildNode.axis;
+      stats.nInternalNodes++;
     }
+  }
 
-    // compute split axis
-    const AABB splitAABB = computeCentroidAABB(primitives, primStart, primEnd);
-    splitAxis = splitAABB.longestAxis();
-
-    // splitting AABB
-    if constexpr (strategy == BVHSplitStrategy::EQUAL) {
-      splitIdx = primStart + nPrims / 2;
-      std::nth_element(primitives.begin() + primStart,
-                       primitives.begin() + splitIdx,
-                       primitives.begin() + primEnd,
-                       [&](const auto& prim1, const auto& prim2) {
-                         return prim1.aabb().center()[splitAxis] <
-                                prim2.aabb().center()[splitAxis];
-                       });
-    } else if constexpr (strategy == BVHSplitStrategy::CENTER) {
-      const float center = splitAABB.center()[splitAxis];
-      splitIdx =
-          std::partition(primitives.begin() + primStart,
-                         primitives.begin() + primEnd,
-                         [&](const auto& prim) {
-                           return prim.aabb().center()[splitAxis] < center;
-                         }) -
-          primitives.begin();
-    } else if constexpr (strategy == BVHSplitStrategy::SAH) {
-      constexpr int SAH_NUM_BINS = 36;
-
-      struct SAHBin {
-        int nPrimitives{0};
-        AABB bounds;
-      };
-      SAHBin bins[SAH_NUM_BINS];
-
-      // populate SAHBin
-      for (int i = primStart; i < primEnd; ++i) {
-        // compute SAH bin index
-        const float primPos = primitives[i].aabb().center()[splitAxis];
-        const float parentStartPos = nodeAABB.bounds[0][splitAxis];
-        const float parentEndPos = nodeAABB.bounds[1][splitAxis];
-        int binIdx = SAH_NUM_BINS * (primPos - parentStartPos) /
-                     (parentEndPos - parentStartPos);
-        if (binIdx == SAH_NUM_BINS) binIdx--;
-
-        bins[binIdx].nPrimitives++;
-        bins[binIdx].bounds =
-            mergeAABB(bins[binIdx].bounds, primitives[i].aabb());
+  // lay out binary tree of builder into node array
+  // treelet is grown from its root by placing children of the node with the
+  // largest surface area(most likely visited) first, until it fills a page.
+  // nodes left outside become roots of following treelets, so that each
+  // subtree is laid out next to its parent treelet
+  void layoutBVHNodes(const std::vector<BVHBuildNode>& buildNodes) {
+    struct TreeletNode {
+      float area;             // surface area of the node
+      uint32_t nodeIdx;       // index of node array
+      uint32_t buildNodeIdx;  // index of build node
+      bool operator<(const TreeletNode& other) const {
+        return area < other.area;
       }
+    };
 
-      // compute SAH cost
-      constexpr float traverseCost = 0.125f;
-      constexpr float intersectCost = 1.0f;
-      float costs[SAH_NUM_BINS];
-      for (int i = 0; i < SAH_NUM_BINS; ++i) {
-        int nPrimitives1 = 0;
-        AABB bounds1;
-        for (int j = 0; j <= i; ++j) {
-          nPrimitives1 += bins[j].nPrimitives;
-          bounds1 = mergeAABB(bounds1, bins[j].bounds);
+    nodes.resize(buildNodes[0].isLeaf() ? 1 : buildNodes.size() + 1);
+    setBVHNode(0, buildNodes[0]);
+    if (buildNodes[0].isLeaf()) return;
+    nodes[PADDING_NODE].bbox = AABB(Vec3(0), Vec3(0));
+
+    uint32_t nextPair = PADDING_NODE + 1;
+    std::vector<TreeletNode> treeletRoots = {
+        {buildNodes[0].bbox.surfaceArea(), 0, 0}};
+    while (!treeletRoots.empty()) {
+      std::priority_queue<TreeletNode> candidates;
+      candidates.push(treeletRoots.back());
+      treeletRoots.pop_back();
+
+      // place children of candidates until treelet is full
+      std::vector<TreeletNode> frontier;
+      for (int nPairs = 0; !candidates.empty();) {
+        const TreeletNode parent = candidates.top();
+        candidates.pop();
+        if (nPairs == TREELET_SIZE) {
+          frontier.push_back(parent);
+          continue;
         }
 
-        int nPrimitives2 = 0;
-        AABB bounds2;
-        for (int j = i + 1; j < SAH_NUM_BINS; ++j) {
-          nPrimitives2 += bins[j].nPrimitives;
-          bounds2 = mergeAABB(bounds2, bins[j].bounds);
+        nodes[parent.nodeIdx].childOffset = nextPair;
+        for (int i = 0; i < 2; ++i) {
+          const uint32_t childBuildNodeIdx =
+              buildNodes[parent.buildNodeIdx].child[i];
+          const BVHBuildNode& child = buildNodes[childBuildNodeIdx];
+          setBVHNode(nextPair + i, child);
+          if (!child.isLeaf()) {
+            candidates.push(
+                {child.bbox.surfaceArea(), nextPair + i, childBuildNodeIdx});
+          }
         }
-
-        costs[i] = traverseCost +
-                   (nPrimitives1 * intersectCost * bounds1.surfaceArea() +
-                    nPrimitives2 * intersectCost * bounds2.surfaceArea()) /
-                       nodeAABB.surfaceArea();
+        nextPair += 2;
+        nPairs++;
       }
 
-      // find minimum SAH cost
-      int minCostIdx = 0;
-      float minCost = costs[0];
-      for (int i = 1; i < SAH_NUM_BINS; ++i) {
-        if (costs[i] < minCost) {
-          minCostIdx = i;
-          minCost = costs[i];
-        }
-      }
+      // lay out subtrees of larger nodes first
+      std::sort(frontier.begin(), frontier.end());
+      treeletRoots.insert(treeletRoots.end(), frontier.begin(),
+                          frontier.end());
+    }
+  }
 
-      const float leafCost = nPrims * intersectCost;
-      if (minCost < leafCost || forceInternal) {
-        // split AABB
-        const float parentStartPos = nodeAABB.bounds[0][splitAxis];
-        const float parentEndPos = nodeAABB.bounds[1][splitAxis];
-        splitIdx =
-            std::partition(
-                primitives.begin() + primStart, primitives.begin() + primEnd,
-                [&](const auto& prim) {
-                  const float primPos = prim.aabb().center()[splitAxis];
-                  int binIdx = SAH_NUM_BINS * (primPos - parentStartPos) /
-                               (parentEndPos - parentStartPos);
-                  if (binIdx == SAH_NUM_BINS) binIdx--;
-                  return binIdx <= minCostIdx;
-                }) -
-            primitives.begin();
-      } else {
-        // make leaf node
-        makeLeaf = true;
-        return;
-      }
+  // refit bounds of subtree bottom-up, return AABB of the node
+  AABB refitNode(uint32_t nodeIdx, int depth) {
+    BVHNode& node = nodes[nodeIdx];
+    if (node.nPrimitives > 0) {
+      node.bbox = this->refitLeaf(node.primIndicesOffset, node.nPrimitives);
+      return node.bbox;
     }
 
-    // if splitting failed, fall back to equal number splitting
-    if (splitIdx == primStart || splitIdx == primEnd) {
-      spdlog::warn("[BVH] splitting failed, fallback to equal splitting.");
-      splitIdx = primStart + nPrims / 2;
-      std::cout << splitIdx << ", " << primStart << ", " << primEnd
-                << std::endl;
-      std::nth_element(primitives.begin() + primStart,
-                       primitives.begin() + splitIdx,
-                       primitives.begin() + primEnd,
-                       [&](const auto& prim1, const auto& prim2) {
-                         return prim1.aabb().center()[splitAxis] <
-                                prim2.aabb().center()[splitAxis];
-                       });
+    const uint32_t child0 = node.childOffset;
+    const uint32_t child1 = node.childOffset + 1;
+    AABB bbox0, bbox1;
+    if (depth < PARALLEL_REFIT_DEPTH) {
+#pragma omp task default(shared) firstprivate(child0, depth)
+      bbox0 = refitNode(child0, depth + 1);
+      bbox1 = refitNode(child1, depth + 1);
+#pragma omp taskwait
+    } else {
+      bbox0 = refitNode(child0, depth + 1);
+      bbox1 = refitNode(child1, depth + 1);
     }
 
-    makeLeaf = false;
+    node.bbox = mergeAABB(bbox0, bbox1);
+    return node.bbox;
   }
 
- private:
-  // NOTE: 32Byte alighment to make node cache conscious
-  struct alignas(32) BVHNode {
-    AABB bbox;
-    union {
-      uint32_t primIndicesOffset;  // index of primIndices
-      uint32_t secondChildOffset;  // index of second child
-    };
-    uint16_t nPrimitives{0};  // number of primitives in this node
-    uint8_t axis{0};          // splitting axis(x=0, y=1, z=2)
-  };
+  // mix build parameters into key of cache
+  uint64_t cacheKey(uint64_t key) const {
+    return ContentHash(key).add(strategy).add(referenceBudget).get();
+  }
 
-  std::vector<BVHNode> nodes;  // node array(depth-first order)
-  BVHStatistics stats;
+  // SAH cost of the tree, normalized by surface area of root node
+  float computeSAHCost() const {
+    if (nodes.size() == 0) return 0;
+    const float rootArea = nodes[0].bbox.surfaceArea();
+    if (rootArea <= 0) return 0;
+
+    float cost = 0;
+#pragma omp parallel for reduction(+ : cost)
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+      const BVHNode& node = nodes[i];
+      cost += node.bbox.surfaceArea() *
+              (node.nPrimitives > 0
+                   ? node.nPrimitives * BVHBuilder<T, strategy>::INTERSECT_COST
+                   : BVHBuilder<T, strategy>::TRAVERSE_COST);
+    }
+    return cost / rootArea;
+  }
 
-  // add leaf node to node array
-  void addLeafNode(const AABB& bbox, int primStart, int nPrims) {
-    BVHNode node;
-    node.bbox = bbox;
-    node.primIndicesOffset = primStart;
-    node.nPrimitives = nPrims;
-    nodes.push_back(node);
-    stats.nLeafNodes++;
+  // pack primitives of all leaves and count nodes, used when nodes are
+  // loaded from cache instead of being built
+  void packNodeLeaves() {
+    stats = BVHStatistics();
+    this->triangleBlocks.clear();
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+      if (i == PADDING_NODE) continue;
+      const BVHNode& node = nodes[i];
+      if (node.nPrimitives > 0) {
+        this->packLeaf(node.primIndicesOffset, node.nPrimitives);
+        stats.nLeafNodes++;
+      } else {
+        stats.nInternalNodes++;
+      }
+    }
+    stats.nNodes = stats.nInternalNodes + stats.nLeafNodes;
   }
 
-  // build bvh node recursively
-  void buildBVHNode(int primStart, int primEnd) {
-    // compute AABB
-    const AABB nodeAABB = computeAABB(this->primitives, primStart, primEnd);
-
-    // split AABB
-    int splitAxis = 0;
-    int splitIdx = primStart;
-    bool makeLeaf = false;
-    splitAABB(nodeAABB, this->primitives, primStart, primEnd, splitAxis,
-              splitIdx, makeLeaf);
-
-    // make leaf node
-    if (makeLeaf) {
-      const int nPrims = primEnd - primStart;
-      addLeafNode(nodeAABB, primStart, nPrims);
-      return;
+  // check that nodes loaded from cache form a tree no deeper than
+  // BVH_MAX_DEPTH, whose children and leaves are in bounds
+  bool isValidTree(uint64_t nSlots) const {
+    if (nodes.empty()) return nSlots == 0;
+    std::vector<std::pair<uint32_t, int>> stack = {{0, 0}};
+    std::size_t nVisited = 0;
+    while (!stack.empty()) {
+      const auto [nodeIdx, depth] = stack.back();
+      stack.pop_back();
+      // NOTE: depth also bounds cycles, number of visits bounds shared nodes
+      if (depth > BVH_MAX_DEPTH || ++nVisited > nodes.size()) return false;
+
+      const BVHNode& node = nodes[nodeIdx];
+      if (node.nPrimitives > 0) {
+        if (node.primIndicesOffset + uint64_t(node.nPrimitives) > nSlots) {
+          return false;
+        }
+        continue;
+      }
+      // NOTE: children are never root or padding node
+      if (node.childOffset <= PADDING_NODE ||
+          node.childOffset + uint64_t(1) >= nodes.size()) {
+        return false;
+      }
+      stack.push_back({node.childOffset, depth + 1});
+      stack.push_back({node.childOffset + 1, depth + 1});
     }
+    return true;
+  }
 
-    // add node to node array, remember index of current node(parent node)
-    const int parentOffset = nodes.size();
-    BVHNode node;
-    node.bbox = nodeAABB;
-    node.primIndicesOffset = primStart;
-    node.axis = splitAxis;
-    nodes.push_back(node);
-    stats.nInternalNodes++;
+  // maximum number of deferred nodes during traversal
+  // NOTE: at most one node per level is deferred
+  static constexpr int MAX_STACK_SIZE = BVH_MAX_DEPTH + 1;
 
-    // add left children on node array
-    buildBVHNode(primStart, splitIdx);
+  // prefetch children of deferred node, so that they are in cache when the
+  // node is popped
+  void prefetchChildren(uint32_t nodeIdx) const {
+    const BVHNode& node = nodes[nodeIdx];
+    if (node.nPrimitives == 0) {
+      _mm_prefetch(reinterpret_cast<const char*>(&nodes[node.childOffset]),
+                   _MM_HINT_T0);
+    }
+  }
 
-    // set index of right child on parent node
-    const int secondChildOffset = nodes.size();
-    nodes[parentOffset].secondChildOffset = secondChildOffset;
+  // deferred node on traversal stack
+  struct StackEntry {
+    uint32_t nodeIdx;  // index of deferred node
+    float tEntry;      // distance where ray enters the node
+  };
 
-    // add right children on node array
-    buildBVHNode(splitIdx, primEnd);
-  }
+  // deferred node on traversal stack shared by packet
+  struct PacketStackEntry {
+    uint32_t nodeIdx;  // index of deferred node
+    uint32_t mask;     // rays which may hit the node
+  };
 
-  // traverse bvh recursively
-  bool intersectNode(int nodeIdx, const Ray& ray, const Vec3& dirInv,
-                     const int dirInvSign[3], IntersectInfo& info) const {
+  // traverse bvh iteratively, visit nearer child first
+  bool intersectNode(const Ray& ray, const LeafRay& leafRay,
+                     const Vec3& dirInv, const int dirInvSign[3],
+                     IntersectInfo& info) const {
     bool hit = false;
-    const BVHNode& node = nodes[nodeIdx];
 
-    if (node.bbox.intersect(ray, dirInv, dirInvSign)) {
+    float tEntry;
+    TraversalStats::countBoxes(1);
+    if (!nodes[0].bbox.intersect(ray, dirInv, dirInvSign, tEntry)) {
+      return false;
+    }
+
+    StackEntry stack[MAX_STACK_SIZE];
+    int stackSize = 0;
+    uint32_t nodeIdx = 0;
+    while (true) {
+      const BVHNode& node = nodes[nodeIdx];
+      TraversalStats::countNode();
+
       // leaf node
       if (node.nPrimitives > 0) {
         // test intersection with all primitives in this node
-        const int primEnd = node.primIndicesOffset + node.nPrimitives;
-        for (int i = node.primIndicesOffset; i < primEnd; ++i) {
-          if (this->primitives[i].intersect(ray, info)) {
-            ray.tmax = info.t;
-            hit = true;
-          }
+        if (this->intersectLeaf(node.primIndicesOffset, node.nPrimitives, ray,
+                                leafRay, info)) {
+          hit = true;
         }
       }
       // internal node
       else {
-        // test intersection with child node
-        // use splitting axis heuristics for early termination
-        if (dirInvSign[node.axis] == 0) {
-          hit |= intersectNode(nodeIdx + 1, ray, dirInv, dirInvSign, info);
-          hit |= intersectNode(node.secondChildOffset, ray, dirInv, dirInvSign,
-                               info);
-        } else {
-          hit |= intersectNode(node.secondChildOffset, ray, dirInv, dirInvSign,
-                               info);
-          hit |= intersectNode(nodeIdx + 1, ray, dirInv, dirInvSign, info);
+        // test intersection with both children before descending
+        const uint32_t child0 = node.childOffset;
+        const uint32_t child1 = node.childOffset + 1;
+        float t0, t1;
+        TraversalStats::countBoxes(2);
+        const bool hit0 =
+            nodes[child0].bbox.intersect(ray, dirInv, dirInvSign, t0);
+        const bool hit1 =
+            nodes[child1].bbox.intersect(ray, dirInv, dirInvSign, t1);
+
+        if (hit0 && hit1) {
+          // visit nearer child, defer farther child
+          if (t0 <= t1) {
+            assert(stackSize < MAX_STACK_SIZE);
+            stack[stackSize++] = {child1, t1};
+            prefetchChildren(child1);
+            nodeIdx = child0;
+          } else {
+            assert(stackSize < MAX_STACK_SIZE);
+            stack[stackSize++] = {child0, t0};
+            prefetchChildren(child0);
+            nodeIdx = child1;
+          }
+          continue;
+        } else if (hit0) {
+          nodeIdx = child0;
+          continue;
+        } else if (hit1) {
+          nodeIdx = child1;
+          continue;
         }
       }
+
+      // pop next node, skip nodes which are beyond the closest hit
+      while (stackSize > 0 && stack[stackSize - 1].tEntry > ray.tmax) {
+        stackSize--;
+      }
+      if (stackSize == 0) break;
+      nodeIdx = stack[--stackSize].nodeIdx;
     }
 
     return hit;
   }
 
-  // traverse bvh recursively
-  bool intersectNodeP(int nodeIdx, const Ray& ray, const Vec3& dirInv,
-                      const int dirInvSign[3]) const {
-    bool hit = false;
-    const BVHNode& node = nodes[nodeIdx];
+  // traverse bvh iteratively, terminate at the first hit
+  // NOTE: any hit terminates traversal, so that children are not ordered by
+  // distance
+  bool intersectNodeP(const Ray& ray, const LeafRay& leafRay,
+                      const Vec3& dirInv, const int dirInvSign[3]) const {
+    float tEntry;
+    TraversalStats::countBoxes(1);
+    if (!nodes[0].bbox.intersect(ray, dirInv, dirInvSign, tEntry)) {
+      return false;
+    }
+
+    uint32_t stack[MAX_STACK_SIZE];
+    int stackSize = 0;
+    uint32_t nodeIdx = 0;
+    while (true) {
+      const BVHNode& node = nodes[nodeIdx];
+      TraversalStats::countNode();
 
-    if (node.bbox.intersect(ray, dirInv, dirInvSign)) {
       // leaf node
       if (node.nPrimitives > 0) {
         // test intersection with all primitives in this node
-        const int primEnd = node.primIndicesOffset + node.nPrimitives;
-        for (int i = node.primIndicesOffset; i < primEnd; ++i) {
-          if (this->primitives[i].intersectP(ray)) {
-            hit = true;
-            break;
-          }
+        if (this->intersectLeafP(node.primIndicesOffset, node.nPrimitives,
+                                 ray, leafRay)) {
+          return true;
         }
       }
       // internal node
       else {
-        // test intersection with child node
-        // use splitting axis heuristics for early termination
-        if (dirInvSign[node.axis] == 0) {
-          hit |= intersectNodeP(nodeIdx + 1, ray, dirInv, dirInvSign);
-          hit |=
-              intersectNodeP(node.secondChildOffset, ray, dirInv, dirInvSign);
-        } else {
-          hit |=
-              intersectNodeP(node.secondChildOffset, ray, dirInv, dirInvSign);
-          hit |= intersectNodeP(nodeIdx + 1, ray, dirInv, dirInvSign);
+        const uint32_t child0 = node.childOffset;
+        const uint32_t child1 = node.childOffset + 1;
+        float t0, t1;
+        TraversalStats::countBoxes(2);
+        const bool hit0 =
+            nodes[child0].bbox.intersect(ray, dirInv, dirInvSign, t0);
+        const bool hit1 =
+            nodes[child1].bbox.intersect(ray, dirInv, dirInvSign, t1);
+
+        if (hit0 && hit1) {
+          assert(stackSize < MAX_STACK_SIZE);
+          stack[stackSize++] = child1;
+          prefetchChildren(child1);
+          nodeIdx = child0;
+          continue;
+        } else if (hit0) {
+          nodeIdx = child0;
+          continue;
+        } else if (hit1) {
+          nodeIdx = child1;
+          continue;
         }
       }
+
+      if (stackSize == 0) break;
+      nodeIdx = stack[--stackSize];
     }
 
-    return hit;
+    return false;
+  }
+
+  // traverse bvh with packet of rays, which share one stack
+  // each node is tested with rays which hit its parent, and visited when any
+  // of them still hits it
+  uint32_t intersectNodePacket(const RayPacket& packet, uint32_t activeMask,
+                               IntersectInfo info[RayPacket::SIZE]) const {
+    RayPacketData data(packet, activeMask);
+    LeafRay leafRays[RayPacket::SIZE];
+    for (uint32_t bits = activeMask; bits > 0; bits &= bits - 1) {
+      const int r = std::countr_zero(bits);
+      leafRays[r] = LeafRay(packet.rays[r]);
+    }
+    uint32_t hitMask = 0;
+
+    PacketStackEntry stack[MAX_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = {0, activeMask};
+    while (stackSize > 0) {
+      const PacketStackEntry entry = stack[--stackSize];
+      const BVHNode& node = nodes[entry.nodeIdx];
+
+      // cull rays which miss the node or already hit closer
+      TraversalStats::countBoxes(1);
+      const uint32_t mask = data.intersect(node.bbox, entry.mask);
+      if (mask == 0) continue;
+      TraversalStats::countNode();
+
+      // leaf node
+      if (node.nPrimitives > 0) {
+        // test intersection of rays with all primitives in this node
+        const uint32_t leafHitMask =
+            this->intersectLeafPacket(node.primIndicesOffset, node.nPrimitives,
+                                      packet, leafRays, mask, info);
+        data.updateTmax(packet, leafHitMask);
+        hitMask |= leafHitMask;
+        continue;
+      }
+
+      // visit nearer child first, given direction of the packet
+      const uint32_t near = node.childOffset + data.dirInvSign[node.axis];
+      const uint32_t far = node.childOffset + 1 - data.dirInvSign[node.axis];
+      assert(stackSize + 2 <= MAX_STACK_SIZE);
+      stack[stackSize++] = {far, mask};
+      prefetchChildren(far);
+      stack[stackSize++] = {near, mask};
+    }
+
+    return hitMask;
   }
 
  public:
@@ -311,20 +437,98 @@ class BVH : public Intersector<T> {
   BVH(const std::vector<T>& primitives) : Intersector<T>(primitives) {}
 
   bool build() override {
-    // start building bvh from root node
-    buildBVHNode(0, this->primitives.size());
+    nodes.clear();
+    stats = BVHStatistics();
+    this->triangleBlocks.clear();
+    this->leafPrimIndices.clear();
+
+    // build binary tree in parallel
+    BVHBuilder<T, strategy> builder(referenceBudget);
+    builder.build(this->primitives);
+
+    // lay out tree, then reorder primitives in leaf order at once
+    const std::vector<BVHBuildNode>& buildNodes = builder.getNodesRef();
+    if (buildNodes.size() > 0) {
+      layoutBVHNodes(buildNodes);
+      builder.reorderPrimitives(this->primitives, this->leafPrimIndices);
+      // pack primitives of each leaf
+      for (const BVHBuildNode& node : buildNodes) {
+        if (node.isLeaf()) this->packLeaf(node.refStart, node.nRefs);
+      }
+    }
     stats.nNodes = stats.nInternalNodes + stats.nLeafNodes;
+    builtSAHCost = computeSAHCost();
 
     spdlog::info("[BVH] nPrimitives: " +
                  std::to_string(this->primitives.size()));
     spdlog::info("[BVH] nNodes: " + std::to_string(stats.nNodes));
     spdlog::info("[BVH] nInternalNodes: " +
                  std::to_string(stats.nInternalNodes));
-    spdlog::info("[BVH] nInternalNodes: " + std::to_string(stats.nLeafNodes));
+    spdlog::info("[BVH] nLeafNodes: " + std::to_string(stats.nLeafNodes));
 
     return true;
   }
 
+  // refit bounds of all nodes after primitives are moved
+  // whole tree is rebuilt when its SAH cost degrades too much
+  bool refit() override {
+    if (nodes.size() == 0) return true;
+
+#pragma omp parallel
+#pragma omp single
+    refitNode(0, 0);
+
+    const float sahCost = computeSAHCost();
+    if (sahCost > rebuildThreshold * builtSAHCost) {
+      spdlog::info("[BVH] SAH cost degraded from " +
+                   std::to_string(builtSAHCost) + " to " +
+                   std::to_string(sahCost) + ", rebuilding");
+      return build();
+    }
+    return true;
+  }
+
+  // save nodes and primitive order into cache file(triangles only)
+  bool saveCache(const std::filesystem::path& filepath,
+                 uint64_t key) const override {
+    if constexpr (TriangleLike<T>) {
+      return saveBVHCache(filepath, "BVH", cacheKey(key), nodes,
+                          this->primitives, this->leafPrimIndices);
+    } else {
+      return false;
+    }
+  }
+
+  // adopt nodes and primitive order of cache file instead of building
+  bool loadCache(
+      const std::filesystem::path& filepath, uint64_t key, unsigned int nFaces,
+      const std::function<T(unsigned int)>& makePrimitive) override {
+    if constexpr (TriangleLike<T>) {
+      if (!loadBVHCache(
+              filepath, "BVH", cacheKey(key), nFaces, nodes, this->primitives,
+              this->leafPrimIndices, makePrimitive,
+              [this](uint64_t nSlots) { return isValidTree(nSlots); })) {
+        return false;
+      }
+      packNodeLeaves();
+      builtSAHCost = computeSAHCost();
+
+      spdlog::info("[BVH] nPrimitives: " +
+                   std::to_string(this->primitives.size()));
+      spdlog::info("[BVH] nNodes: " + std::to_string(stats.nNodes));
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+  // set number of extra references allowed by spatial splits, relative to
+  // number of primitives(SBVH only)
+  void setReferenceBudget(float budget) { referenceBudget = budget; }
+
+  // set ratio of SAH cost degradation which makes refit rebuild the tree
+  void setRebuildThreshold(float threshold) { rebuildThreshold = threshold; }
+
   // number of nodes
   int nNodes() const { return stats.nNodes; }
   // number of internal nodes
@@ -341,6 +545,7 @@ class BVH : public Intersector<T> {
   }
 
   bool intersect(const Ray& ray, IntersectInfo& info) const override {
+    TraversalStats::Scope scope(TraversalQuery::CLOSEST);
     // precompute ray's inversed direction, sign of direction
     const Vec3 dirInv = 1.0f / ray.direction;
     int dirInvSign[3];
@@ -348,10 +553,15 @@ class BVH : public Intersector<T> {
       dirInvSign[i] = dirInv[i] > 0 ? 0 : 1;
     }
     // traverse from root node
-    return intersectNode(0, ray, dirInv, dirInvSign, info);
+    if (nodes.size() == 0) return false;
+    return intersectNode(ray, LeafRay(ray), dirInv, dirInvSign, info);
   }
 
   bool intersectP(const Ray& ray) const override {
+    TraversalStats::Scope scope(TraversalQuery::OCCLUSION);
+    if (nodes.size() == 0) return false;
+    if (this->intersectLastOccluder(ray)) return true;
+
     // precompute ray's inversed direction, sign of direction
     const Vec3 dirInv = 1.0f / ray.direction;
     int dirInvSign[3];
@@ -360,7 +570,15 @@ class BVH : public Intersector<T> {
     }
 
     // traverse from root node
-    return intersectNodeP(0, ray, dirInv, dirInvSign);
+    return intersectNodeP(ray, LeafRay(ray), dirInv, dirInvSign);
+  }
+
+  uint32_t intersectPacket(const RayPacket& packet, uint32_t activeMask,
+                           IntersectInfo info[RayPacket::SIZE]) const override {
+    TraversalStats::Scope scope(TraversalQuery::PACKET);
+    // traverse from root node
+    if (nodes.size() == 0 || activeMask == 0) return 0;
+    return intersectNodePacket(packet, activeMask, info);
   }
 };
 
@@ -0,0 +1,519 @@
+#ifndef _LTRE_BVH8_H
+#define _LTRE_BVH8_H
+#include <immintrin.h>
+
+#include "LTRE/intersector/bvh.hpp"
+#include "LTRE/intersector/intersector.hpp"
+
+namespace LTRE {
+
+// 8-wide BVH, built by collapsing binary BVH
+// each node holds bounds of 8 children in SoA layout, which are tested at
+// once with AVX(AVX-512 mask compare is used when available)
+template <Intersectable T, BVHSplitStrategy strategy>
+class BVH8 : public Intersector<T> {
+ private:
+  using LeafRay = typename Intersector<T>::LeafRay;
+
+  // NOTE: 64Byte alignment to make node cache line aligned
+  struct alignas(64) BVHNode {
+    float bounds[2 * 3 * 8];  // pmin.x[8], pmin.y[8], pmin.z[8], pmax...
+    uint32_t child[8];        // index of child node, or index of first prim
+    uint16_t nPrimitives[8];  // number of primitives if child is leaf
+  };
+
+  static constexpr uint32_t EMPTY_CHILD = 0xffffffff;
+  // maximum number of deferred children during traversal
+  // NOTE: at most 7 children per level are deferred, and BVH8 is never
+  // deeper than binary BVH it's collapsed from
+  static constexpr int MAX_STACK_SIZE = 7 * BVH_MAX_DEPTH + 1;
+
+  // deferred child on traversal stack
+  struct StackEntry {
+    uint32_t child;        // index of child node, or index of first prim
+    uint32_t nPrimitives;  // number of primitives if child is leaf
+    float tEntry;          // distance where ray enters the child
+  };
+
+  std::vector<BVHNode> nodes;
+  typename BVH<T, strategy>::BVHStatistics stats;
+  // number of extra references allowed by spatial splits(SBVH only)
+  float referenceBudget{BVHBuilder<T, strategy>::DEFAULT_REFERENCE_BUDGET};
+  // refit rebuilds tree when SAH cost exceeds this ratio of builtSAHCost
+  float rebuildThreshold{BVHBuilder<T, strategy>::DEFAULT_REBUILD_THRESHOLD};
+  float builtSAHCost{0};  // SAH cost right after build
+
+  // subtrees shallower than this depth are refitted as separate tasks
+  static constexpr int PARALLEL_REFIT_DEPTH = 4;
+
+  // AABB of i-th child of node
+  static AABB childAABB(const BVHNode& node, int i) {
+    return AABB(Vec3(node.bounds[i], node.bounds[8 + i], node.bounds[16 + i]),
+                Vec3(node.bounds[24 + i], node.bounds[32 + i],
+                     node.bounds[40 + i]));
+  }
+
+  static void setChildAABB(BVHNode& node, int i, const AABB& bbox) {
+    for (int j = 0; j < 3; ++j) {
+      node.bounds[8 * j + i] = bbox.bounds[0][j];
+      node.bounds[8 * (j + 3) + i] = bbox.bounds[1][j];
+    }
+  }
+
+  // collapse binary subtree into 8-wide nodes, return index of the node
+  int collapse(const std::vector<BVHBuildNode>& binaryNodes,
+               uint32_t binaryIdx) {
+    // gather up to 8 children, open the largest internal child first
+    uint32_t children[8];
+    int nChildren = 0;
+    if (binaryNodes[binaryIdx].isLeaf()) {
+      children[nChildren++] = binaryIdx;
+    } else {
+      children[nChildren++] = binaryNodes[binaryIdx].child[0];
+      children[nChildren++] = binaryNodes[binaryIdx].child[1];
+    }
+    while (nChildren < 8) {
+      int largest = -1;
+      float largestArea = -1.0f;
+      for (int i = 0; i < nChildren; ++i) {
+        const BVHBuildNode& child = binaryNodes[children[i]];
+        if (!child.isLeaf() && child.bbox.surfaceArea() > largestArea) {
+          largest = i;
+          largestArea = child.bbox.surfaceArea();
+        }
+      }
+      if (largest < 0) break;
+
+      const BVHBuildNode& child = binaryNodes[children[largest]];
+      children[largest] = child.child[0];
+      children[nChildren++] = child.child[1];
+    }
+
+    // add node to node array
+    // NOTE: populate child info later
+    const int nodeIdx = nodes.size();
+    nodes.emplace_back();
+    stats.nInternalNodes++;
+
+    for (int i = 0; i < 8; ++i) {
+      // empty child never intersects
+      AABB bbox;
+      uint32_t child = EMPTY_CHILD;
+      uint16_t nPrimitives = 0;
+      if (i < nChildren) {
+        const BVHBuildNode& binaryNode = binaryNodes[children[i]];
+        bbox = binaryNode.bbox;
+        if (binaryNode.isLeaf()) {
+          child = binaryNode.refStart;
+          nPrimitives = binaryNode.nRefs;
+          stats.nLeafNodes++;
+        } else {
+          child = collapse(binaryNodes, children[i]);
+        }
+      }
+
+      BVHNode& node = nodes[nodeIdx];
+      setChildAABB(node, i, bbox);
+      node.child[i] = child;
+      node.nPrimitives[i] = nPrimitives;
+    }
+
+    return nodeIdx;
+  }
+
+  // refit bounds of subtree bottom-up, return AABB of the node
+  AABB refitNode(uint32_t nodeIdx, int depth) {
+    BVHNode& node = nodes[nodeIdx];
+    AABB childBoxes[8];
+    for (int i = 0; i < 8; ++i) {
+      const uint32_t child = node.child[i];
+      if (child == EMPTY_CHILD) continue;
+
+      if (node.nPrimitives[i] > 0) {
+        childBoxes[i] = this->refitLeaf(child, node.nPrimitives[i]);
+      } else if (depth < PARALLEL_REFIT_DEPTH) {
+#pragma omp task default(shared) firstprivate(i, child, depth)
+        childBoxes[i] = refitNode(child, depth + 1);
+      } else {
+        childBoxes[i] = refitNode(child, depth + 1);
+      }
+    }
+#pragma omp taskwait
+
+    AABB bbox;
+    for (int i = 0; i < 8; ++i) {
+      setChildAABB(node, i, childBoxes[i]);
+      bbox = mergeAABB(bbox, childBoxes[i]);
+    }
+    return bbox;
+  }
+
+  // mix build parameters into key of cache
+  uint64_t cacheKey(uint64_t key) const {
+    return ContentHash(key).add(strategy).add(referenceBudget).get();
+  }
+
+  // SAH cost of the tree, normalized by surface area of root node
+  float computeSAHCost() const {
+    const float rootArea = aabb().surfaceArea();
+    if (nodes.size() == 0 || rootArea <= 0) return 0;
+
+    float cost = 0;
+#pragma omp parallel for reduction(+ : cost)
+    for (std::size_t n = 0; n < nodes.size(); ++n) {
+      AABB bbox;
+      for (int i = 0; i < 8; ++i) {
+        if (nodes[n].child[i] == EMPTY_CHILD) continue;
+
+        const AABB childbox = childAABB(nodes[n], i);
+        bbox = mergeAABB(bbox, childbox);
+        cost += childbox.surfaceArea() * nodes[n].nPrimitives[i] *
+                BVHBuilder<T, strategy>::INTERSECT_COST;
+      }
+      cost += bbox.surfaceArea() * BVHBuilder<T, strategy>::TRAVERSE_COST;
+    }
+    return cost / rootArea;
+  }
+
+  // pack primitives of all leaves and count nodes, used when nodes are
+  // loaded from cache instead of being built
+  void packNodeLeaves() {
+    stats = typename BVH<T, strategy>::BVHStatistics();
+    this->triangleBlocks.clear();
+    for (const BVHNode& node : nodes) {
+      stats.nInternalNodes++;
+      for (int i = 0; i < 8; ++i) {
+        if (node.child[i] != EMPTY_CHILD && node.nPrimitives[i] > 0) {
+          this->packLeaf(node.child[i], node.nPrimitives[i]);
+          stats.nLeafNodes++;
+        }
+      }
+    }
+    stats.nNodes = stats.nInternalNodes + stats.nLeafNodes;
+  }
+
+  // check that nodes loaded from cache form a tree no deeper than
+  // BVH_MAX_DEPTH, whose children and leaves are in bounds
+  bool isValidTree(uint64_t nSlots) const {
+    if (nodes.empty()) return nSlots == 0;
+    std::vector<std::pair<uint32_t, int>> stack = {{0, 0}};
+    std::size_t nVisited = 0;
+    while (!stack.empty()) {
+      const auto [nodeIdx, depth] = stack.back();
+      stack.pop_back();
+      // NOTE: depth also bounds cycles, number of visits bounds shared nodes
+      if (depth >= BVH_MAX_DEPTH || ++nVisited > nodes.size()) return false;
+
+      const BVHNode& node = nodes[nodeIdx];
+      for (int i = 0; i < 8; ++i) {
+        const uint32_t child = node.child[i];
+        if (child == EMPTY_CHILD) {
+          // NOTE: empty child is skipped only because its AABB is empty
+          if (!childAABB(node, i).isEmpty()) return false;
+        } else if (node.nPrimitives[i] > 0) {
+          if (child + uint64_t(node.nPrimitives[i]) > nSlots) return false;
+        } else if (child > 0 && child < nodes.size()) {
+          stack.push_back({child, depth + 1});
+        } else {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // ray data for traversal
+  struct RayData {
+    Vec3 dirInv;
+    int dirInvSign[3];
+    LeafRay leafRay;
+#ifdef __AVX__
+    __m256 orig[3];
+    __m256 dirInv8[3];
+#endif
+  };
+
+  static RayData prepareRay(const Ray& ray) {
+    RayData ret;
+    ret.leafRay = LeafRay(ray);
+    // precompute ray's inversed direction, sign of direction
+    ret.dirInv = 1.0f / ray.direction;
+    for (int i = 0; i < 3; ++i) {
+      ret.dirInvSign[i] = ret.dirInv[i] > 0 ? 0 : 1;
+#ifdef __AVX__
+      ret.orig[i] = _mm256_set1_ps(ray.origin[i]);
+      ret.dirInv8[i] = _mm256_set1_ps(ret.dirInv[i]);
+#endif
+    }
+    return ret;
+  }
+
+  // intersect 8 children aabb, return hit mask and entry distance of each
+  static int intersectAABB(const BVHNode& node, const Ray& ray,
+                           const RayData& rayData, float tEntry[8]) {
+#ifdef __AVX__
+    // SIMD version of https://dl.acm.org/doi/abs/10.1145/1198555.1198748
+    __m256 tmin = _mm256_set1_ps(ray.tmin);
+    __m256 tmax = _mm256_set1_ps(ray.tmax);
+    const __m256 farScale = _mm256_set1_ps(SLAB_FAR_SCALE);
+    for (int i = 0; i < 3; ++i) {
+      const int near = 8 * (i + 3 * rayData.dirInvSign[i]);
+      const int far = 8 * (i + 3 * (1 - rayData.dirInvSign[i]));
+      const __m256 t0 =
+          _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(&node.bounds[near]),
+                                      rayData.orig[i]),
+                        rayData.dirInv8[i]);
+      const __m256 t1 =
+          _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(&node.bounds[far]),
+                                      rayData.orig[i]),
+                        rayData.dirInv8[i]);
+      tmin = _mm256_max_ps(tmin, t0);
+      tmax = _mm256_min_ps(tmax, _mm256_mul_ps(t1, farScale));
+    }
+    _mm256_storeu_ps(tEntry, tmin);
+#ifdef __AVX512VL__
+    return _mm256_cmp_ps_mask(tmin, tmax, _CMP_LE_OQ);
+#else
+    return _mm256_movemask_ps(_mm256_cmp_ps(tmin, tmax, _CMP_LE_OQ));
+#endif
+#else
+    int mask = 0;
+    for (int i = 0; i < 8; ++i) {
+      const AABB bbox(Vec3(node.bounds[i], node.bounds[8 + i],
+                           node.bounds[16 + i]),
+                      Vec3(node.bounds[24 + i], node.bounds[32 + i],
+                           node.bounds[40 + i]));
+      if (bbox.intersect(ray, rayData.dirInv, rayData.dirInvSign,
+                         tEntry[i])) {
+        tEntry[i] = std::max(tEntry[i], ray.tmin);
+        mask |= (1 << i);
+      }
+    }
+    return mask;
+#endif
+  }
+
+  // traverse BVH8 iteratively, visit children in front-to-back order
+  bool intersectNode(const Ray& ray, const RayData& rayData,
+                     IntersectInfo& info) const {
+    bool hit = false;
+
+    StackEntry stack[MAX_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = {0, 0, ray.tmin};
+    while (stackSize > 0) {
+      const StackEntry entry = stack[--stackSize];
+      // skip child which is beyond the closest hit
+      if (entry.tEntry > ray.tmax) continue;
+      TraversalStats::countNode();
+
+      // leaf node
+      if (entry.nPrimitives > 0) {
+        // test intersection with all primitives in this node
+        if (this->intersectLeaf(entry.child, entry.nPrimitives, ray,
+                                rayData.leafRay, info)) {
+          hit = true;
+        }
+        continue;
+      }
+
+      // internal node
+      const BVHNode& node = nodes[entry.child];
+      float tEntry[8];
+      TraversalStats::countBoxes(8);
+      const int hitMask = intersectAABB(node, ray, rayData, tEntry);
+      if (hitMask == 0) continue;
+
+      // sort hit children by entry distance(insertion sort, descending)
+      int hitChildren[8];
+      int nHits = 0;
+      for (int i = 0; i < 8; ++i) {
+        if (!(hitMask & (1 << i))) continue;
+        int j = nHits++;
+        while (j > 0 && tEntry[hitChildren[j - 1]] < tEntry[i]) {
+          hitChildren[j] = hitChildren[j - 1];
+          j--;
+        }
+        hitChildren[j] = i;
+      }
+
+      // push farthest child first, then nearest child is popped first
+      for (int i = 0; i < nHits; ++i) {
+        const int c = hitChildren[i];
+        assert(stackSize < MAX_STACK_SIZE);
+        stack[stackSize++] = {node.child[c], node.nPrimitives[c], tEntry[c]};
+      }
+    }
+
+    return hit;
+  }
+
+  // traverse BVH8 iteratively, terminate at the first hit
+  bool intersectNodeP(const Ray& ray, const RayData& rayData) const {
+    StackEntry stack[MAX_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = {0, 0, ray.tmin};
+    while (stackSize > 0) {
+      const StackEntry entry = stack[--stackSize];
+      TraversalStats::countNode();
+
+      // leaf node
+      if (entry.nPrimitives > 0) {
+        // test intersection with all primitives in this node
+        if (this->intersectLeafP(entry.child, entry.nPrimitives, ray,
+                                 rayData.leafRay)) {
+          return true;
+        }
+        continue;
+      }
+
+      // internal node
+      const BVHNode& node = nodes[entry.child];
+      float tEntry[8];
+      TraversalStats::countBoxes(8);
+      const int hitMask = intersectAABB(node, ray, rayData, tEntry);
+      for (int i = 0; i < 8; ++i) {
+        if (hitMask & (1 << i)) {
+          assert(stackSize < MAX_STACK_SIZE);
+          stack[stackSize++] = {node.child[i], node.nPrimitives[i],
+                                tEntry[i]};
+        }
+      }
+    }
+
+    return false;
+  }
+
+ public:
+  BVH8() {}
+  BVH8(const std::vector<T>& primitives) : Intersector<T>(primitives) {}
+
+  bool build() override {
+    nodes.clear();
+    stats = typename BVH<T, strategy>::BVHStatistics();
+    this->triangleBlocks.clear();
+    this->leafPrimIndices.clear();
+
+    // build binary bvh
+    BVHBuilder<T, strategy> builder(referenceBudget);
+    builder.build(this->primitives);
+
+    // collapse binary bvh into 8-wide bvh, then reorder primitives at once
+    const std::vector<BVHBuildNode>& binaryNodes = builder.getNodesRef();
+    if (binaryNodes.size() > 0) {
+      collapse(binaryNodes, 0);
+      builder.reorderPrimitives(this->primitives, this->leafPrimIndices);
+      // pack primitives of each leaf
+      for (const BVHBuildNode& node : binaryNodes) {
+        if (node.isLeaf()) this->packLeaf(node.refStart, node.nRefs);
+      }
+    }
+    stats.nNodes = stats.nInternalNodes + stats.nLeafNodes;
+    builtSAHCost = computeSAHCost();
+
+    spdlog::info("[BVH8] nPrimitives: " +
+                 std::to_string(this->primitives.size()));
+    spdlog::info("[BVH8] nNodes: " + std::to_string(stats.nNodes));
+    spdlog::info("[BVH8] nInternalNodes: " +
+                 std::to_string(stats.nInternalNodes));
+    spdlog::info("[BVH8] nLeafNodes: " + std::to_string(stats.nLeafNodes));
+
+    return true;
+  }
+
+  // refit bounds of all nodes after primitives are moved
+  // whole tree is rebuilt when its SAH cost degrades too much
+  bool refit() override {
+    if (nodes.size() == 0) return true;
+
+#pragma omp parallel
+#pragma omp single
+    refitNode(0, 0);
+
+    const float sahCost = computeSAHCost();
+    if (sahCost > rebuildThreshold * builtSAHCost) {
+      spdlog::info("[BVH8] SAH cost degraded from " +
+                   std::to_string(builtSAHCost) + " to " +
+                   std::to_string(sahCost) + ", rebuilding");
+      return build();
+    }
+    return true;
+  }
+
+  // save nodes and primitive order into cache file(triangles only)
+  bool saveCache(const std::filesystem::path& filepath,
+                 uint64_t key) const override {
+    if constexpr (TriangleLike<T>) {
+      return saveBVHCache(filepath, "BVH8", cacheKey(key), nodes,
+                          this->primitives, this->leafPrimIndices);
+    } else {
+      return false;
+    }
+  }
+
+  // adopt nodes and primitive order of cache file instead of building
+  bool loadCache(
+      const std::filesystem::path& filepath, uint64_t key, unsigned int nFaces,
+      const std::function<T(unsigned int)>& makePrimitive) override {
+    if constexpr (TriangleLike<T>) {
+      if (!loadBVHCache(
+              filepath, "BVH8", cacheKey(key), nFaces, nodes, this->primitives,
+              this->leafPrimIndices, makePrimitive,
+              [this](uint64_t nSlots) { return isValidTree(nSlots); })) {
+        return false;
+      }
+      packNodeLeaves();
+      builtSAHCost = computeSAHCost();
+
+      spdlog::info("[BVH8] nPrimitives: " +
+                   std::to_string(this->primitives.size()));
+      spdlog::info("[BVH8] nNodes: " + std::to_string(stats.nNodes));
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+  // set number of extra references allowed by spatial splits, relative to
+  // number of primitives(SBVH only)
+  void setReferenceBudget(float budget) { referenceBudget = budget; }
+
+  // set ratio of SAH cost degradation which makes refit rebuild the tree
+  void setRebuildThreshold(float threshold) { rebuildThreshold = threshold; }
+
+  // number of nodes
+  int nNodes() const { return stats.nNodes; }
+  // number of internal nodes
+  int nInternalNodes() const { return stats.nInternalNodes; }
+  // number of leaf nodes
+  int nLeafNodes() const { return stats.nLeafNodes; }
+
+  AABB aabb() const override {
+    AABB ret;
+    if (nodes.size() > 0) {
+      for (int i = 0; i < 8; ++i) {
+        ret = mergeAABB(ret, childAABB(nodes[0], i));
+      }
+    }
+    return ret;
+  }
+
+  bool intersect(const Ray& ray, IntersectInfo& info) const override {
+    TraversalStats::Scope scope(TraversalQuery::CLOSEST);
+    if (nodes.size() == 0) return false;
+    // traverse from root node
+    return intersectNode(ray, prepareRay(ray), info);
+  }
+
+  bool intersectP(const Ray& ray) const override {
+    TraversalStats::Scope scope(TraversalQuery::OCCLUSION);
+    if (nodes.size() == 0) return false;
+    if (this->intersectLastOccluder(ray)) return true;
+    // traverse from root node
+    return intersectNodeP(ray, prepareRay(ray));
+  }
+};
+
+}  // namespace LTRE
+
+#endif
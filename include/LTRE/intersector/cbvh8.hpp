@@ -0,0 +1,684 @@
+#ifndef _LTRE_CBVH8_H
+#define _LTRE_CBVH8_H
+#include <immintrin.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#include "LTRE/intersector/bvh.hpp"
+#include "LTRE/intersector/intersector.hpp"
+
+namespace LTRE {
+
+// compressed 8-wide BVH, built by collapsing binary BVH
+// bounds of children are quantized into 8bit offsets on a grid of each node,
+// whose cell size is power of two, then decoded with AVX2 during traversal.
+// internal children and primitives of leaf children are stored contiguously,
+// so that a node refers them by base index only
+// https://research.nvidia.com/publication/2017-07_efficient-incoherent-ray-traversal-gpus-through-compressed-wide-bvhs
+template <Intersectable T, BVHSplitStrategy strategy>
+class CBVH8 : public Intersector<T> {
+ private:
+  using LeafRay = typename Intersector<T>::LeafRay;
+
+  // NOTE: 80Byte node replaces 256Byte node of BVH8
+  struct alignas(16) BVHNode {
+    float origin[3];       // minimum corner of grid
+    int8_t exponent[3];    // cell size of grid is 2^exponent
+    uint8_t internalMask;  // i-th bit is set if i-th child is internal
+    uint32_t childBase;    // index of first internal child
+    uint32_t primBase;     // index of first primitive of leaf children
+    uint32_t nPrimitives;  // 4bit number of primitives of each leaf child
+    uint8_t qlo[3][8];     // quantized minimum corner of children
+    uint8_t qhi[3][8];     // quantized maximum corner of children
+  };
+
+  static_assert(BVHBuilder<T, strategy>::MAX_PRIMITIVES_IN_LEAF < 16,
+                "number of primitives in leaf must fit in 4bit");
+
+  // maximum number of deferred children during traversal
+  // NOTE: at most 7 children per level are deferred, and CBVH8 is never
+  // deeper than binary BVH it's collapsed from
+  static constexpr int MAX_STACK_SIZE = 7 * BVH_MAX_DEPTH + 1;
+
+  // deferred child on traversal stack
+  struct StackEntry {
+    uint32_t child;        // index of child node, or index of first prim
+    uint32_t nPrimitives;  // number of primitives if child is leaf
+    float tEntry;          // distance where ray enters the child
+  };
+
+  std::vector<BVHNode> nodes;
+  typename BVH<T, strategy>::BVHStatistics stats;
+  // number of extra references allowed by spatial splits(SBVH only)
+  float referenceBudget{BVHBuilder<T, strategy>::DEFAULT_REFERENCE_BUDGET};
+  // refit rebuilds tree when SAH cost exceeds this ratio of builtSAHCost
+  float rebuildThreshold{BVHBuilder<T, strategy>::DEFAULT_REBUILD_THRESHOLD};
+  float builtSAHCost{0};  // SAH cost right after build
+
+  // subtrees shallower than this depth are refitted as separate tasks
+  static constexpr int PARALLEL_REFIT_DEPTH = 4;
+
+  // 2^exponent
+  static float cellSize(int8_t exponent) {
+    return std::bit_cast<float>(static_cast<uint32_t>(exponent + 127) << 23);
+  }
+
+  // number of primitives of i-th child(0 if child is internal or empty)
+  static uint32_t childPrimitives(const BVHNode& node, int i) {
+    return (node.nPrimitives >> (4 * i)) & 0xf;
+  }
+
+  // index of i-th child node
+  static uint32_t childIndex(const BVHNode& node, int i) {
+    return node.childBase +
+           std::popcount(static_cast<uint32_t>(node.internalMask) &
+                         ((1u << i) - 1));
+  }
+
+  // index of first primitive of i-th child
+  // NOTE: sum of 4bit counts of preceding children, never exceeds 8 * 15
+  static uint32_t childPrimStart(const BVHNode& node, int i) {
+    const uint32_t counts =
+        i == 0 ? 0 : node.nPrimitives & (0xffffffffu >> (32 - 4 * i));
+    const uint32_t pairs = (counts & 0x0f0f0f0f) + ((counts >> 4) & 0x0f0f0f0f);
+    return node.primBase + ((pairs * 0x01010101) >> 24);
+  }
+
+  // AABB of i-th child of node
+  static AABB childAABB(const BVHNode& node, int i) {
+    Vec3 pMin, pMax;
+    for (int j = 0; j < 3; ++j) {
+      const float scale = cellSize(node.exponent[j]);
+      pMin[j] = node.origin[j] + node.qlo[j][i] * scale;
+      pMax[j] = node.origin[j] + node.qhi[j][i] * scale;
+    }
+    return AABB(pMin, pMax);
+  }
+
+  // quantize child boxes onto grid which covers all of them
+  // NOTE: corners are rounded outward, so decoded box always contains child
+  static void quantizeChildren(BVHNode& node, const AABB childBoxes[8]) {
+    AABB bbox;
+    for (int i = 0; i < 8; ++i) {
+      bbox = mergeAABB(bbox, childBoxes[i]);
+    }
+
+    for (int j = 0; j < 3; ++j) {
+      // empty node has no child, any grid will do
+      const float origin = bbox.isEmpty() ? 0 : bbox.bounds[0][j];
+      const float top = bbox.isEmpty() ? 0 : bbox.bounds[1][j];
+      int exponent =
+          top > origin
+              ? static_cast<int>(std::ceil(std::log2((top - origin) / 255.0f)))
+              : -126;
+      exponent = std::clamp(exponent, -126, 127);
+      // rounding may leave top of the grid below the box
+      while (exponent < 127 && origin + 255.0f * cellSize(exponent) < top) {
+        exponent++;
+      }
+      node.origin[j] = origin;
+      node.exponent[j] = exponent;
+
+      const float scale = cellSize(exponent);
+      for (int i = 0; i < 8; ++i) {
+        // empty child is inverted box. it still can be hit when grid of node
+        // is too fine to invert it, so traversal masks hits with childMask
+        if (childBoxes[i].isEmpty()) {
+          node.qlo[j][i] = 255;
+          node.qhi[j][i] = 0;
+          continue;
+        }
+
+        const float cMin = childBoxes[i].bounds[0][j];
+        const float cMax = childBoxes[i].bounds[1][j];
+        int qlo = std::clamp(
+            static_cast<int>(std::floor((cMin - origin) / scale)), 0, 255);
+        int qhi = std::clamp(
+            static_cast<int>(std::ceil((cMax - origin) / scale)), 0, 255);
+        while (qlo > 0 && origin + qlo * scale > cMin) qlo--;
+        while (qhi < 255 && origin + qhi * scale < cMax) qhi++;
+        node.qlo[j][i] = qlo;
+        node.qhi[j][i] = qhi;
+      }
+    }
+  }
+
+  // leaf which is packed after primitives are placed
+  struct Leaf {
+    uint32_t primStart;
+    uint32_t nPrims;
+  };
+
+  // collapse binary subtree into 8-wide node at nodeIdx
+  // leaf slots of binary bvh are appended to slotOrder in child order
+  void collapse(const std::vector<BVHBuildNode>& binaryNodes,
+                uint32_t binaryIdx, uint32_t nodeIdx,
+                std::vector<uint32_t>& slotOrder, std::vector<Leaf>& leaves) {
+    // gather up to 8 children, open the largest internal child first
+    uint32_t children[8];
+    int nChildren = 0;
+    if (binaryNodes[binaryIdx].isLeaf()) {
+      children[nChildren++] = binaryIdx;
+    } else {
+      children[nChildren++] = binaryNodes[binaryIdx].child[0];
+      children[nChildren++] = binaryNodes[binaryIdx].child[1];
+    }
+    while (nChildren < 8) {
+      int largest = -1;
+      float largestArea = -1.0f;
+      for (int i = 0; i < nChildren; ++i) {
+        const BVHBuildNode& child = binaryNodes[children[i]];
+        if (!child.isLeaf() && child.bbox.surfaceArea() > largestArea) {
+          largest = i;
+          largestArea = child.bbox.surfaceArea();
+        }
+      }
+      if (largest < 0) break;
+
+      const BVHBuildNode& child = binaryNodes[children[largest]];
+      children[largest] = child.child[0];
+      children[nChildren++] = child.child[1];
+    }
+
+    // allocate internal children contiguously, place leaf primitives
+    // NOTE: populate internal children later
+    BVHNode node{};
+    node.childBase = nodes.size();
+    node.primBase = slotOrder.size();
+    AABB childBoxes[8];
+    for (int i = 0; i < nChildren; ++i) {
+      const BVHBuildNode& binaryNode = binaryNodes[children[i]];
+      childBoxes[i] = binaryNode.bbox;
+      if (binaryNode.isLeaf()) {
+        leaves.push_back(
+            {static_cast<uint32_t>(slotOrder.size()), binaryNode.nRefs});
+        for (uint32_t j = 0; j < binaryNode.nRefs; ++j) {
+          slotOrder.push_back(binaryNode.refStart + j);
+        }
+        node.nPrimitives |= binaryNode.nRefs << (4 * i);
+        stats.nLeafNodes++;
+      } else {
+        node.internalMask |= 1 << i;
+        stats.nInternalNodes++;
+      }
+    }
+    quantizeChildren(node, childBoxes);
+    nodes.resize(nodes.size() + std::popcount(node.internalMask));
+    nodes[nodeIdx] = node;
+
+    for (int i = 0; i < nChildren; ++i) {
+      if (node.internalMask & (1 << i)) {
+        collapse(binaryNodes, children[i], childIndex(node, i), slotOrder,
+                 leaves);
+      }
+    }
+  }
+
+  // refit bounds of subtree bottom-up, return AABB of the node
+  AABB refitNode(uint32_t nodeIdx, int depth) {
+    BVHNode& node = nodes[nodeIdx];
+    AABB childBoxes[8];
+    for (int i = 0; i < 8; ++i) {
+      const uint32_t nPrims = childPrimitives(node, i);
+      if (nPrims > 0) {
+        childBoxes[i] = this->refitLeaf(childPrimStart(node, i), nPrims);
+      } else if (node.internalMask & (1 << i)) {
+        const uint32_t child = childIndex(node, i);
+        if (depth < PARALLEL_REFIT_DEPTH) {
+#pragma omp task default(shared) firstprivate(i, child, depth)
+          childBoxes[i] = refitNode(child, depth + 1);
+        } else {
+          childBoxes[i] = refitNode(child, depth + 1);
+        }
+      }
+    }
+#pragma omp taskwait
+
+    quantizeChildren(node, childBoxes);
+    AABB bbox;
+    for (int i = 0; i < 8; ++i) {
+      bbox = mergeAABB(bbox, childBoxes[i]);
+    }
+    return bbox;
+  }
+
+  // mix build parameters into key of cache
+  uint64_t cacheKey(uint64_t key) const {
+    return ContentHash(key).add(strategy).add(referenceBudget).get();
+  }
+
+  // i-th bit is set if i-th child exists(internal or non-empty leaf)
+  static int childMask(const BVHNode& node) {
+    // gather "nibble is non-zero" flags of leaf counts into low 8 bits
+    uint32_t x = node.nPrimitives;
+    x |= x >> 1;
+    x |= x >> 2;
+    x &= 0x11111111u;
+    x = (x | (x >> 3)) & 0x03030303u;
+    x = (x | (x >> 6)) & 0x000f000fu;
+    x = (x | (x >> 12)) & 0xffu;
+    return static_cast<int>(x) | node.internalMask;
+  }
+
+  // whether i-th child of node exists
+  static bool hasChild(const BVHNode& node, int i) {
+    return childMask(node) & (1 << i);
+  }
+
+  // SAH cost of the tree, normalized by surface area of root node
+  float computeSAHCost() const {
+    const float rootArea = aabb().surfaceArea();
+    if (nodes.size() == 0 || rootArea <= 0) return 0;
+
+    float cost = 0;
+#pragma omp parallel for reduction(+ : cost)
+    for (std::size_t n = 0; n < nodes.size(); ++n) {
+      AABB bbox;
+      for (int i = 0; i < 8; ++i) {
+        if (!hasChild(nodes[n], i)) continue;
+
+        const AABB childbox = childAABB(nodes[n], i);
+        bbox = mergeAABB(bbox, childbox);
+        cost += childbox.surfaceArea() * childPrimitives(nodes[n], i) *
+                BVHBuilder<T, strategy>::INTERSECT_COST;
+      }
+      cost += bbox.surfaceArea() * BVHBuilder<T, strategy>::TRAVERSE_COST;
+    }
+    return cost / rootArea;
+  }
+
+  // pack primitives of all leaves and count nodes, used when nodes are
+  // loaded from cache instead of being built
+  void packNodeLeaves() {
+    stats = typename BVH<T, strategy>::BVHStatistics();
+    this->triangleBlocks.clear();
+    for (const BVHNode& node : nodes) {
+      stats.nInternalNodes++;
+      for (int i = 0; i < 8; ++i) {
+        const uint32_t nPrims = childPrimitives(node, i);
+        if (nPrims > 0) {
+          this->packLeaf(childPrimStart(node, i), nPrims);
+          stats.nLeafNodes++;
+        }
+      }
+    }
+    stats.nNodes = stats.nInternalNodes + stats.nLeafNodes;
+  }
+
+  // check that nodes loaded from cache form a tree no deeper than
+  // BVH_MAX_DEPTH, whose children and leaves are in bounds
+  bool isValidTree(uint64_t nSlots) const {
+    if (nodes.empty()) return nSlots == 0;
+    std::vector<std::pair<uint32_t, int>> stack = {{0, 0}};
+    std::size_t nVisited = 0;
+    while (!stack.empty()) {
+      const auto [nodeIdx, depth] = stack.back();
+      stack.pop_back();
+      // NOTE: depth also bounds cycles, number of visits bounds shared nodes
+      if (depth >= BVH_MAX_DEPTH || ++nVisited > nodes.size()) return false;
+
+      const BVHNode& node = nodes[nodeIdx];
+      for (int i = 0; i < 8; ++i) {
+        // NOTE: traversal tells leaf from internal child by number of
+        // primitives, so that child must not be both of them
+        const bool isInternal = node.internalMask & (1 << i);
+        if (isInternal && childPrimitives(node, i) > 0) return false;
+        // slot which is neither must be encoded as empty child
+        if (!isInternal && childPrimitives(node, i) == 0) {
+          for (int j = 0; j < 3; ++j) {
+            if (node.qlo[j][i] != 255 || node.qhi[j][i] != 0) return false;
+          }
+          continue;
+        }
+
+        // NOTE: offsets are added in 64bit, so that they never wrap around
+        if (isInternal) {
+          const uint64_t child =
+              node.childBase + uint64_t(childIndex(node, i) - node.childBase);
+          if (child == 0 || child >= nodes.size()) return false;
+          stack.push_back({static_cast<uint32_t>(child), depth + 1});
+        } else {
+          const uint64_t primEnd =
+              node.primBase +
+              uint64_t(childPrimStart(node, i) - node.primBase) +
+              childPrimitives(node, i);
+          if (primEnd > nSlots) return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  // ray data for traversal
+  struct RayData {
+    Vec3 dirInv;
+    int dirInvSign[3];
+    LeafRay leafRay;
+#ifdef __AVX2__
+    __m256 orig[3];
+    __m256 dirInv8[3];
+#endif
+  };
+
+  static RayData prepareRay(const Ray& ray) {
+    RayData ret;
+    ret.leafRay = LeafRay(ray);
+    // precompute ray's inversed direction, sign of direction
+    ret.dirInv = 1.0f / ray.direction;
+    for (int i = 0; i < 3; ++i) {
+      ret.dirInvSign[i] = ret.dirInv[i] > 0 ? 0 : 1;
+#ifdef __AVX2__
+      ret.orig[i] = _mm256_set1_ps(ray.origin[i]);
+      ret.dirInv8[i] = _mm256_set1_ps(ret.dirInv[i]);
+#endif
+    }
+    return ret;
+  }
+
+#ifdef __AVX2__
+  // decode 8bit offsets of 8 children into planes
+  // NOTE: offset times power of two is exact, so decoded planes match the
+  // ones checked by quantizeChildren
+  static __m256 decodePlanes(const uint8_t q[8], __m256 origin, __m256 scale) {
+    const __m256 offset = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(q))));
+    return _mm256_add_ps(origin, _mm256_mul_ps(offset, scale));
+  }
+#endif
+
+  // decode and intersect 8 children aabb, return hit mask and entry distance
+  // of each
+  static int intersectAABB(const BVHNode& node, const Ray& ray,
+                           const RayData& rayData, float tEntry[8]) {
+#ifdef __AVX2__
+    __m256 tmin = _mm256_set1_ps(ray.tmin);
+    __m256 tmax = _mm256_set1_ps(ray.tmax);
+    const __m256 farScale = _mm256_set1_ps(SLAB_FAR_SCALE);
+    for (int i = 0; i < 3; ++i) {
+      const uint8_t* qNear = rayData.dirInvSign[i] ? node.qhi[i] : node.qlo[i];
+      const uint8_t* qFar = rayData.dirInvSign[i] ? node.qlo[i] : node.qhi[i];
+      const __m256 origin = _mm256_set1_ps(node.origin[i]);
+      const __m256 scale = _mm256_set1_ps(cellSize(node.exponent[i]));
+
+      const __m256 near = decodePlanes(qNear, origin, scale);
+      const __m256 far = decodePlanes(qFar, origin, scale);
+      const __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(near, rayData.orig[i]),
+                                      rayData.dirInv8[i]);
+      const __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(far, rayData.orig[i]),
+                                      rayData.dirInv8[i]);
+      tmin = _mm256_max_ps(tmin, t0);
+      tmax = _mm256_min_ps(tmax, _mm256_mul_ps(t1, farScale));
+    }
+    _mm256_storeu_ps(tEntry, tmin);
+#ifdef __AVX512VL__
+    return _mm256_cmp_ps_mask(tmin, tmax, _CMP_LE_OQ) & childMask(node);
+#else
+    return _mm256_movemask_ps(_mm256_cmp_ps(tmin, tmax, _CMP_LE_OQ)) &
+           childMask(node);
+#endif
+#else
+    int mask = 0;
+    for (int i = 0; i < 8; ++i) {
+      if (!hasChild(node, i)) continue;
+      if (childAABB(node, i).intersect(ray, rayData.dirInv,
+                                       rayData.dirInvSign, tEntry[i])) {
+        tEntry[i] = std::max(tEntry[i], ray.tmin);
+        mask |= (1 << i);
+      }
+    }
+    return mask;
+#endif
+  }
+
+  // deferred entry of i-th child
+  static StackEntry childEntry(const BVHNode& node, int i, float tEntry) {
+    const uint32_t nPrims = childPrimitives(node, i);
+    if (nPrims > 0) {
+      return {childPrimStart(node, i), nPrims, tEntry};
+    } else {
+      return {childIndex(node, i), 0, tEntry};
+    }
+  }
+
+  // traverse CBVH8 iteratively, visit children in front-to-back order
+  bool intersectNode(const Ray& ray, const RayData& rayData,
+                     IntersectInfo& info) const {
+    bool hit = false;
+
+    StackEntry stack[MAX_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = {0, 0, ray.tmin};
+    while (stackSize > 0) {
+      const StackEntry entry = stack[--stackSize];
+      // skip child which is beyond the closest hit
+      if (entry.tEntry > ray.tmax) continue;
+      TraversalStats::countNode();
+
+      // leaf node
+      if (entry.nPrimitives > 0) {
+        // test intersection with all primitives in this node
+        if (this->intersectLeaf(entry.child, entry.nPrimitives, ray,
+                                rayData.leafRay, info)) {
+          hit = true;
+        }
+        continue;
+      }
+
+      // internal node
+      const BVHNode& node = nodes[entry.child];
+      float tEntry[8];
+      TraversalStats::countBoxes(8);
+      const int hitMask = intersectAABB(node, ray, rayData, tEntry);
+      if (hitMask == 0) continue;
+
+      // sort hit children by entry distance(insertion sort, descending)
+      int hitChildren[8];
+      int nHits = 0;
+      for (int i = 0; i < 8; ++i) {
+        if (!(hitMask & (1 << i))) continue;
+        int j = nHits++;
+        while (j > 0 && tEntry[hitChildren[j - 1]] < tEntry[i]) {
+          hitChildren[j] = hitChildren[j - 1];
+          j--;
+        }
+        hitChildren[j] = i;
+      }
+
+      // push farthest child first, then nearest child is popped first
+      for (int i = 0; i < nHits; ++i) {
+        const int c = hitChildren[i];
+        assert(stackSize < MAX_STACK_SIZE);
+        stack[stackSize++] = childEntry(node, c, tEntry[c]);
+      }
+    }
+
+    return hit;
+  }
+
+  // traverse CBVH8 iteratively, terminate at the first hit
+  bool intersectNodeP(const Ray& ray, const RayData& rayData) const {
+    StackEntry stack[MAX_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = {0, 0, ray.tmin};
+    while (stackSize > 0) {
+      const StackEntry entry = stack[--stackSize];
+      TraversalStats::countNode();
+
+      // leaf node
+      if (entry.nPrimitives > 0) {
+        // test intersection with all primitives in this node
+        if (this->intersectLeafP(entry.child, entry.nPrimitives, ray,
+                                 rayData.leafRay)) {
+          return true;
+        }
+        continue;
+      }
+
+      // internal node
+      const BVHNode& node = nodes[entry.child];
+      float tEntry[8];
+      TraversalStats::countBoxes(8);
+      const int hitMask = intersectAABB(node, ray, rayData, tEntry);
+      for (int i = 0; i < 8; ++i) {
+        if (hitMask & (1 << i)) {
+          assert(stackSize < MAX_STACK_SIZE);
+          stack[stackSize++] = childEntry(node, i, tEntry[i]);
+        }
+      }
+    }
+
+    return false;
+  }
+
+ public:
+  CBVH8() {}
+  CBVH8(const std::vector<T>& primitives) : Intersector<T>(primitives) {}
+
+  bool build() override {
+    nodes.clear();
+    stats = typename BVH<T, strategy>::BVHStatistics();
+    this->triangleBlocks.clear();
+    this->leafPrimIndices.clear();
+
+    // build binary bvh
+    BVHBuilder<T, strategy> builder(referenceBudget);
+    builder.build(this->primitives);
+
+    // collapse binary bvh into 8-wide bvh, primitives are placed in order of
+    // leaf children
+    const std::vector<BVHBuildNode>& binaryNodes = builder.getNodesRef();
+    if (binaryNodes.size() > 0) {
+      std::vector<uint32_t> slotOrder;
+      slotOrder.reserve(builder.getRefsRef().size());
+      std::vector<Leaf> leaves;
+      nodes.emplace_back();
+      stats.nInternalNodes++;
+      collapse(binaryNodes, 0, 0, slotOrder, leaves);
+
+      // place primitives(or indices of them) in order of leaf children at
+      // once
+      builder.reorderPrimitives(this->primitives, this->leafPrimIndices,
+                                slotOrder);
+
+      // pack primitives of each leaf
+      for (const Leaf& leaf : leaves) {
+        this->packLeaf(leaf.primStart, leaf.nPrims);
+      }
+    }
+    stats.nNodes = stats.nInternalNodes + stats.nLeafNodes;
+    builtSAHCost = computeSAHCost();
+
+    spdlog::info("[CBVH8] nPrimitives: " +
+                 std::to_string(this->primitives.size()));
+    spdlog::info("[CBVH8] nNodes: " + std::to_string(stats.nNodes));
+    spdlog::info("[CBVH8] nInternalNodes: " +
+                 std::to_string(stats.nInternalNodes));
+    spdlog::info("[CBVH8] nLeafNodes: " + std::to_string(stats.nLeafNodes));
+    spdlog::info("[CBVH8] node memory: " + std::to_string(nodeMemory()) +
+                 " bytes");
+
+    return true;
+  }
+
+  // refit bounds of all nodes after primitives are moved
+  // whole tree is rebuilt when its SAH cost degrades too much
+  bool refit() override {
+    if (nodes.size() == 0) return true;
+
+#pragma omp parallel
+#pragma omp single
+    refitNode(0, 0);
+
+    const float sahCost = computeSAHCost();
+    if (sahCost > rebuildThreshold * builtSAHCost) {
+      spdlog::info("[CBVH8] SAH cost degraded from " +
+                   std::to_string(builtSAHCost) + " to " +
+                   std::to_string(sahCost) + ", rebuilding");
+      return build();
+    }
+    return true;
+  }
+
+  // save nodes and primitive order into cache file(triangles only)
+  bool saveCache(const std::filesystem::path& filepath,
+                 uint64_t key) const override {
+    if constexpr (TriangleLike<T>) {
+      return saveBVHCache(filepath, "CBVH8", cacheKey(key), nodes,
+                          this->primitives, this->leafPrimIndices);
+    } else {
+      return false;
+    }
+  }
+
+  // adopt nodes and primitive order of cache file instead of building
+  bool loadCache(
+      const std::filesystem::path& filepath, uint64_t key, unsigned int nFaces,
+      const std::function<T(unsigned int)>& makePrimitive) override {
+    if constexpr (TriangleLike<T>) {
+      if (!loadBVHCache(
+              filepath, "CBVH8", cacheKey(key), nFaces, nodes, this->primitives,
+              this->leafPrimIndices, makePrimitive,
+              [this](uint64_t nSlots) { return isValidTree(nSlots); })) {
+        return false;
+      }
+      packNodeLeaves();
+      builtSAHCost = computeSAHCost();
+
+      spdlog::info("[CBVH8] nPrimitives: " +
+                   std::to_string(this->primitives.size()));
+      spdlog::info("[CBVH8] nNodes: " + std::to_string(stats.nNodes));
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+  // set number of extra references allowed by spatial splits, relative to
+  // number of primitives(SBVH only)
+  void setReferenceBudget(float budget) { referenceBudget = budget; }
+
+  // set ratio of SAH cost degradation which makes refit rebuild the tree
+  void setRebuildThreshold(float threshold) { rebuildThreshold = threshold; }
+
+  // number of nodes
+  int nNodes() const { return stats.nNodes; }
+  // number of internal nodes
+  int nInternalNodes() const { return stats.nInternalNodes; }
+  // number of leaf nodes
+  int nLeafNodes() const { return stats.nLeafNodes; }
+  // size of node array in bytes
+  std::size_t nodeMemory() const { return nodes.size() * sizeof(BVHNode); }
+
+  AABB aabb() const override {
+    AABB ret;
+    if (nodes.size() > 0) {
+      for (int i = 0; i < 8; ++i) {
+        if (hasChild(nodes[0], i)) {
+          ret = mergeAABB(ret, childAABB(nodes[0], i));
+        }
+      }
+    }
+    return ret;
+  }
+
+  bool intersect(const Ray& ray, IntersectInfo& info) const override {
+    TraversalStats::Scope scope(TraversalQuery::CLOSEST);
+    if (nodes.size() == 0) return false;
+    // traverse from root node
+    return intersectNode(ray, prepareRay(ray), info);
+  }
+
+  bool intersectP(const Ray& ray) const override {
+    TraversalStats::Scope scope(TraversalQuery::OCCLUSION);
+    if (nodes.size() == 0) return false;
+    if (this->intersectLastOccluder(ray)) return true;
+    // traverse from root node
+    return intersectNodeP(ray, prepareRay(ray));
+  }
+};
+
+}  // namespace LTRE
+
+#endif
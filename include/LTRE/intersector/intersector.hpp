@@ -1,8 +1,16 @@
 #ifndef _LTRE_INTERSECTOR_H
 #define _LTRE_INTERSECTOR_H
+#include <bit>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <type_traits>
 #include <vector>
 
 #include "LTRE/core/primitive.hpp"
+#include "LTRE/core/ray-packet.hpp"
+#include "LTRE/intersector/traversal-stats.hpp"
+#include "LTRE/intersector/triangle-blocks.hpp"
 
 namespace LTRE {
 
@@ -12,10 +20,176 @@ concept Intersectable = requires(T& x, const Ray& ray, IntersectInfo& info) {
   x.aabb();
 };
 
+// primitive which traces packet of rays by itself(e.g. Primitive of mesh)
+template <typename T>
+concept PacketIntersectable = requires(const T& x, const RayPacket& packet,
+                                       uint32_t activeMask,
+                                       IntersectInfo* info) {
+  x.intersectPacket(packet, activeMask, info);
+};
+
+// primitive which records which Primitive of scene it belongs to(e.g.
+// triangle of flattened scene)
+template <typename T>
+concept PrimitiveTagged = requires(const T& x) {
+  { x.primID } -> std::convertible_to<uint32_t>;
+};
+
 template <Intersectable T>
 class Intersector {
+ private:
+  // primitive which occluded the last shadow ray of this thread
+  // NOTE: occluders of consecutive shadow rays are likely to be the same, so
+  // that it's tested before traversal. any primitive is a valid guess, so it's
+  // only checked that index is in range
+  struct LastOccluder {
+    const Intersector* intersector = nullptr;
+    uint32_t primIdx = 0;
+  };
+  inline static thread_local LastOccluder lastOccluder;
+
+  struct NoLeafRay {
+    NoLeafRay() {}
+    NoLeafRay(const Ray&) {}
+  };
+
  protected:
   std::vector<T> primitives;
+  // primitive of each leaf slot, empty when primitives themselves are placed
+  // in leaf order
+  // NOTE: spatial splits put a primitive into several leaves, then
+  // primitives are kept as they are and leaves refer them through this
+  std::vector<uint32_t> leafPrimIndices;
+  TriangleBlocks triangleBlocks;  // packed leaves(only when T is triangle)
+
+  // precomputation of ray shared by all leaf tests in one traversal
+  // NOTE: only triangles use it
+  using LeafRay = std::conditional_t<TriangleLike<T>, TriangleRay, NoLeafRay>;
+
+  // primitive placed at i-th leaf slot
+  const T& leafPrimitive(uint32_t i) const {
+    return leafPrimIndices.empty() ? primitives[i]
+                                   : primitives[leafPrimIndices[i]];
+  }
+
+  // pack primitives of leaf(leaf slots [primStart, primStart + nPrims))
+  // NOTE: must be called after primitives are placed in leaf order
+  void packLeaf(uint32_t primStart, uint32_t nPrims) {
+    if constexpr (TriangleLike<T>) {
+      triangleBlocks.addLeaf(
+          primStart, nPrims,
+          [&](uint32_t i) -> const T& { return leafPrimitive(i); });
+    }
+  }
+
+  // recompute AABB of leaf from its primitives after they are moved, packed
+  // primitives of the leaf are also updated
+  // NOTE: different leaves can be refitted in parallel
+  AABB refitLeaf(uint32_t primStart, uint32_t nPrims) {
+    AABB bbox;
+    for (uint32_t i = primStart; i < primStart + nPrims; ++i) {
+      bbox = mergeAABB(bbox, leafPrimitive(i).aabb());
+    }
+    if constexpr (TriangleLike<T>) {
+      triangleBlocks.updateLeaf(
+          primStart, nPrims,
+          [&](uint32_t i) -> const T& { return leafPrimitive(i); });
+    }
+    return bbox;
+  }
+
+  // test closest intersection with all primitives in leaf
+  // NOTE: ray.tmax is shortened to the distance of the hit
+  bool intersectLeaf(uint32_t primStart, uint32_t nPrims, const Ray& ray,
+                     const LeafRay& leafRay, IntersectInfo& info) const {
+    TraversalStats::countPrimitives(nPrims);
+    if constexpr (TriangleLike<T>) {
+      float u, v;
+      const int primIdx =
+          triangleBlocks.intersect(primStart, nPrims, ray, leafRay, u, v);
+      if (primIdx < 0) return false;
+
+      info.t = ray.tmax;
+      info.barycentric[0] = u;
+      info.barycentric[1] = v;
+      const T& primitive = leafPrimitive(primIdx);
+      info.faceID = primitive.faceID;
+      if constexpr (PrimitiveTagged<T>) {
+        info.primID = primitive.primID;
+      }
+      return true;
+    } else {
+      bool hit = false;
+      for (uint32_t i = primStart; i < primStart + nPrims; ++i) {
+        if (leafPrimitive(i).intersect(ray, info)) {
+          ray.tmax = info.t;
+          hit = true;
+        }
+      }
+      return hit;
+    }
+  }
+
+  // test closest intersection of rays in mask with all primitives in leaf,
+  // return mask of hit rays
+  // NOTE: ray.tmax of hit rays is shortened to the distance of the hit
+  uint32_t intersectLeafPacket(uint32_t primStart, uint32_t nPrims,
+                               const RayPacket& packet,
+                               const LeafRay leafRays[RayPacket::SIZE],
+                               uint32_t mask,
+                               IntersectInfo info[RayPacket::SIZE]) const {
+    uint32_t hitMask = 0;
+    if constexpr (PacketIntersectable<T>) {
+      TraversalStats::countPrimitives(nPrims * std::popcount(mask));
+      for (uint32_t i = primStart; i < primStart + nPrims; ++i) {
+        hitMask |= leafPrimitive(i).intersectPacket(packet, mask, info);
+      }
+    } else {
+      for (; mask > 0; mask &= mask - 1) {
+        const int r = std::countr_zero(mask);
+        if (intersectLeaf(primStart, nPrims, packet.rays[r], leafRays[r],
+                          info[r])) {
+          hitMask |= 1u << r;
+        }
+      }
+    }
+    return hitMask;
+  }
+
+  // test any intersection with primitives in leaf, the occluder is cached
+  // as last occluder of this thread
+  bool intersectLeafP(uint32_t primStart, uint32_t nPrims, const Ray& ray,
+                      const LeafRay& leafRay) const {
+    if constexpr (TriangleLike<T>) {
+      // NOTE: all triangles of leaf are tested at once in blocks
+      TraversalStats::countPrimitives(nPrims);
+      const int primIdx =
+          triangleBlocks.intersectP(primStart, nPrims, ray, leafRay);
+      if (primIdx < 0) return false;
+      lastOccluder = {this, static_cast<uint32_t>(primIdx)};
+      return true;
+    } else {
+      for (uint32_t i = primStart; i < primStart + nPrims; ++i) {
+        TraversalStats::countPrimitives(1);
+        if (leafPrimitive(i).intersectP(ray)) {
+          lastOccluder = {this, i};
+          return true;
+        }
+      }
+      return false;
+    }
+  }
+
+  // test last occluder of this thread before traversal of shadow ray
+  bool intersectLastOccluder(const Ray& ray) const {
+    const LastOccluder& occluder = lastOccluder;
+    if (occluder.intersector != this ||
+        occluder.primIdx >= nLeafPrimitives()) {
+      return false;
+    }
+    TraversalStats::countPrimitives(1);
+    return leafPrimitive(occluder.primIdx).intersectP(ray);
+  }
 
  public:
   Intersector() {}
@@ -23,11 +197,55 @@ class Intersector {
 
   const std::vector<T>& getPrimitivesRef() const { return primitives; }
 
+  // number of primitives referred by leaves, larger than number of
+  // primitives when spatial splits put a primitive into several leaves
+  std::size_t nLeafPrimitives() const {
+    return leafPrimIndices.empty() ? primitives.size()
+                                   : leafPrimIndices.size();
+  }
+
   void addPrimitive(const T& primitive) { primitives.push_back(primitive); }
 
   virtual bool build() = 0;
+  // update acceleration structure after primitives are moved, keeping its
+  // topology
+  // NOTE: default implementation rebuilds whole structure
+  virtual bool refit() { return build(); }
+
+  // save built structure into cache file, which is identified by key
+  // return false when it's not supported or failed
+  virtual bool saveCache(const std::filesystem::path& /* filepath */,
+                         uint64_t /* key */) const {
+    return false;
+  }
+  // load structure from cache file saved with the same key, primitives are
+  // recreated from their faceID(less than nFaces) by makePrimitive
+  // return false when it's not supported or cache can't be used
+  virtual bool loadCache(
+      const std::filesystem::path& /* filepath */, uint64_t /* key */,
+      unsigned int /* nFaces */,
+      const std::function<T(unsigned int)>& /* makePrimitive */) {
+    return false;
+  }
   virtual bool intersect(const Ray& ray, IntersectInfo& info) const = 0;
   virtual bool intersectP(const Ray& ray) const = 0;
+  // test closest intersection of rays in activeMask, return mask of hit rays
+  // NOTE: ray.tmax of hit rays is shortened to the distance of the hit
+  // NOTE: default implementation traces rays one by one
+  virtual uint32_t intersectPacket(const RayPacket& packet,
+                                   uint32_t activeMask,
+                                   IntersectInfo info[RayPacket::SIZE]) const {
+    TraversalStats::Scope scope(TraversalQuery::PACKET);
+    uint32_t hitMask = 0;
+    for (; activeMask > 0; activeMask &= activeMask - 1) {
+      const int r = std::countr_zero(activeMask);
+      if (intersect(packet.rays[r], info[r])) {
+        packet.rays[r].tmax = info[r].t;
+        hitMask |= 1u << r;
+      }
+    }
+    return hitMask;
+  }
   virtual AABB aabb() const { return AABB(); }
 };
 
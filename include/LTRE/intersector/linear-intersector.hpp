@@ -27,6 +27,8 @@ class LinearIntersector : public Intersector<T> {
   }
 
   bool intersect(const Ray& ray, IntersectInfo& info) const override {
+    TraversalStats::Scope scope(TraversalQuery::CLOSEST);
+    TraversalStats::countPrimitives(this->primitives.size());
     bool hit = false;
 
     for (const auto& prim : this->primitives) {
@@ -40,7 +42,9 @@ class LinearIntersector : public Intersector<T> {
   }
 
   bool intersectP(const Ray& ray) const override {
+    TraversalStats::Scope scope(TraversalQuery::OCCLUSION);
     for (const auto& prim : this->primitives) {
+      TraversalStats::countPrimitives(1);
       if (prim.intersectP(ray)) {
         return true;
       }
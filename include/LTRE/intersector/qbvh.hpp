@@ -7,13 +7,14 @@
 
 namespace LTRE {
 
-// TODO: fix intersection bug, problem maybe relates to construction of tree or
-// intersection with AABB
-// TODO: implement CENTER splitting, SAH splitting case, we need to handle 0
-// primitives case
+// 4-wide BVH, each node holds bounds of 4 children in SoA layout
+// child[0], child[1] are left side of top split(split by axisLeft)
+// child[2], child[3] are right side of top split(split by axisRight)
 template <Intersectable T, BVHSplitStrategy strategy>
 class QBVH : public Intersector<T> {
  private:
+  using LeafRay = typename Intersector<T>::LeafRay;
+
   struct alignas(128) BVHNode {
     float bounds[4 * 2 * 3];
     int child[4];
@@ -22,20 +23,53 @@ class QBVH : public Intersector<T> {
     int axisRight;
   };
 
+  // maximum number of deferred children during traversal
+  // NOTE: at most 3 children per level are deferred, and QBVH is never
+  // deeper than binary BVH it's collapsed from
+  static constexpr int MAX_STACK_SIZE = 3 * BVH_MAX_DEPTH + 1;
+
+  // deferred child on traversal stack
+  struct StackEntry {
+    int child;     // encoded child
+    float tEntry;  // distance where ray enters the child
+  };
+
+  // deferred child on traversal stack shared by packet
+  struct PacketStackEntry {
+    int child;      // encoded child
+    uint32_t mask;  // rays which hit the child
+  };
+
   std::vector<BVHNode> nodes;
-  BVH<T, strategy>::BVHStatistics stats;
+  typename BVH<T, strategy>::BVHStatistics stats;
+  // number of extra references allowed by spatial splits(SBVH only)
+  float referenceBudget{BVHBuilder<T, strategy>::DEFAULT_REFERENCE_BUDGET};
+  // refit rebuilds tree when SAH cost exceeds this ratio of builtSAHCost
+  float rebuildThreshold{BVHBuilder<T, strategy>::DEFAULT_REBUILD_THRESHOLD};
+  float builtSAHCost{0};  // SAH cost right after build
+
+  // subtrees shallower than this depth are refitted as separate tasks
+  static constexpr int PARALLEL_REFIT_DEPTH = 5;
+
+  // largest offset of primitives which leaf can encode
+  static constexpr int MAX_PRIMITIVES_OFFSET = 0x07ffffff;
 
-  static int encodeLeaf(int nPrims, int primStart) {
+  // encode leaf into child, return false if leaf doesn't fit in encoding
+  static bool encodeLeaf(int nPrims, int primStart, int& enc) {
     if (nPrims > 0xf) {
       spdlog::error("[QBVH] nPrims out of bounds");
-      std::exit(EXIT_FAILURE);
+      return false;
+    }
+    if (primStart > MAX_PRIMITIVES_OFFSET) {
+      spdlog::error("[QBVH] primStart out of bounds");
+      return false;
     }
 
-    int enc = 0;
+    enc = 0;
     enc |= (1 << 31);
     enc |= ((nPrims & 0xf) << 27);
-    enc |= (primStart & 0x07ffffff);
-    return enc;
+    enc |= (primStart & MAX_PRIMITIVES_OFFSET);
+    return true;
   }
 
   static void decodeLeaf(int child, int& nPrims, int& primitivesOffset) {
@@ -45,76 +79,66 @@ class QBVH : public Intersector<T> {
 
   static bool isLeaf(int child) { return ((child & 0x80000000) >> 31) == 1; }
 
-  // build bvh node recursively
-  // NOTE: we need at least 4 primitives
-  void buildBVHNode(int primStart, int primEnd) {
-    // compute top AABB
-    const AABB topAABB =
-        BVH<T, strategy>::computeAABB(this->primitives, primStart, primEnd);
-
-    // split top AABB
-    int splitAxisTop, splitIdxTop;
-    bool makeLeafTop;
-    BVH<T, strategy>::splitAABB(topAABB, this->primitives, primStart, primEnd,
-                                splitAxisTop, splitIdxTop, makeLeafTop, true);
-
-    // compute left AABB
-    const AABB leftAABB =
-        BVH<T, strategy>::computeAABB(this->primitives, primStart, splitIdxTop);
-
-    // split left AABB
-    int splitAxisLeft, splitIdxLeft;
-    bool makeLeafLeft;
-    BVH<T, strategy>::splitAABB(leftAABB, this->primitives, primStart,
-                                splitIdxTop, splitAxisLeft, splitIdxLeft,
-                                makeLeafLeft, true);
-
-    // compute right AABB
-    const AABB rightAABB =
-        BVH<T, strategy>::computeAABB(this->primitives, splitIdxTop, primEnd);
-
-    // split right AABB
-    int splitAxisRight, splitIdxRight;
-    bool makeLeafRight;
-    BVH<T, strategy>::splitAABB(rightAABB, this->primitives, splitIdxTop,
-                                primEnd, splitAxisRight, splitIdxRight,
-                                makeLeafRight, true);
-
-    assert(primStart != splitIdxTop);
-    assert(splitIdxLeft != splitIdxTop);
-    assert(splitIdxRight != splitIdxTop);
-    assert(splitIdxRight != primEnd);
-
-    // compute children AABB
-    const AABB bbox0 = BVH<T, strategy>::computeAABB(this->primitives,
-                                                     primStart, splitIdxLeft);
-    const AABB bbox1 = BVH<T, strategy>::computeAABB(this->primitives,
-                                                     splitIdxLeft, splitIdxTop);
-    const AABB bbox2 = BVH<T, strategy>::computeAABB(
-        this->primitives, splitIdxTop, splitIdxRight);
-    const AABB bbox3 =
-        BVH<T, strategy>::computeAABB(this->primitives, splitIdxRight, primEnd);
+  // AABB of i-th child of node
+  static AABB childAABB(const BVHNode& node, int i) {
+    return AABB(Vec3(node.bounds[i], node.bounds[i + 4], node.bounds[i + 8]),
+                Vec3(node.bounds[i + 12], node.bounds[i + 16],
+                     node.bounds[i + 20]));
+  }
+
+  static void setChildAABB(BVHNode& node, int i, const AABB& bbox) {
+    node.bounds[i] = bbox.bounds[0][0];
+    node.bounds[i + 4] = bbox.bounds[0][1];
+    node.bounds[i + 8] = bbox.bounds[0][2];
+    node.bounds[i + 12] = bbox.bounds[1][0];
+    node.bounds[i + 16] = bbox.bounds[1][1];
+    node.bounds[i + 20] = bbox.bounds[1][2];
+  }
+
+  // children of binary node, leaf node is paired with empty child
+  // NOTE: empty child is represented as index -1
+  static void binaryChildren(const std::vector<BVHBuildNode>& binaryNodes,
+                             int binaryIdx, int children[2], int& axis) {
+    const BVHBuildNode& binaryNode = binaryNodes[binaryIdx];
+    if (binaryNode.isLeaf()) {
+      children[0] = binaryIdx;
+      children[1] = -1;
+      axis = 0;
+    } else {
+      children[0] = binaryNode.child[0];
+      children[1] = binaryNode.child[1];
+      axis = binaryNode.axis;
+    }
+  }
+
+  // build bvh node by collapsing two levels of binary bvh, return index of
+  // the node, or -1 if some leaf can't be encoded
+  int buildBVHNode(const std::vector<BVHBuildNode>& binaryNodes,
+                   int binaryIdx) {
+    // top split
+    int top[2], axisTop;
+    binaryChildren(binaryNodes, binaryIdx, top, axisTop);
+
+    // left split, right split
+    int children[4];
+    int axisLeft = 0, axisRight = 0;
+    binaryChildren(binaryNodes, top[0], children, axisLeft);
+    if (top[1] >= 0) {
+      binaryChildren(binaryNodes, top[1], children + 2, axisRight);
+    } else {
+      children[2] = children[3] = -1;
+    }
 
     // populate node info
-    const AABB childboxes[4] = {bbox0, bbox1, bbox2, bbox3};
+    // NOTE: bounds of empty child is left as empty AABB, it never intersects
     BVHNode node;
     for (int i = 0; i < 4; ++i) {
-      node.bounds[i] = childboxes[i].bounds[0][0];
-      node.bounds[i + 4] = childboxes[i].bounds[0][1];
-      node.bounds[i + 8] = childboxes[i].bounds[0][2];
-      node.bounds[i + 12] = childboxes[i].bounds[1][0];
-      node.bounds[i + 16] = childboxes[i].bounds[1][1];
-      node.bounds[i + 20] = childboxes[i].bounds[1][2];
+      setChildAABB(node, i,
+                   children[i] >= 0 ? binaryNodes[children[i]].bbox : AABB());
     }
-    node.axisTop = splitAxisTop;
-    node.axisLeft = splitAxisLeft;
-    node.axisRight = splitAxisRight;
-
-    const int nPrimsChild[4] = {
-        splitIdxLeft - primStart, splitIdxTop - splitIdxLeft,
-        splitIdxRight - splitIdxTop, primEnd - splitIdxRight};
-    const int primStartChild[4] = {primStart, splitIdxLeft, splitIdxTop,
-                                   splitIdxRight};
+    node.axisTop = axisTop;
+    node.axisLeft = axisLeft;
+    node.axisRight = axisRight;
 
     // add parent node without child info
     // NOTE: populate child info later
@@ -122,72 +146,181 @@ class QBVH : public Intersector<T> {
     nodes.push_back(node);
     stats.nInternalNodes++;
 
-    constexpr int leafThreshold = 15;
-    if (nPrimsChild[0] <= leafThreshold) {
-      // make leaf node
-      nodes[parentOffset].child[0] =
-          encodeLeaf(nPrimsChild[0], primStartChild[0]);
-      stats.nLeafNodes++;
-    } else {
-      // set index of child0
-      const int child0Offset = nodes.size();
-      nodes[parentOffset].child[0] = child0Offset;
+    for (int i = 0; i < 4; ++i) {
+      if (children[i] < 0) {
+        // empty child
+        encodeLeaf(0, 0, nodes[parentOffset].child[i]);
+      } else if (binaryNodes[children[i]].isLeaf()) {
+        // make leaf node
+        const BVHBuildNode& leaf = binaryNodes[children[i]];
+        if (!encodeLeaf(leaf.nRefs, leaf.refStart,
+                        nodes[parentOffset].child[i])) {
+          return -1;
+        }
+        stats.nLeafNodes++;
+      } else {
+        // build child subtree
+        const int childOffset = buildBVHNode(binaryNodes, children[i]);
+        if (childOffset < 0) return -1;
+        nodes[parentOffset].child[i] = childOffset;
+      }
+    }
+
+    return parentOffset;
+  }
 
-      // build child0 subtree
-      buildBVHNode(primStart, splitIdxLeft);
+  // refit bounds of subtree bottom-up, return AABB of the node
+  // NOTE: empty child is refitted as leaf without primitives, its AABB stays
+  // empty
+  AABB refitNode(int nodeIdx, int depth) {
+    BVHNode& node = nodes[nodeIdx];
+    AABB childBoxes[4];
+    for (int i = 0; i < 4; ++i) {
+      const int child = node.child[i];
+      if (isLeaf(child)) {
+        int nPrims, primitivesOffset;
+        decodeLeaf(child, nPrims, primitivesOffset);
+        childBoxes[i] = this->refitLeaf(primitivesOffset, nPrims);
+      } else if (depth < PARALLEL_REFIT_DEPTH) {
+#pragma omp task default(shared) firstprivate(i, child, depth)
+        childBoxes[i] = refitNode(child, depth + 1);
+      } else {
+        childBoxes[i] = refitNode(child, depth + 1);
+      }
     }
+#pragma omp taskwait
 
-    // build child1 subtree
-    if (nPrimsChild[1] <= leafThreshold) {
-      // make leaf node
-      nodes[parentOffset].child[1] =
-          encodeLeaf(nPrimsChild[1], primStartChild[1]);
-      stats.nLeafNodes++;
-    } else {
-      // set index of child1
-      const int child1Offset = nodes.size();
-      nodes[parentOffset].child[1] = child1Offset;
+    AABB bbox;
+    for (int i = 0; i < 4; ++i) {
+      setChildAABB(node, i, childBoxes[i]);
+      bbox = mergeAABB(bbox, childBoxes[i]);
+    }
+    return bbox;
+  }
+
+  // mix build parameters into key of cache
+  uint64_t cacheKey(uint64_t key) const {
+    return ContentHash(key).add(strategy).add(referenceBudget).get();
+  }
 
-      // build child1 subtree
-      buildBVHNode(splitIdxLeft, splitIdxTop);
+  // SAH cost of the tree, normalized by surface area of root node
+  float computeSAHCost() const {
+    const float rootArea = aabb().surfaceArea();
+    if (nodes.size() == 0 || rootArea <= 0) return 0;
+
+    float cost = 0;
+#pragma omp parallel for reduction(+ : cost)
+    for (std::size_t n = 0; n < nodes.size(); ++n) {
+      AABB bbox;
+      for (int i = 0; i < 4; ++i) {
+        const AABB childbox = childAABB(nodes[n], i);
+        bbox = mergeAABB(bbox, childbox);
+        if (isLeaf(nodes[n].child[i])) {
+          int nPrims, primitivesOffset;
+          decodeLeaf(nodes[n].child[i], nPrims, primitivesOffset);
+          if (nPrims > 0) {
+            cost += childbox.surfaceArea() * nPrims *
+                    BVHBuilder<T, strategy>::INTERSECT_COST;
+          }
+        }
+      }
+      cost += bbox.surfaceArea() * BVHBuilder<T, strategy>::TRAVERSE_COST;
     }
+    return cost / rootArea;
+  }
 
-    // build child2 subtree
-    if (nPrimsChild[2] <= leafThreshold) {
-      // make leaf node
-      nodes[parentOffset].child[2] =
-          encodeLeaf(nPrimsChild[2], primStartChild[2]);
-      stats.nLeafNodes++;
-    } else {
-      // set index of child2
-      const int child2Offset = nodes.size();
-      nodes[parentOffset].child[2] = child2Offset;
+  // pack primitives of all leaves and count nodes, used when nodes are
+  // loaded from cache instead of being built
+  void packNodeLeaves() {
+    stats = typename BVH<T, strategy>::BVHStatistics();
+    this->triangleBlocks.clear();
+    for (const BVHNode& node : nodes) {
+      stats.nInternalNodes++;
+      for (int i = 0; i < 4; ++i) {
+        if (!isLeaf(node.child[i])) continue;
+        int nPrims, primitivesOffset;
+        decodeLeaf(node.child[i], nPrims, primitivesOffset);
+        // NOTE: empty child is leaf without primitives
+        if (nPrims > 0) {
+          this->packLeaf(primitivesOffset, nPrims);
+          stats.nLeafNodes++;
+        }
+      }
+    }
+    stats.nNodes = stats.nInternalNodes + stats.nLeafNodes;
+  }
 
-      // build child2 subtree
-      buildBVHNode(splitIdxTop, splitIdxRight);
+  // check that nodes loaded from cache form a tree no deeper than
+  // BVH_MAX_DEPTH, whose children and leaves are in bounds
+  bool isValidTree(uint64_t nSlots) const {
+    if (nodes.empty()) return nSlots == 0;
+    std::vector<std::pair<int, int>> stack = {{0, 0}};
+    std::size_t nVisited = 0;
+    while (!stack.empty()) {
+      const auto [nodeIdx, depth] = stack.back();
+      stack.pop_back();
+      // NOTE: depth also bounds cycles, number of visits bounds shared nodes
+      if (depth >= BVH_MAX_DEPTH || ++nVisited > nodes.size()) return false;
+
+      const BVHNode& node = nodes[nodeIdx];
+      for (int i = 0; i < 4; ++i) {
+        const int child = node.child[i];
+        if (isLeaf(child)) {
+          int nPrims, primitivesOffset;
+          decodeLeaf(child, nPrims, primitivesOffset);
+          if (primitivesOffset + uint64_t(nPrims) > nSlots) return false;
+        } else if (child > 0 && child < static_cast<int>(nodes.size())) {
+          stack.push_back({child, depth + 1});
+        } else {
+          return false;
+        }
+      }
     }
+    return true;
+  }
 
-    // build child3 subtree
-    if (nPrimsChild[3] <= leafThreshold) {
-      // make leaf node
-      nodes[parentOffset].child[3] =
-          encodeLeaf(nPrimsChild[3], primStartChild[3]);
-      stats.nLeafNodes++;
+  // front-to-back order of children, given sign of ray direction
+  static void childOrder(const BVHNode& node, const int dirInvSign[3],
+                         int order[4]) {
+    const int left0 = dirInvSign[node.axisLeft];
+    const int right0 = 2 + dirInvSign[node.axisRight];
+    if (dirInvSign[node.axisTop] == 0) {
+      order[0] = left0;
+      order[1] = 1 - left0;
+      order[2] = right0;
+      order[3] = 5 - right0;
     } else {
-      // set index of child3
-      const int child3Offset = nodes.size();
-      nodes[parentOffset].child[3] = child3Offset;
-
-      // build child3 subtree
-      buildBVHNode(splitIdxRight, primEnd);
+      order[0] = right0;
+      order[1] = 5 - right0;
+      order[2] = left0;
+      order[3] = 1 - left0;
     }
   }
 
+  static void loadBounds(const BVHNode& node, __m128 bounds[2][3]) {
+    bounds[0][0] = _mm_load_ps(&node.bounds[0]);
+    bounds[0][1] = _mm_load_ps(&node.bounds[4]);
+    bounds[0][2] = _mm_load_ps(&node.bounds[8]);
+    bounds[1][0] = _mm_load_ps(&node.bounds[12]);
+    bounds[1][1] = _mm_load_ps(&node.bounds[16]);
+    bounds[1][2] = _mm_load_ps(&node.bounds[20]);
+  }
+
  public:
   // intersect 4 aabb with SIMD
   static int intersectAABB(const __m128 orig[3], const __m128 dirInv[3],
                            const int dirInvSign[3], const __m128 raytmin,
                            const __m128 raytmax, const __m128 bounds[2][3]) {
+    __m128 tEntry;
+    return intersectAABB(orig, dirInv, dirInvSign, raytmin, raytmax, bounds,
+                         tEntry);
+  }
+
+  // intersect 4 aabb with SIMD, also returns entry distance of each aabb
+  static int intersectAABB(const __m128 orig[3], const __m128 dirInv[3],
+                           const int dirInvSign[3], const __m128 raytmin,
+                           const __m128 raytmax, const __m128 bounds[2][3],
+                           __m128& tEntry) {
     // SIMD version of https://dl.acm.org/doi/abs/10.1145/1198555.1198748
     __m128 tmin =
         _mm_mul_ps(_mm_sub_ps(bounds[dirInvSign[0]][0], orig[0]), dirInv[0]);
@@ -208,62 +341,185 @@ class QBVH : public Intersector<T> {
         tmax, _mm_mul_ps(_mm_sub_ps(bounds[1 - dirInvSign[2]][2], orig[2]),
                          dirInv[2]));
 
-    const __m128 comp1 = _mm_cmp_ps(tmax, tmin, _CMP_GT_OQ);
+    tmax = _mm_mul_ps(tmax, _mm_set1_ps(SLAB_FAR_SCALE));
+
+    tEntry = tmin;
+    const __m128 comp1 = _mm_cmp_ps(tmax, tmin, _CMP_GE_OQ);
     const __m128 comp2 = _mm_and_ps(_mm_cmp_ps(tmin, raytmax, _CMP_LT_OQ),
                                     _mm_cmp_ps(tmax, raytmin, _CMP_GT_OQ));
     return _mm_movemask_ps(_mm_and_ps(comp1, comp2));
   }
 
  private:
-  // traverse QBVH recursively
-  bool intersectNode(int nodeIdx, const Ray& ray, const __m128 orig[3],
-                     const __m128 dirInv[3], const int dirInvSign[3],
-                     IntersectInfo& info) const {
+  // traverse QBVH iteratively, visit children in front-to-back order
+  bool intersectNode(const Ray& ray, const LeafRay& leafRay,
+                     const __m128 orig[3], const __m128 dirInv[3],
+                     const int dirInvSign[3], IntersectInfo& info) const {
     bool hit = false;
-    const BVHNode& node = nodes[nodeIdx];
+    const __m128 raytmin = _mm_set_ps1(ray.tmin);
+
+    StackEntry stack[MAX_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = {0, ray.tmin};
+    while (stackSize > 0) {
+      const StackEntry entry = stack[--stackSize];
+      // skip child which is beyond the closest hit
+      if (entry.tEntry > ray.tmax) continue;
+      TraversalStats::countNode();
+
+      // leaf node
+      if (isLeaf(entry.child)) {
+        // unpack leaf data
+        int nPrims, primitivesOffset;
+        decodeLeaf(entry.child, nPrims, primitivesOffset);
+        // test intersection with all primitives in this node
+        if (this->intersectLeaf(primitivesOffset, nPrims, ray, leafRay,
+                                info)) {
+          hit = true;
+        }
+        continue;
+      }
 
-    // prepare SIMD data
+      // internal node
+      const BVHNode& node = nodes[entry.child];
+      __m128 bounds[2][3];
+      loadBounds(node, bounds);
+
+      // intersect AABB
+      TraversalStats::countBoxes(4);
+      __m128 tEntry;
+      const int hitMask =
+          intersectAABB(orig, dirInv, dirInvSign, raytmin,
+                        _mm_set_ps1(ray.tmax), bounds, tEntry);
+      if (hitMask == 0) continue;
+      alignas(16) float tEntries[4];
+      _mm_store_ps(tEntries, tEntry);
+
+      // push children in back-to-front order, then nearest child is popped
+      // first
+      int order[4];
+      childOrder(node, dirInvSign, order);
+      for (int i = 3; i >= 0; --i) {
+        const int c = order[i];
+        if (hitMask & (1 << c)) {
+          assert(stackSize < MAX_STACK_SIZE);
+          stack[stackSize++] = {node.child[c], tEntries[c]};
+        }
+      }
+    }
+
+    return hit;
+  }
+
+  // traverse QBVH iteratively, terminate at the first hit
+  // NOTE: any hit terminates traversal, so that children are not ordered by
+  // distance
+  bool intersectNodeP(const Ray& ray, const LeafRay& leafRay,
+                      const __m128 orig[3], const __m128 dirInv[3],
+                      const int dirInvSign[3]) const {
     const __m128 raytmin = _mm_set_ps1(ray.tmin);
     const __m128 raytmax = _mm_set_ps1(ray.tmax);
-    __m128 bounds[2][3];
-    bounds[0][0] = _mm_load_ps(&node.bounds[0]);
-    bounds[0][1] = _mm_load_ps(&node.bounds[4]);
-    bounds[0][2] = _mm_load_ps(&node.bounds[8]);
-    bounds[1][0] = _mm_load_ps(&node.bounds[12]);
-    bounds[1][1] = _mm_load_ps(&node.bounds[16]);
-    bounds[1][2] = _mm_load_ps(&node.bounds[20]);
 
-    // intersect AABB
-    const int hitMask =
-        intersectAABB(orig, dirInv, dirInvSign, raytmin, raytmax, bounds);
-    const int hitChild[4] = {hitMask & 0b1, hitMask & 0b10, hitMask & 0b100,
-                             hitMask & 0b1000};
+    int stack[MAX_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+      const int child = stack[--stackSize];
+      TraversalStats::countNode();
+
+      // leaf node
+      if (isLeaf(child)) {
+        // unpack leaf data
+        int nPrims, primitivesOffset;
+        decodeLeaf(child, nPrims, primitivesOffset);
+        // test intersection with all primitives in this node
+        if (this->intersectLeafP(primitivesOffset, nPrims, ray, leafRay)) {
+          return true;
+        }
+        continue;
+      }
 
-    for (int i = 0; i < 4; ++i) {
-      if (hitChild[i] > 0) {
-        const int child = node.child[i];
-        // leaf node
-        if (isLeaf(child)) {
-          // unpack leaf data
-          int nPrims, primitivesOffset;
-          decodeLeaf(child, nPrims, primitivesOffset);
-          // test intersection with all primitives in this node
-          for (int j = primitivesOffset; j < primitivesOffset + nPrims; ++j) {
-            if (this->primitives[j].intersect(ray, info)) {
-              ray.tmax = info.t;
-              hit = true;
-            }
-          }
+      // internal node
+      const BVHNode& node = nodes[child];
+      __m128 bounds[2][3];
+      loadBounds(node, bounds);
+
+      // intersect AABB
+      TraversalStats::countBoxes(4);
+      const int hitMask =
+          intersectAABB(orig, dirInv, dirInvSign, raytmin, raytmax, bounds);
+      for (int c = 0; c < 4; ++c) {
+        if (hitMask & (1 << c)) {
+          assert(stackSize < MAX_STACK_SIZE);
+          stack[stackSize++] = node.child[c];
         }
-        // internal node
-        else {
-          // test intersection with child node
-          hit |= intersectNode(child, ray, orig, dirInv, dirInvSign, info);
+      }
+    }
+
+    return false;
+  }
+
+  // traverse QBVH with packet of rays, which share one stack
+  // children are pushed with mask of rays which hit them, in front-to-back
+  // order given by direction of the packet
+  uint32_t intersectNodePacket(const RayPacket& packet, uint32_t activeMask,
+                               IntersectInfo info[RayPacket::SIZE]) const {
+    RayPacketData data(packet, activeMask);
+    LeafRay leafRays[RayPacket::SIZE];
+    for (uint32_t bits = activeMask; bits > 0; bits &= bits - 1) {
+      const int r = std::countr_zero(bits);
+      leafRays[r] = LeafRay(packet.rays[r]);
+    }
+    uint32_t hitMask = 0;
+
+    PacketStackEntry stack[MAX_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = {0, activeMask};
+    while (stackSize > 0) {
+      const PacketStackEntry entry = stack[--stackSize];
+      TraversalStats::countNode();
+
+      // leaf node
+      if (isLeaf(entry.child)) {
+        // unpack leaf data
+        int nPrims, primitivesOffset;
+        decodeLeaf(entry.child, nPrims, primitivesOffset);
+        // test intersection of rays with all primitives in this node
+        const uint32_t leafHitMask = this->intersectLeafPacket(
+            primitivesOffset, nPrims, packet, leafRays, entry.mask, info);
+        data.updateTmax(packet, leafHitMask);
+        hitMask |= leafHitMask;
+        continue;
+      }
+
+      // internal node
+      const BVHNode& node = nodes[entry.child];
+      int order[4];
+      childOrder(node, data.dirInvSign, order);
+      TraversalStats::countBoxes(4);
+      for (int i = 3; i >= 0; --i) {
+        const int c = order[i];
+        const uint32_t mask = data.intersect(childAABB(node, c), entry.mask);
+        if (mask > 0) {
+          assert(stackSize < MAX_STACK_SIZE);
+          stack[stackSize++] = {node.child[c], mask};
         }
       }
     }
 
-    return hit;
+    return hitMask;
+  }
+
+  // prepare simd data of ray
+  static void prepareRay(const Ray& ray, __m128 orig[3], __m128 dirInv[3],
+                         int dirInvSign[3]) {
+    // precompute ray's inversed direction, sign of direction
+    const Vec3 _dirInv = 1.0f / ray.direction;
+    for (int i = 0; i < 3; ++i) {
+      dirInvSign[i] = _dirInv[i] > 0 ? 0 : 1;
+      orig[i] = _mm_set_ps1(ray.origin[i]);
+      dirInv[i] = _mm_set_ps1(_dirInv[i]);
+    }
   }
 
  public:
@@ -271,9 +527,42 @@ class QBVH : public Intersector<T> {
   QBVH(const std::vector<T>& primitives) : Intersector<T>(primitives) {}
 
   bool build() override {
-    // start building bvh from root node
-    buildBVHNode(0, this->primitives.size());
+    nodes.clear();
+    stats = typename BVH<T, strategy>::BVHStatistics();
+    this->triangleBlocks.clear();
+    this->leafPrimIndices.clear();
+
+    // fail before building binary bvh if leaves can't refer every primitive
+    if (this->primitives.size() >
+        static_cast<std::size_t>(MAX_PRIMITIVES_OFFSET) + 1) {
+      spdlog::error("[QBVH] too many primitives to encode leaves");
+      return false;
+    }
+
+    // build binary bvh
+    BVHBuilder<T, strategy> builder(referenceBudget);
+    builder.build(this->primitives);
+
+    // collapse binary bvh into 4-wide bvh, then reorder primitives at once
+    const std::vector<BVHBuildNode>& binaryNodes = builder.getNodesRef();
+    if (binaryNodes.size() > 0) {
+      if (buildBVHNode(binaryNodes, 0) < 0) {
+        // NOTE: primitives are not reordered yet, caller can fall back to
+        // another intersector with them
+        spdlog::error("[QBVH] too many primitives to encode leaves");
+        nodes.clear();
+        stats = typename BVH<T, strategy>::BVHStatistics();
+        return false;
+      }
+      builder.reorderPrimitives(this->primitives, this->leafPrimIndices);
+      // pack primitives of each leaf
+      for (const BVHBuildNode& node : binaryNodes) {
+        if (node.isLeaf()) this->packLeaf(node.refStart, node.nRefs);
+      }
+    }
     stats.nNodes = stats.nInternalNodes + stats.nLeafNodes;
+    builtSAHCost = computeSAHCost();
+
     spdlog::info("[QBVH] nPrimitives: " +
                  std::to_string(this->primitives.size()));
     spdlog::info("[QBVH] nNodes: " + std::to_string(stats.nNodes));
@@ -284,52 +573,117 @@ class QBVH : public Intersector<T> {
     return true;
   }
 
+  // refit bounds of all nodes after primitives are moved
+  // whole tree is rebuilt when its SAH cost degrades too much
+  bool refit() override {
+    if (nodes.size() == 0) return true;
+
+#pragma omp parallel
+#pragma omp single
+    refitNode(0, 0);
+
+    const float sahCost = computeSAHCost();
+    if (sahCost > rebuildThreshold * builtSAHCost) {
+      spdlog::info("[QBVH] SAH cost degraded from " +
+                   std::to_string(builtSAHCost) + " to " +
+                   std::to_string(sahCost) + ", rebuilding");
+      return build();
+    }
+    return true;
+  }
+
+  // save nodes and primitive order into cache file(triangles only)
+  bool saveCache(const std::filesystem::path& filepath,
+                 uint64_t key) const override {
+    if constexpr (TriangleLike<T>) {
+      return saveBVHCache(filepath, "QBVH", cacheKey(key), nodes,
+                          this->primitives, this->leafPrimIndices);
+    } else {
+      return false;
+    }
+  }
+
+  // adopt nodes and primitive order of cache file instead of building
+  bool loadCache(
+      const std::filesystem::path& filepath, uint64_t key, unsigned int nFaces,
+      const std::function<T(unsigned int)>& makePrimitive) override {
+    if constexpr (TriangleLike<T>) {
+      if (!loadBVHCache(
+              filepath, "QBVH", cacheKey(key), nFaces, nodes, this->primitives,
+              this->leafPrimIndices, makePrimitive,
+              [this](uint64_t nSlots) { return isValidTree(nSlots); })) {
+        return false;
+      }
+      packNodeLeaves();
+      builtSAHCost = computeSAHCost();
+
+      spdlog::info("[QBVH] nPrimitives: " +
+                   std::to_string(this->primitives.size()));
+      spdlog::info("[QBVH] nNodes: " + std::to_string(stats.nNodes));
+      return true;
+    } else {
+      return false;
+    }
+  }
+
+  // set number of extra references allowed by spatial splits, relative to
+  // number of primitives(SBVH only)
+  void setReferenceBudget(float budget) { referenceBudget = budget; }
+
+  // set ratio of SAH cost degradation which makes refit rebuild the tree
+  void setRebuildThreshold(float threshold) { rebuildThreshold = threshold; }
+
+  // number of nodes
+  int nNodes() const { return stats.nNodes; }
+  // number of internal nodes
+  int nInternalNodes() const { return stats.nInternalNodes; }
+  // number of leaf nodes
+  int nLeafNodes() const { return stats.nLeafNodes; }
+
   bool intersect(const Ray& ray, IntersectInfo& info) const override {
-    // precompute ray's inversed direction, sign of direction
-    const Vec3 dirInv = 1.0f / ray.direction;
+    TraversalStats::Scope scope(TraversalQuery::CLOSEST);
+    if (nodes.size() == 0) return false;
+
+    __m128 orig[3], dirInv[3];
     int dirInvSign[3];
-    for (int i = 0; i < 3; ++i) {
-      dirInvSign[i] = dirInv[i] > 0 ? 0 : 1;
-    }
+    prepareRay(ray, orig, dirInv, dirInvSign);
+
+    // traverse from root node
+    return intersectNode(ray, LeafRay(ray), orig, dirInv, dirInvSign, info);
+  }
 
-    // prepare simd data
-    const __m128 orig[3] = {_mm_set_ps1(ray.origin[0]),
-                            _mm_set_ps1(ray.origin[1]),
-                            _mm_set_ps1(ray.origin[2])};
-    const __m128 _dirInv[3] = {_mm_set_ps1(dirInv[0]), _mm_set_ps1(dirInv[1]),
-                               _mm_set_ps1(dirInv[2])};
+  bool intersectP(const Ray& ray) const override {
+    TraversalStats::Scope scope(TraversalQuery::OCCLUSION);
+    if (nodes.size() == 0) return false;
+    if (this->intersectLastOccluder(ray)) return true;
+
+    __m128 orig[3], dirInv[3];
+    int dirInvSign[3];
+    prepareRay(ray, orig, dirInv, dirInvSign);
 
     // traverse from root node
-    return intersectNode(0, ray, orig, _dirInv, dirInvSign, info);
+    return intersectNodeP(ray, LeafRay(ray), orig, dirInv, dirInvSign);
+  }
+
+  uint32_t intersectPacket(const RayPacket& packet, uint32_t activeMask,
+                           IntersectInfo info[RayPacket::SIZE]) const override {
+    TraversalStats::Scope scope(TraversalQuery::PACKET);
+    if (nodes.size() == 0 || activeMask == 0) return 0;
+    // traverse from root node
+    return intersectNodePacket(packet, activeMask, info);
   }
 
   AABB aabb() const override {
+    AABB ret;
     if (nodes.size() > 0) {
-      const AABB bbox0 = AABB(
-          Vec3(nodes[0].bounds[0], nodes[0].bounds[4], nodes[0].bounds[8]),
-          Vec3(nodes[0].bounds[12], nodes[0].bounds[16], nodes[0].bounds[20]));
-      const AABB bbox1 =
-          AABB(Vec3(nodes[0].bounds[0 + 1], nodes[0].bounds[4 + 1],
-                    nodes[0].bounds[8 + 1]),
-               Vec3(nodes[0].bounds[12 + 1], nodes[0].bounds[16 + 1],
-                    nodes[0].bounds[20 + 1]));
-      const AABB bbox2 =
-          AABB(Vec3(nodes[0].bounds[0 + 2], nodes[0].bounds[4 + 2],
-                    nodes[0].bounds[8 + 2]),
-               Vec3(nodes[0].bounds[12 + 2], nodes[0].bounds[16 + 2],
-                    nodes[0].bounds[20 + 2]));
-      const AABB bbox3 =
-          AABB(Vec3(nodes[0].bounds[0 + 3], nodes[0].bounds[4 + 3],
-                    nodes[0].bounds[8 + 3]),
-               Vec3(nodes[0].bounds[12 + 3], nodes[0].bounds[16 + 3],
-                    nodes[0].bounds[20 + 3]));
-      return mergeAABB(bbox0, mergeAABB(bbox1, mergeAABB(bbox2, bbox3)));
-    } else {
-      return AABB();
+      for (int i = 0; i < 4; ++i) {
+        ret = mergeAABB(ret, childAABB(nodes[0], i));
+      }
     }
+    return ret;
   }
 };
 
 }  // namespace LTRE
 
-#endif
\ No newline at end of file
+#endif
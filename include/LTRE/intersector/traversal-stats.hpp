@@ -0,0 +1,143 @@
+#ifndef _LTRE_TRAVERSAL_STATS_H
+#define _LTRE_TRAVERSAL_STATS_H
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace LTRE {
+
+// kind of traversal query
+enum class TraversalQuery { CLOSEST, OCCLUSION, PACKET };
+
+// work done by traversal
+struct TraversalCounters {
+  uint64_t nodes{0};       // number of visited nodes
+  uint64_t boxes{0};       // number of tested AABBs
+  uint64_t primitives{0};  // number of tested primitives
+
+  TraversalCounters& operator+=(const TraversalCounters& counters) {
+    nodes += counters.nodes;
+    boxes += counters.boxes;
+    primitives += counters.primitives;
+    return *this;
+  }
+};
+
+// statistics of traversal queries, counted only when LTRE_TRAVERSAL_STATS is
+// defined
+// counts are accumulated per thread, and aggregated by collect()
+// NOTE: when disabled, counting functions are empty so that traversal has no
+// overhead
+class TraversalStats {
+ public:
+#ifdef LTRE_TRAVERSAL_STATS
+  static constexpr bool ENABLED = true;
+#else
+  static constexpr bool ENABLED = false;
+#endif
+
+  // i-th bucket counts queries whose count is in [2^(i-1), 2^i)
+  // NOTE: 0-th bucket counts queries whose count is 0
+  static constexpr int N_BUCKETS = 33;
+  using Histogram = std::array<uint64_t, N_BUCKETS>;
+
+  // statistics of one kind of query
+  struct QueryStats {
+    uint64_t nQueries{0};
+    TraversalCounters total;
+    Histogram nodes{};       // histogram of visited nodes per query
+    Histogram primitives{};  // histogram of tested primitives per query
+
+    QueryStats& operator+=(const QueryStats& stats);
+  };
+
+  struct Report {
+    std::array<QueryStats, 3> queries;  // indexed by TraversalQuery
+
+    const QueryStats& operator[](TraversalQuery query) const {
+      return queries[static_cast<int>(query)];
+    }
+  };
+
+ private:
+  struct ThreadState {
+    TraversalCounters current;  // counters of query in progress
+    TraversalCounters last;     // counters of last finished query
+    TraversalQuery query{TraversalQuery::CLOSEST};
+    int depth{0};  // number of nested queries in progress
+    Report report;
+  };
+
+  inline static thread_local ThreadState* state = nullptr;
+
+  // states of all threads which have counted traversal
+  // NOTE: states are kept after their thread exits, so that its counts are
+  // not lost
+  static std::vector<std::unique_ptr<ThreadState>>& registry();
+
+  // allocate state of calling thread, which outlives the thread
+  static ThreadState* registerThread();
+
+  static ThreadState& local() {
+    if (!state) state = registerThread();
+    return *state;
+  }
+
+  static void recordQuery(ThreadState& s);
+
+ public:
+  // work done between construction and destruction is counted as one query
+  // NOTE: nested query(e.g. mesh intersector called from scene intersector) is
+  // counted as a part of the outermost one
+  class Scope {
+   public:
+    explicit Scope([[maybe_unused]] TraversalQuery query) {
+      if constexpr (ENABLED) {
+        ThreadState& s = local();
+        if (s.depth++ == 0) {
+          s.current = TraversalCounters();
+          s.query = query;
+        }
+      }
+    }
+    ~Scope() {
+      if constexpr (ENABLED) {
+        ThreadState& s = local();
+        if (--s.depth == 0) recordQuery(s);
+      }
+    }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+  };
+
+  static void countNode() {
+    if constexpr (ENABLED) local().current.nodes++;
+  }
+  static void countBoxes([[maybe_unused]] uint32_t n) {
+    if constexpr (ENABLED) local().current.boxes += n;
+  }
+  static void countPrimitives([[maybe_unused]] uint32_t n) {
+    if constexpr (ENABLED) local().current.primitives += n;
+  }
+
+  // counters of the last query finished in calling thread
+  static TraversalCounters lastQuery() {
+    if constexpr (ENABLED) return local().last;
+    return TraversalCounters();
+  }
+
+  // aggregate statistics of all threads
+  // NOTE: must not be called while other threads are tracing rays
+  static Report collect();
+
+  // clear statistics of all threads
+  static void reset();
+
+  // print totals and histograms of collected statistics
+  static void log(const Report& report);
+};
+
+}  // namespace LTRE
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef _LTRE_TRIANGLE_BLOCKS_H
+#define _LTRE_TRIANGLE_BLOCKS_H
+#include <algorithm>
+#include <cmath>
+#include <concepts>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+#include "LTRE/core/ray.hpp"
+#include "LTRE/core/types.hpp"
+#include "LTRE/math/vec3.hpp"
+
+namespace LTRE {
+
+// primitive which can be packed into TriangleBlocks
+// hit is recorded as barycentric coordinates and faceID of the triangle
+template <typename T>
+concept TriangleLike = requires(const T& x) {
+  x.getPositions();
+  { x.faceID } -> std::convertible_to<unsigned int>;
+};
+
+// ray transformed into space where it starts at origin and points to +z,
+// computed once per ray and shared by all triangle tests
+// https://jcgt.org/published/0002/01/05/
+struct TriangleRay {
+  Vec3 origin;
+  int kx, ky, kz;    // permutation of axes, kz is dominant axis of direction
+  float Sx, Sy, Sz;  // shear which maps direction to +z
+
+  TriangleRay() {}
+  TriangleRay(const Ray& ray) : origin(ray.origin) {
+    kz = 0;
+    for (int i = 1; i < 3; ++i) {
+      if (std::abs(ray.direction[i]) > std::abs(ray.direction[kz])) kz = i;
+    }
+    kx = (kz + 1) % 3;
+    ky = (kx + 1) % 3;
+    // keep winding order of triangle
+    if (ray.direction[kz] < 0.0f) std::swap(kx, ky);
+
+    Sx = ray.direction[kx] / ray.direction[kz];
+    Sy = ray.direction[ky] / ray.direction[kz];
+    Sz = 1.0f / ray.direction[kz];
+  }
+};
+
+// a * b - c * d with correct sign, so that adjacent triangles classify their
+// shared edge consistently
+// NOTE: products of floats are exact in double, so that result doesn't depend
+// on operand order or FMA contraction
+inline float diffOfProducts(float a, float b, float c, float d) {
+  return static_cast<double>(a) * b - static_cast<double>(c) * d;
+}
+
+// watertight ray/triangle test, rays never leak through shared edge or
+// vertex of triangles
+// (u, v) is barycentric coordinates of v1, v2
+inline bool intersectTriangle(const Vec3& v0, const Vec3& v1, const Vec3& v2,
+                              const Ray& ray, const TriangleRay& triRay,
+                              float& t, float& u, float& v) {
+  // vertices relative to ray origin
+  const Vec3 A = v0 - triRay.origin;
+  const Vec3 B = v1 - triRay.origin;
+  const Vec3 C = v2 - triRay.origin;
+
+  // shear and scale vertices
+  const int kx = triRay.kx, ky = triRay.ky, kz = triRay.kz;
+  const float Ax = A[kx] - triRay.Sx * A[kz];
+  const float Ay = A[ky] - triRay.Sy * A[kz];
+  const float Bx = B[kx] - triRay.Sx * B[kz];
+  const float By = B[ky] - triRay.Sy * B[kz];
+  const float Cx = C[kx] - triRay.Sx * C[kz];
+  const float Cy = C[ky] - triRay.Sy * C[kz];
+
+  // ray passes inside triangle when all edge functions have the same sign
+  const float U = diffOfProducts(Cx, By, Cy, Bx);
+  const float V = diffOfProducts(Ax, Cy, Ay, Cx);
+  const float W = diffOfProducts(Bx, Ay, By, Ax);
+  if ((U < 0.0f || V < 0.0f || W < 0.0f) &&
+      (U > 0.0f || V > 0.0f || W > 0.0f)) {
+    return false;
+  }
+  const float det = U + V + W;
+  if (det == 0.0f) return false;
+
+  // hit distance
+  const float T = U * triRay.Sz * A[kz] + V * triRay.Sz * B[kz] +
+                  W * triRay.Sz * C[kz];
+  const float invDet = 1.0f / det;
+  t = T * invDet;
+  if (t < ray.tmin || t > ray.tmax) return false;
+
+  u = V * invDet;
+  v = W * invDet;
+  return true;
+}
+
+// triangles of each leaf packed into SoA blocks, tested at once with SIMD
+// version of the watertight test
+// NOTE: each leaf starts from new block, unused lanes hold NaN triangle
+// which never intersects
+class TriangleBlocks {
+ public:
+#ifdef __AVX__
+  static constexpr int WIDTH = 8;
+#else
+  static constexpr int WIDTH = 4;
+#endif
+
+  // NOTE: vertices are stored as they are(not edges), so that shared
+  // vertices are bitwise identical among triangles
+  struct alignas(4 * WIDTH) Block {
+    float v0[3][WIDTH];
+    float v1[3][WIDTH];
+    float v2[3][WIDTH];
+  };
+
+ private:
+  std::vector<Block> blocks;
+  // index of first block of leaf, indexed by first primitive of the leaf
+  std::vector<uint32_t> leafBlockOffset;
+
+ public:
+  TriangleBlocks() {}
+
+  void clear();
+
+  // pack triangles of leaf(leaf slots [primStart, primStart + nPrims)),
+  // getTriangle(i) returns triangle placed at leaf slot i
+  template <typename F>
+  void addLeaf(uint32_t primStart, uint32_t nPrims, const F& getTriangle) {
+    if (leafBlockOffset.size() < primStart + nPrims) {
+      leafBlockOffset.resize(primStart + nPrims);
+    }
+    leafBlockOffset[primStart] = blocks.size();
+    Block padding;
+    std::fill_n(&padding.v0[0][0], 9 * WIDTH,
+                std::numeric_limits<float>::quiet_NaN());
+    blocks.resize(blocks.size() + (nPrims + WIDTH - 1) / WIDTH, padding);
+    updateLeaf(primStart, nPrims, getTriangle);
+  }
+
+  // repack triangles of already added leaf, after vertices are moved
+  // NOTE: each leaf owns its blocks, so leaves can be updated in parallel
+  template <typename F>
+  void updateLeaf(uint32_t primStart, uint32_t nPrims, const F& getTriangle) {
+    Block* leafBlocks = blocks.data() + leafBlockOffset[primStart];
+    for (uint32_t i = 0; i < nPrims; ++i) {
+      const int lane = i % WIDTH;
+      const auto [v0, v1, v2] = getTriangle(primStart + i).getPositions();
+      Block& block = leafBlocks[i / WIDTH];
+      for (int j = 0; j < 3; ++j) {
+        block.v0[j][lane] = v0[j];
+        block.v1[j][lane] = v1[j];
+        block.v2[j][lane] = v2[j];
+      }
+    }
+  }
+
+  // test closest intersection with triangles of leaf, return index of the
+  // hit primitive(-1 if there is no hit)
+  // NOTE: ray.tmax is shortened to the distance of the hit
+  int intersect(uint32_t primStart, uint32_t nPrims, const Ray& ray,
+                const TriangleRay& triRay, float& u, float& v) const;
+
+  // test any intersection with triangles of leaf, return index of a
+  // primitive which occludes ray(-1 if there is no hit)
+  int intersectP(uint32_t primStart, uint32_t nPrims, const Ray& ray,
+                 const TriangleRay& triRay) const;
+};
+
+}  // namespace LTRE
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef _LTRE_INSTANCE_H
+#define _LTRE_INSTANCE_H
+#include <memory>
+
+#include "LTRE/core/transform.hpp"
+#include "LTRE/sampling/sampler.hpp"
+#include "LTRE/shape/shape.hpp"
+
+namespace LTRE {
+
+// shape placed in the scene by affine transform
+// NOTE: shape and its intersector are shared by all instances of it, rays are
+// transformed into object space of the shape at intersection
+class Instance : public Shape {
+ private:
+  const std::shared_ptr<Shape> shape;
+  const Transform worldToLocal;
+
+  // transform ray into object space with normalized direction
+  // NOTE: distance along local ray is tScale times of world one
+  Ray toLocal(const Ray& ray, float& tScale) const;
+
+ public:
+  Instance(const std::shared_ptr<Shape>& shape, const Transform& localToWorld);
+
+  bool intersect(const Ray& ray, IntersectInfo& info) const override;
+  bool intersectP(const Ray& ray) const override;
+  SurfaceInfo computeSurfaceInfo(const Ray& ray,
+                                 const IntersectInfo& info) const override;
+  AABB aabb() const override;
+  // NOTE: exact only when transform scales uniformly
+  float surfaceArea() const override;
+  SurfaceInfo samplePoint(Sampler& sampler, float& pdf) const override;
+};
+
+}  // namespace LTRE
+
+#endif
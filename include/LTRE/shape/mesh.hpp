@@ -1,11 +1,14 @@
 #ifndef _LTRE_MESH_H
 #define _LTRE_MESH_H
+#include <filesystem>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include "spdlog/spdlog.h"
 //
 #include "LTRE/intersector/bvh.hpp"
+#include "LTRE/intersector/cbvh8.hpp"
 #include "LTRE/intersector/qbvh.hpp"
 #include "LTRE/shape/shape.hpp"
 
@@ -46,24 +49,60 @@ struct MeshTriangle {
 
   AABB aabb() const;
 
+  // compute surface info at the point given by barycentric coordinates
+  SurfaceInfo computeSurfaceInfo(const Vec3& position, float u, float v) const;
+
+  bool intersect(const Ray& ray, IntersectInfo& info) const;
+  bool intersectP(const Ray& ray) const;
+};
+
+// triangle of flattened scene, which records Primitive of mesh it belongs to
+// NOTE: only vertex positions are referenced, so that leaf entry is compact
+struct SceneTriangle {
+  const Vec3* positions;        // pointer to vertex position array
+  const unsigned int* indices;  // pointer to index array
+  unsigned int faceID;          // which face of the mesh this triangle is
+  uint32_t primID;              // which Primitive of scene has the mesh
+
+  SceneTriangle();
+  SceneTriangle(const MeshTriangle& triangle, uint32_t primID);
+
+  // get vertex positions of this triangle
+  std::tuple<Vec3, Vec3, Vec3> getPositions() const;
+
+  AABB aabb() const;
+
   bool intersect(const Ray& ray, IntersectInfo& info) const;
   bool intersectP(const Ray& ray) const;
 };
 
 class Mesh : public Shape {
  private:
-  const std::vector<Vec3> positions;  // vertex position
+  // NOTE: positions and normals are overwritten by updatePositions
+  std::vector<Vec3> positions;  // vertex position
   const std::vector<unsigned int> indices;
-  const std::vector<Vec3> normals;    // vertex normal
+  std::vector<Vec3> normals;          // vertex normal
   const std::vector<Vec2> texcoords;  // texture coordinates
   const std::vector<Vec3> tangents;   // tangent vector(dp/du)
   const std::vector<Vec3> dndus;      // differential of normal by texcoords
   const std::vector<Vec3> dndvs;      // differential of normal by texcoords
   float surfaceArea_;
+  AABB aabb_;
+
+  // NOTE: built on first use, so that mesh which is flattened into scene
+  // doesn't build tree of its own
+  mutable std::shared_ptr<Intersector<MeshTriangle>> intersector;
+  mutable std::once_flag intersectorFlag;
 
-  std::shared_ptr<Intersector<MeshTriangle>> intersector;
+  // directory where BVH of meshes are cached, empty means no cache
+  static std::filesystem::path bvhCacheDirectory;
+  // use compressed BVH for large meshes to save memory
+  static bool compressBVH;
 
-  void setupIntersector();
+  void setupIntersector() const;
+
+  float computeSurfaceArea() const;
+  AABB computeAABB() const;
 
  public:
   Mesh(const std::vector<Vec3>& positions,
@@ -72,12 +111,37 @@ class Mesh : public Shape {
        const std::vector<Vec3>& tangents, const std::vector<Vec3>& dndus,
        const std::vector<Vec3>& dndvs);
 
+  // cache BVH of meshes in the directory, so that the same mesh is not built
+  // again on the next run(empty path disables cache)
+  static void setBVHCacheDirectory(const std::filesystem::path& directory);
+
+  // build compressed 8-wide BVH for large meshes, whose nodes are about 3x
+  // smaller at the cost of decoding bounds during traversal
+  static void setCompressBVH(bool compress);
+
   unsigned int nVertices() const;
   unsigned int nFaces() const;
+  // make MeshTriangle which represents the face
+  MeshTriangle getTriangle(unsigned int faceID) const;
   float getSurfaceArea() const;
 
+  // build intersector of the mesh unless it's built already
+  // NOTE: called by intersection queries as well, build it before rendering
+  // to keep building out of render loop
+  void buildIntersector() const;
+
+  // move vertices of the mesh, topology is kept
+  // bounds of intersector are refitted instead of building it again
+  // NOTE: normals are updated only when they are given
+  void updatePositions(const std::vector<Vec3>& positions,
+                       const std::vector<Vec3>& normals = {});
+
   bool intersect(const Ray& ray, IntersectInfo& info) const override;
   bool intersectP(const Ray& ray) const override;
+  uint32_t intersectPacket(const RayPacket& packet, uint32_t activeMask,
+                           IntersectInfo info[RayPacket::SIZE]) const override;
+  SurfaceInfo computeSurfaceInfo(const Ray& ray,
+                                 const IntersectInfo& info) const override;
   AABB aabb() const override;
   float surfaceArea() const override;
   SurfaceInfo samplePoint(Sampler& sampler, float& pdf) const override;
@@ -22,6 +22,8 @@ class Plane : public Shape {
 
   bool intersect(const Ray& ray, IntersectInfo& info) const override;
   bool intersectP(const Ray& ray) const override;
+  SurfaceInfo computeSurfaceInfo(const Ray& ray,
+                                 const IntersectInfo& info) const override;
   AABB aabb() const override;
   float surfaceArea() const override;
   SurfaceInfo samplePoint(Sampler& sampler, float& pdf) const override;
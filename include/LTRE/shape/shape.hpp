@@ -1,6 +1,9 @@
 #ifndef _LTRE_SHAPE_H
 #define _LTRE_SHAPE_H
+#include <bit>
+
 #include "LTRE/core/aabb.hpp"
+#include "LTRE/core/ray-packet.hpp"
 #include "LTRE/core/ray.hpp"
 #include "LTRE/core/types.hpp"
 
@@ -11,6 +14,27 @@ class Shape {
   virtual bool intersect(const Ray& ray, IntersectInfo& info) const = 0;
   virtual bool intersectP(const Ray& ray) const = 0;
 
+  // test closest intersection of rays in activeMask, return mask of hit rays
+  // NOTE: ray.tmax of hit rays is shortened to the distance of the hit
+  // NOTE: default implementation traces rays one by one
+  virtual uint32_t intersectPacket(const RayPacket& packet,
+                                   uint32_t activeMask,
+                                   IntersectInfo info[RayPacket::SIZE]) const {
+    uint32_t hitMask = 0;
+    for (; activeMask > 0; activeMask &= activeMask - 1) {
+      const int r = std::countr_zero(activeMask);
+      if (intersect(packet.rays[r], info[r])) {
+        packet.rays[r].tmax = info[r].t;
+        hitMask |= 1u << r;
+      }
+    }
+    return hitMask;
+  }
+
+  // compute surface info of the hit recorded by intersect
+  virtual SurfaceInfo computeSurfaceInfo(const Ray& ray,
+                                         const IntersectInfo& info) const = 0;
+
   virtual AABB aabb() const = 0;
 
   virtual float surfaceArea() const = 0;
@@ -1,6 +1,6 @@
 #include "LTRE/bsdf/bsdf.hpp"
 
-#include "LTRE/sampling/sampling.hpp"
+#include <algorithm>
 
 //
 #include "spdlog/spdlog.h"
@@ -11,7 +11,7 @@ BSDF::BSDF() : nBxDF{0} {}
 
 void BSDF::reset() { nBxDF = 0; }
 
-void BSDF::add(const std::shared_ptr<BxDF>& bxdf, float coefficient) {
+void BSDF::add(const BxDF* bxdf, float coefficient) {
   if (nBxDF >= MAX_NUM_BXDFS) {
     spdlog::error("maximum number of BxDFs exceeded.");
     std::exit(EXIT_FAILURE);
@@ -32,16 +32,27 @@ Vec3 BSDF::f(const Vec3& wo, const Vec3& wi) const {
 
 Vec3 BSDF::sample(Sampler& sampler, const Vec3& wo, Vec3& wi,
                   float& pdf) const {
-  // construct EmpiricalDistribution1D with coef x reflectance
-  std::vector<float> values(nBxDF);
+  // compute cdf of coef x reflectance
+  // NOTE: cdf is kept on stack, since BSDF is sampled at every path vertex
+  float values[MAX_NUM_BXDFS];
+  float sum = 0;
   for (int i = 0; i < nBxDF; ++i) {
     values[i] = coefficients[i] * bxdfs[i]->reflectance(wo);
+    sum += values[i];
+  }
+  float cdf[MAX_NUM_BXDFS + 1];
+  cdf[0] = 0;
+  for (int i = 1; i < nBxDF + 1; ++i) {
+    cdf[i] = cdf[i - 1] + values[i - 1] / sum;
   }
-  DiscreteEmpiricalDistribution1D dist(values);
 
-  // choose 1 BxDF
-  float pdf_choose_bxdf;
-  const unsigned int idx = dist.sample(sampler.getNext1D(), pdf_choose_bxdf);
+  // choose 1 BxDF by inverse cdf
+  // NOTE: cdf's index is +1 from bxdfs
+  int x = std::lower_bound(cdf, cdf + nBxDF + 1, sampler.getNext1D()) - cdf;
+  // NOTE: u may exceed cdf[nBxDF] by rounding error
+  x = std::clamp(x, 1, nBxDF);
+  const float pdf_choose_bxdf = cdf[x] - cdf[x - 1];
+  const int idx = x - 1;
 
   // sample from that BxDF
   const Vec3 bxdf =
@@ -28,6 +28,11 @@ int AABB::longestAxis() const {
   }
 }
 
+bool AABB::isEmpty() const {
+  return bounds[0][0] > bounds[1][0] || bounds[0][1] > bounds[1][1] ||
+         bounds[0][2] > bounds[1][2];
+}
+
 float AABB::surfaceArea() const {
   const Vec3 length = bounds[1] - bounds[0];
   float area = 2.0f * length[0] * length[1] + 2.0f * length[0] * length[2] +
@@ -40,6 +45,12 @@ float AABB::surfaceArea() const {
 
 bool AABB::intersect(const Ray& ray, const Vec3& dirInv,
                      const int dirInvSign[3]) const {
+  float tEntry;
+  return intersect(ray, dirInv, dirInvSign, tEntry);
+}
+
+bool AABB::intersect(const Ray& ray, const Vec3& dirInv,
+                     const int dirInvSign[3], float& tEntry) const {
   // https://dl.acm.org/doi/abs/10.1145/1198555.1198748
   float tmin, tmax, tymin, tymax, tzmin, tzmax;
 
@@ -47,16 +58,20 @@ bool AABB::intersect(const Ray& ray, const Vec3& dirInv,
   tmax = (bounds[1 - dirInvSign[0]][0] - ray.origin[0]) * dirInv[0];
   tymin = (bounds[dirInvSign[1]][1] - ray.origin[1]) * dirInv[1];
   tymax = (bounds[1 - dirInvSign[1]][1] - ray.origin[1]) * dirInv[1];
+  tmax *= SLAB_FAR_SCALE;
+  tymax *= SLAB_FAR_SCALE;
   if (tmin > tymax || tymin > tmax) return false;
   if (tymin > tmin) tmin = tymin;
   if (tymax < tmax) tmax = tymax;
 
   tzmin = (bounds[dirInvSign[2]][2] - ray.origin[2]) * dirInv[2];
   tzmax = (bounds[1 - dirInvSign[2]][2] - ray.origin[2]) * dirInv[2];
+  tzmax *= SLAB_FAR_SCALE;
   if (tmin > tzmax || tzmin > tmax) return false;
   if (tzmin > tmin) tmin = tzmin;
   if (tzmax < tmax) tmax = tzmax;
 
+  tEntry = tmin;
   return tmin < ray.tmax && tmax > ray.tmin;
 }
 
@@ -78,6 +93,15 @@ AABB mergeAABB(const AABB& bbox1, const AABB& bbox2) {
   return ret;
 }
 
+AABB overlapAABB(const AABB& bbox1, const AABB& bbox2) {
+  AABB ret;
+  for (int i = 0; i < 3; ++i) {
+    ret.bounds[0][i] = std::max(bbox1.bounds[0][i], bbox2.bounds[0][i]);
+    ret.bounds[1][i] = std::min(bbox1.bounds[1][i], bbox2.bounds[1][i]);
+  }
+  return ret;
+}
+
 std::ostream& operator<<(std::ostream& stream, const AABB& bbox) {
   stream << bbox.bounds[0] << ", " << bbox.bounds[1];
   return stream;
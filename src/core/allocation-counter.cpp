@@ -0,0 +1,54 @@
+#include "LTRE/core/allocation-counter.hpp"
+
+#ifdef LTRE_COUNT_ALLOCATIONS
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#endif
+
+namespace LTRE {
+
+#ifdef LTRE_COUNT_ALLOCATIONS
+// NOTE: constant initialized, so that it's safe to touch from operator new
+// while thread is starting
+static thread_local uint64_t nAllocations = 0;
+
+uint64_t AllocationCounter::count() { return nAllocations; }
+
+static void* allocate(std::size_t size, std::size_t alignment) {
+  nAllocations++;
+  if (size == 0) size = 1;
+
+  void* ptr;
+  if (alignment <= alignof(std::max_align_t)) {
+    ptr = std::malloc(size);
+  } else {
+    // NOTE: size of aligned_alloc must be multiple of alignment
+    ptr = std::aligned_alloc(alignment,
+                             (size + alignment - 1) / alignment * alignment);
+  }
+  if (!ptr) throw std::bad_alloc();
+  return ptr;
+}
+#else
+uint64_t AllocationCounter::count() { return 0; }
+#endif
+
+}  // namespace LTRE
+
+#ifdef LTRE_COUNT_ALLOCATIONS
+// NOTE: array and nothrow versions call these by default
+void* operator new(std::size_t size) {
+  return LTRE::allocate(size, alignof(std::max_align_t));
+}
+void* operator new(std::size_t size, std::align_val_t alignment) {
+  return LTRE::allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+#endif
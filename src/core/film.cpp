@@ -0,0 +1,103 @@
+#include "LTRE/core/film.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "LTRE/core/spectrum.hpp"
+
+namespace LTRE {
+
+Film::Film(unsigned int width, unsigned int height,
+           const std::vector<Tile>& tiles)
+    : width{width},
+      height{height},
+      pixels(width * height),
+      tiles{tiles},
+      published{width, height},
+      tileMutexes{std::make_unique<std::mutex[]>(tiles.size())} {}
+
+void Film::setConvergenceCriterion(const ConvergenceCriterion& criterion) {
+  this->criterion = criterion;
+}
+
+void Film::clear() {
+  pixels.assign(width * height, Pixel());
+  for (std::size_t t = 0; t < tiles.size(); ++t) {
+    const Tile& tile = tiles[t];
+    std::lock_guard<std::mutex> lock(tileMutexes[t]);
+    for (unsigned int j = tile.y0; j < tile.y1; ++j) {
+      for (unsigned int i = tile.x0; i < tile.x1; ++i) {
+        published.setPixel(i, j, Vec3(0));
+      }
+    }
+  }
+}
+
+bool Film::addSample(unsigned int i, unsigned int j, const Vec3& radiance) {
+  Pixel& pixel = pixels[i + width * j];
+  pixel.sum += radiance;
+  pixel.nSamples++;
+
+  const float y = Spectrum::RGB2XYZ(radiance)[1];
+  const float delta = y - pixel.mean;
+  pixel.mean += delta / pixel.nSamples;
+  pixel.m2 += delta * (y - pixel.mean);
+
+  if (criterion.threshold <= 0 || pixel.converged ||
+      pixel.nSamples < std::max(criterion.minSamples, 2u)) {
+    return false;
+  }
+
+  // standard error of mean
+  const float variance = pixel.m2 / (pixel.nSamples - 1);
+  const float error = std::sqrt(variance / pixel.nSamples);
+  // NOTE: dark pixels are compared with absolute error, otherwise they never
+  // converge
+  pixel.converged =
+      error <= criterion.threshold * std::max(std::abs(pixel.mean), 1e-3f);
+  return pixel.converged;
+}
+
+bool Film::isConverged(unsigned int i, unsigned int j) const {
+  return pixels[i + width * j].converged;
+}
+
+void Film::publish(std::size_t tileIdx) {
+  const Tile& tile = tiles[tileIdx];
+  std::lock_guard<std::mutex> lock(tileMutexes[tileIdx]);
+  for (unsigned int j = tile.y0; j < tile.y1; ++j) {
+    for (unsigned int i = tile.x0; i < tile.x1; ++i) {
+      const Pixel& pixel = pixels[i + width * j];
+      if (pixel.nSamples == 0) continue;
+      published.setPixel(i, j, pixel.sum / pixel.nSamples);
+    }
+  }
+}
+
+Image<Vec3> Film::snapshot() const {
+  // NOTE: tiles are copied one by one, so that publish of other tiles isn't
+  // blocked while image is copied
+  Image<Vec3> ret(width, height);
+  for (std::size_t t = 0; t < tiles.size(); ++t) {
+    const Tile& tile = tiles[t];
+    std::lock_guard<std::mutex> lock(tileMutexes[t]);
+    for (unsigned int j = tile.y0; j < tile.y1; ++j) {
+      for (unsigned int i = tile.x0; i < tile.x1; ++i) {
+        ret.setPixel(i, j, published.getPixel(i, j));
+      }
+    }
+  }
+  return ret;
+}
+
+Image<float> Film::sampleCounts() const {
+  Image<float> ret(width, height);
+  for (unsigned int j = 0; j < height; ++j) {
+    for (unsigned int i = 0; i < width; ++i) {
+      ret.setPixel(i, j, pixels[i + width * j].nSamples);
+    }
+  }
+  return ret;
+}
+
+}  // namespace LTRE
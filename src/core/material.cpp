@@ -6,17 +6,23 @@
 
 namespace LTRE {
 
+// NOTE: BSDF only lives during f() or sample() of a path vertex, so arena of
+// each thread is reset for every call instead of allocating BxDFs
+static thread_local BSDFArena threadArena;
+
 // NOTE: having bsdf as private member does not work on multithread case
 Vec3 Material::f(const Vec3& wo, const Vec3& wi,
                  const SurfaceInfo& info) const {
-  const BSDF bsdf = prepareBSDF(info);
+  threadArena.reset();
+  const BSDF bsdf = prepareBSDF(info, threadArena);
   return bsdf.f(wo, wi);
 }
 
 // NOTE: having bsdf as private member does not work on multithread case
 Vec3 Material::sample(Sampler& sampler, const Vec3& wo, const SurfaceInfo& info,
                       Vec3& wi, float& pdf) const {
-  const BSDF bsdf = prepareBSDF(info);
+  threadArena.reset();
+  const BSDF bsdf = prepareBSDF(info, threadArena);
   return bsdf.sample(sampler, wo, wi, pdf);
 }
 
@@ -24,10 +30,10 @@ Diffuse::Diffuse(const std::shared_ptr<Texture<Vec3>>& baseColor,
                  float roughness)
     : _baseColor(baseColor), roughness(roughness) {}
 
-BSDF Diffuse::prepareBSDF(const SurfaceInfo& info) const {
+BSDF Diffuse::prepareBSDF(const SurfaceInfo& info, BSDFArena& arena) const {
   BSDF bsdf;
   const Vec3 rho = _baseColor->sample(info);
-  bsdf.add(std::make_shared<OrenNayer>(rho, roughness), 1.0f);
+  bsdf.add(arena.create<OrenNayer>(rho, roughness), 1.0f);
   return bsdf;
 }
 
@@ -38,13 +44,12 @@ Vec3 Diffuse::baseColor(const SurfaceInfo& info) const {
 Metal::Metal(const std::shared_ptr<Texture<Vec3>>& baseColor, float roughness)
     : baseColor_(baseColor), roughness_(roughness) {}
 
-BSDF Metal::prepareBSDF(const SurfaceInfo& info) const {
+BSDF Metal::prepareBSDF(const SurfaceInfo& info, BSDFArena& arena) const {
   BSDF bsdf;
   const Vec3 rho = baseColor_->sample(info);
-  const auto F = std::make_shared<FresnelSchlick>(rho);
-  const auto D =
-      std::make_shared<GGX>(std::max(roughness_ * roughness_, 0.001f));
-  const auto bxdf = std::make_shared<MicrofacetBRDF>(F.get(), D.get());
+  const auto F = arena.create<FresnelSchlick>(rho);
+  const auto D = arena.create<GGX>(std::max(roughness_ * roughness_, 0.001f));
+  const auto bxdf = arena.create<MicrofacetBRDF>(F, D);
   bsdf.add(bxdf, 1.0f);
   return bsdf;
 }
@@ -55,13 +60,13 @@ Vec3 Metal::baseColor(const SurfaceInfo& info) const {
 
 Glass::Glass(float ior, float roughness) : ior_(ior), roughness_(roughness) {}
 
-BSDF Glass::prepareBSDF([[maybe_unused]] const SurfaceInfo& info) const {
+BSDF Glass::prepareBSDF([[maybe_unused]] const SurfaceInfo& info,
+                         BSDFArena& arena) const {
   BSDF bsdf;
-  const auto F = std::make_shared<FresnelDielectric>(1.0f, ior_);
-  const auto D =
-      std::make_shared<GGX>(std::max(roughness_ * roughness_, 0.001f));
-  const auto brdf = std::make_shared<MicrofacetBRDF>(F.get(), D.get());
-  const auto btdf = std::make_shared<MicrofacetBTDF>(F.get(), D.get());
+  const auto F = arena.create<FresnelDielectric>(1.0f, ior_);
+  const auto D = arena.create<GGX>(std::max(roughness_ * roughness_, 0.001f));
+  const auto brdf = arena.create<MicrofacetBRDF>(F, D);
+  const auto btdf = arena.create<MicrofacetBTDF>(F, D);
   bsdf.add(brdf, 1.0f);
   bsdf.add(btdf, 1.0f);
   return bsdf;
@@ -86,7 +91,8 @@ DisneyPrincipledBRDF::DisneyPrincipledBRDF(
       clearcoat_(clearcoat),
       clearcoatGloss_(clearcoatGloss) {}
 
-BSDF DisneyPrincipledBRDF::prepareBSDF(const SurfaceInfo& info) const {
+BSDF DisneyPrincipledBRDF::prepareBSDF(const SurfaceInfo& info,
+                                       BSDFArena& arena) const {
   BSDF bsdf;
   const Vec3 baseColor = baseColor_->sample(info);
   const float kDiffuse = (1.0f - metallic_) * (1.0f - subsurface_);
@@ -95,15 +101,14 @@ BSDF DisneyPrincipledBRDF::prepareBSDF(const SurfaceInfo& info) const {
   const float kSpecular = 1.0f;
   const float kClearcoat = 1.0f;
 
-  bsdf.add(std::make_shared<DisneyDiffuse>(baseColor, roughness_), kDiffuse);
-  bsdf.add(std::make_shared<DisneySubsurface>(baseColor, subsurface_),
+  bsdf.add(arena.create<DisneyDiffuse>(baseColor, roughness_), kDiffuse);
+  bsdf.add(arena.create<DisneySubsurface>(baseColor, subsurface_),
            kSubsurface);
-  bsdf.add(std::make_shared<DisneySheen>(baseColor, sheen_, sheenTint_),
-           kSheen);
-  bsdf.add(std::make_shared<DisneySpecular>(baseColor, roughness_, specular_,
-                                            specularTint_, metallic_, 0),
+  bsdf.add(arena.create<DisneySheen>(baseColor, sheen_, sheenTint_), kSheen);
+  bsdf.add(arena.create<DisneySpecular>(baseColor, roughness_, specular_,
+                                        specularTint_, metallic_, 0),
            kSpecular);
-  bsdf.add(std::make_shared<DisneyClearcoat>(clearcoat_, clearcoatGloss_),
+  bsdf.add(arena.create<DisneyClearcoat>(clearcoat_, clearcoatGloss_),
            kClearcoat);
   return bsdf;
 }
@@ -19,13 +19,21 @@ void Model::loadModel(const std::filesystem::path& filepath) {
     return;
   }
 
-  // process scene graph
+  // process meshes
+  // NOTE: mesh is loaded only once even if it's referenced by several nodes
   const std::filesystem::path ps(filepath);
-  processNode(scene->mRootNode, scene, ps.parent_path());
+  for (std::size_t i = 0; i < scene->mNumMeshes; ++i) {
+    processMesh(scene->mMeshes[i], scene, ps.parent_path());
+  }
+
+  // process scene graph
+  processNode(scene->mRootNode, Transform());
 
   // show info
   spdlog::info("[Model] " + filepath.string() + " loaded.");
   spdlog::info("[Model] number of meshes: " + std::to_string(meshes.size()));
+  spdlog::info("[Model] number of instances: " +
+               std::to_string(instances.size()));
 
   std::size_t nVertices = 0;
   std::size_t nFaces = 0;
@@ -39,16 +47,29 @@ void Model::loadModel(const std::filesystem::path& filepath) {
                std::to_string(textures.size()));
 }
 
-void Model::processNode(const aiNode* node, const aiScene* scene,
-                        const std::filesystem::path& parentPath) {
-  // process all the node's meshes
+void Model::processNode(const aiNode* node,
+                        const Transform& parentTransform) {
+  // node with singular transform is never visible
+  const aiMatrix4x4& t = node->mTransformation;
+  if (t.Determinant() == 0) {
+    spdlog::warn("[Model] node " + std::string(node->mName.C_Str()) +
+                 " has singular transform, skipped.");
+    return;
+  }
+
+  // accumulate transform of the node
+  const float m[3][4] = {{t.a1, t.a2, t.a3, t.a4},
+                         {t.b1, t.b2, t.b3, t.b4},
+                         {t.c1, t.c2, t.c3, t.c4}};
+  const Transform transform = parentTransform * Transform(m);
+
+  // instantiate all the node's meshes
   for (std::size_t i = 0; i < node->mNumMeshes; ++i) {
-    const aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-    processMesh(mesh, scene, parentPath);
+    instances.push_back({node->mMeshes[i], transform});
   }
 
   for (std::size_t i = 0; i < node->mNumChildren; ++i) {
-    processNode(node->mChildren[i], scene, parentPath);
+    processNode(node->mChildren[i], transform);
   }
 }
 
@@ -269,6 +290,11 @@ std::shared_ptr<Material> Model::createMaterial(unsigned int idx) const {
 }
 
 std::shared_ptr<AreaLight> Model::createAreaLight(unsigned int idx) const {
+  return createAreaLight(idx, meshes[idx]);
+}
+
+std::shared_ptr<AreaLight> Model::createAreaLight(
+    unsigned int idx, const std::shared_ptr<Shape>& shape) const {
   const MaterialM& material = materials[idx];
 
   bool hasLight = false;
@@ -282,10 +308,10 @@ std::shared_ptr<AreaLight> Model::createAreaLight(unsigned int idx) const {
   }
 
   if (hasLight) {
-    return std::make_shared<AreaLight>(le, meshes[idx]);
+    return std::make_shared<AreaLight>(le, shape);
   } else {
     return nullptr;
   }
 }
 
-}  // namespace LTRE
\ No newline at end of file
+}  // namespace LTRE
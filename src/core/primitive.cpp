@@ -1,5 +1,7 @@
 #include "LTRE/core/primitive.hpp"
 
+#include <bit>
+
 namespace LTRE {
 
 Primitive::Primitive(const std::shared_ptr<Shape>& shape,
@@ -7,10 +9,14 @@ Primitive::Primitive(const std::shared_ptr<Shape>& shape,
                      const std::shared_ptr<AreaLight>& areaLight)
     : shape(shape), material(material), areaLight(areaLight) {}
 
+std::shared_ptr<Shape> Primitive::getShapePtr() const { return shape; }
+
 std::shared_ptr<AreaLight> Primitive::getAreaLightPtr() const {
   return areaLight;
 }
 
+const Material* Primitive::getMaterial() const { return material.get(); }
+
 AABB Primitive::aabb() const { return shape->aabb(); }
 
 bool Primitive::intersect(const Ray& ray, IntersectInfo& info) const {
@@ -26,6 +32,21 @@ bool Primitive::intersectP(const Ray& ray) const {
   return shape->intersectP(ray);
 }
 
+uint32_t Primitive::intersectPacket(const RayPacket& packet,
+                                    uint32_t activeMask,
+                                    IntersectInfo info[RayPacket::SIZE]) const {
+  const uint32_t hitMask = shape->intersectPacket(packet, activeMask, info);
+  for (uint32_t bits = hitMask; bits > 0; bits &= bits - 1) {
+    info[std::countr_zero(bits)].hitPrimitive = this;
+  }
+  return hitMask;
+}
+
+SurfaceInfo Primitive::computeSurfaceInfo(const Ray& ray,
+                                          const IntersectInfo& info) const {
+  return shape->computeSurfaceInfo(ray, info);
+}
+
 Vec3 Primitive::evaluateBSDF(const Vec3& wo, const Vec3& wi,
                              const SurfaceInfo& info) const {
   // compute tangent space basis
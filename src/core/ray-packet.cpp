@@ -0,0 +1,85 @@
+#include "LTRE/core/ray-packet.hpp"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+namespace LTRE {
+
+RayPacketData::RayPacketData(const RayPacket& packet, uint32_t activeMask) {
+  for (int r = 0; r < RayPacket::SIZE; ++r) {
+    const Ray& ray = packet.rays[r];
+    const Vec3 _dirInv = 1.0f / ray.direction;
+    for (int i = 0; i < 3; ++i) {
+      orig[i][r] = ray.origin[i];
+      dirInv[i][r] = _dirInv[i];
+    }
+    tmin[r] = ray.tmin;
+    tmax[r] = ray.tmax;
+  }
+
+  const int first = activeMask > 0 ? std::countr_zero(activeMask) : 0;
+  for (int i = 0; i < 3; ++i) {
+    dirInvSign[i] = dirInv[i][first] > 0 ? 0 : 1;
+  }
+}
+
+void RayPacketData::updateTmax(const RayPacket& packet, uint32_t mask) {
+  for (; mask > 0; mask &= mask - 1) {
+    const int r = std::countr_zero(mask);
+    tmax[r] = packet.rays[r].tmax;
+  }
+}
+
+uint32_t RayPacketData::intersect(const AABB& bbox, uint32_t mask) const {
+#ifdef __AVX__
+  static_assert(RayPacket::SIZE == 8, "packet must fill AVX register");
+
+  // SIMD version of https://dl.acm.org/doi/abs/10.1145/1198555.1198748
+  // NOTE: each ray picks near and far plane by sign of its direction
+  __m256 tNear = _mm256_set1_ps(std::numeric_limits<float>::lowest());
+  __m256 tFar = _mm256_set1_ps(std::numeric_limits<float>::max());
+  for (int i = 0; i < 3; ++i) {
+    const __m256 o = _mm256_load_ps(orig[i]);
+    const __m256 d = _mm256_load_ps(dirInv[i]);
+    const __m256 t0 =
+        _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bbox.bounds[0][i]), o), d);
+    const __m256 t1 =
+        _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(bbox.bounds[1][i]), o), d);
+    const __m256 near = _mm256_blendv_ps(t0, t1, d);
+    const __m256 far = _mm256_mul_ps(_mm256_blendv_ps(t1, t0, d),
+                                     _mm256_set1_ps(SLAB_FAR_SCALE));
+    tNear = _mm256_max_ps(tNear, near);
+    tFar = _mm256_min_ps(tFar, far);
+  }
+
+  const __m256 hit = _mm256_and_ps(
+      _mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ),
+      _mm256_and_ps(
+          _mm256_cmp_ps(tNear, _mm256_load_ps(tmax), _CMP_LT_OQ),
+          _mm256_cmp_ps(tFar, _mm256_load_ps(tmin), _CMP_GT_OQ)));
+  return _mm256_movemask_ps(hit) & mask;
+#else
+  uint32_t hitMask = 0;
+  for (uint32_t bits = mask; bits > 0; bits &= bits - 1) {
+    const int r = std::countr_zero(bits);
+    float tNear = std::numeric_limits<float>::lowest();
+    float tFar = std::numeric_limits<float>::max();
+    for (int i = 0; i < 3; ++i) {
+      float t0 = (bbox.bounds[0][i] - orig[i][r]) * dirInv[i][r];
+      float t1 = (bbox.bounds[1][i] - orig[i][r]) * dirInv[i][r];
+      if (dirInv[i][r] < 0) std::swap(t0, t1);
+      tNear = std::max(tNear, t0);
+      tFar = std::min(tFar, t1 * SLAB_FAR_SCALE);
+    }
+    if (tNear <= tFar && tNear < tmax[r] && tFar > tmin[r]) {
+      hitMask |= 1u << r;
+    }
+  }
+  return hitMask;
+#endif
+}
+
+}  // namespace LTRE
@@ -2,14 +2,82 @@
 
 #include <omp.h>
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
 
 #include "spdlog/spdlog.h"
 //
+#include "LTRE/core/allocation-counter.hpp"
 #include "LTRE/core/io.hpp"
+#include "LTRE/intersector/traversal-stats.hpp"
 
 namespace LTRE {
 
+// map value(e.g. traversal cost) to color from blue(low) to red(high), value
+// is normalized by the maximum of image
+static Image<Vec3> heatmap(const Image<float>& value) {
+  float maxValue = 0;
+  for (unsigned int j = 0; j < value.getHeight(); ++j) {
+    for (unsigned int i = 0; i < value.getWidth(); ++i) {
+      maxValue = std::max(maxValue, value.getPixel(i, j));
+    }
+  }
+
+  Image<Vec3> heatmap(value.getWidth(), value.getHeight());
+  for (unsigned int j = 0; j < value.getHeight(); ++j) {
+    for (unsigned int i = 0; i < value.getWidth(); ++i) {
+      const float x = maxValue > 0 ? value.getPixel(i, j) / maxValue : 0;
+      // blue -> cyan -> green -> yellow -> red
+      const auto ramp = [&](float center) {
+        return std::clamp(1.5f - std::abs(4.0f * x - center), 0.0f, 1.0f);
+      };
+      heatmap.setPixel(i, j, Vec3(ramp(3), ramp(2), ramp(1)));
+    }
+  }
+  return heatmap;
+}
+
+// run f, and add number of heap allocations made by it to nAllocations
+template <typename F>
+static void countAllocations(std::atomic<uint64_t>& nAllocations,
+                             const F& f) {
+  const uint64_t before = AllocationCounter::count();
+  f();
+  if constexpr (AllocationCounter::ENABLED) {
+    nAllocations += AllocationCounter::count() - before;
+  }
+}
+
+// render loop must not allocate after setup, abort if it does
+static void checkAllocations(uint64_t nAllocations, unsigned int nFrames) {
+  if constexpr (AllocationCounter::ENABLED) {
+    if (nAllocations > 0) {
+      spdlog::error(
+          "[Renderer] heap allocations in render loop: {0} ({1} per frame)",
+          nAllocations, nAllocations / std::max(nFrames, 1u));
+      std::abort();
+    } else {
+      spdlog::info("[Renderer] no heap allocations in render loop");
+    }
+  }
+}
+
+// seed of sampler for pass of pixel, scrambled by splitmix64 finalizer
+// NOTE: PCG states which differ by constant step give correlated sequences,
+// so that pass can't be just added to seed of pixel
+static uint64_t passSeed(unsigned int pixel, unsigned int pass) {
+  uint64_t z = (uint64_t(pass) << 32) | pixel;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
 AOV::AOV(unsigned int width, unsigned int height)
     : beauty{width, height},
       position{width, height},
@@ -17,51 +85,165 @@ AOV::AOV(unsigned int width, unsigned int height)
       normal{width, height},
       barycentric{width, height},
       texcoords{width, height},
-      baseColor{width, height} {}
+      baseColor{width, height},
+      traversalCost{width, height},
+      sampleCount{width, height} {}
+
+bool Renderer::tilePixel(unsigned int tileX, unsigned int tileY, int k,
+                         unsigned int& i, unsigned int& j) const {
+  i = TILE_WIDTH * tileX + k % TILE_WIDTH;
+  j = TILE_HEIGHT * tileY + k / TILE_WIDTH;
+  return i < width && j < height;
+}
+
+uint32_t Renderer::integrateTile(const Scene& scene, unsigned int tileX,
+                                 unsigned int tileY,
+                                 Sampler* const samplers[RayPacket::SIZE],
+                                 Vec3 radiance[RayPacket::SIZE]) const {
+  // generate camera rays
+  RayPacket packet;
+  uint32_t activeMask = 0;
+  Vec2 uv[RayPacket::SIZE];
+  Vec3 wi[RayPacket::SIZE];
+  float pdf[RayPacket::SIZE];
+  for (int k = 0; k < RayPacket::SIZE; ++k) {
+    unsigned int i, j;
+    if (!tilePixel(tileX, tileY, k, i, j) || !samplers[k]) continue;
+    Sampler& sampler = *samplers[k];
+
+    // compute (u, v) with SSAA
+    // NOTE: adding "-"" to flip uv
+    uv[k][0] = -(2.0f * (i + sampler.getNext1D()) - width) / height;
+    uv[k][1] = -(height - 2.0f * (j + sampler.getNext1D())) / height;
+
+    if (camera->sampleRay(uv[k], sampler, packet.rays[k], wi[k], pdf[k])) {
+      activeMask |= 1u << k;
+    }
+  }
+
+  // integrate light transport equation
+  Vec3 Li[RayPacket::SIZE];
+  integrator->integratePacket(packet, activeMask, scene, samplers, Li);
+
+  uint32_t mask = 0;
+  for (uint32_t bits = activeMask; bits > 0; bits &= bits - 1) {
+    const int k = std::countr_zero(bits);
+
+    // evaluate We
+    const Vec3 We = camera->We(uv[k], wi[k]);
+
+    // evaluate cos
+    const float cos = std::max(dot(wi[k], camera->getCameraForward()), 0.0f);
+
+    radiance[k] = We * Li[k] * cos / pdf[k];
+    if (radiance[k].isNan()) {
+      spdlog::error("[Renderer] radiance has NaN");
+      continue;
+      // std::exit(EXIT_FAILURE);
+    }
+    mask |= 1u << k;
+  }
+  return mask;
+}
+
+std::vector<std::unique_ptr<Sampler>> Renderer::cloneSamplers(
+    unsigned int n) const {
+  std::vector<std::unique_ptr<Sampler>> ret(n);
+  for (unsigned int i = 0; i < n; ++i) {
+    ret[i] = sampler->clone();
+  }
+  return ret;
+}
 
 void Renderer::renderFirstHitAOV(const Scene& scene) {
-#pragma omp parallel for schedule(dynamic, 1) collapse(2)
-  for (unsigned int j = 0; j < height; ++j) {
-    for (unsigned int i = 0; i < width; ++i) {
-      // setup sampler
-      std::unique_ptr<Sampler> sampler = this->sampler->clone();
-      sampler->setSeed(i + width * j);
-
-      // compute (u, v)
-      // NOTE: adding "-"" to flip uv
-      Vec2 uv;
-      uv[0] = -(2.0f * i - width) / height;
-      uv[1] = -(height - 2.0f * j) / height;
-
-      Ray ray;
-      Vec3 wi;
-      float pdf;
-      if (camera->sampleRay(uv, *sampler, ray, wi, pdf)) {
-        IntersectInfo info;
-        if (scene.intersect(ray, info)) {
-          aov.depth.setPixel(i, j, info.t);
-          aov.position.setPixel(i, j, info.surfaceInfo.position);
-          aov.normal.setPixel(i, j, 0.5f * (info.surfaceInfo.normal + 1.0f));
-          aov.barycentric.setPixel(i, j, info.barycentric);
-          aov.texcoords.setPixel(i, j, info.surfaceInfo.uv);
-          aov.baseColor.setPixel(
-              i, j, info.hitPrimitive->baseColor(info.surfaceInfo));
+  // NOTE: sampler of each thread is reseeded for each pixel
+  const std::vector<std::unique_ptr<Sampler>> threadSamplers =
+      cloneSamplers(TileScheduler::maxThreads());
+
+  scheduler.parallelForEach([&](const Tile& tile, int thread) {
+    Sampler* sampler = threadSamplers[thread].get();
+
+    forEachPacketTile(tile, [&](unsigned int tileX, unsigned int tileY) {
+      // generate camera rays of the tile
+      RayPacket packet;
+      uint32_t activeMask = 0;
+      for (int k = 0; k < RayPacket::SIZE; ++k) {
+        unsigned int i, j;
+        if (!tilePixel(tileX, tileY, k, i, j)) continue;
+
+        // setup sampler
+        sampler->setSeed(i + width * j);
+
+        // compute (u, v)
+        // NOTE: adding "-"" to flip uv
+        Vec2 uv;
+        uv[0] = -(2.0f * i - width) / height;
+        uv[1] = -(height - 2.0f * j) / height;
+
+        Vec3 wi;
+        float pdf;
+        if (camera->sampleRay(uv, *sampler, packet.rays[k], wi, pdf)) {
+          activeMask |= 1u << k;
         }
       }
-    }
-  }
+
+      // trace camera rays one by one to measure traversal cost of each pixel
+      // NOTE: packet traversal can't tell cost of each ray
+      if constexpr (TraversalStats::ENABLED) {
+        for (uint32_t bits = activeMask; bits > 0; bits &= bits - 1) {
+          const int k = std::countr_zero(bits);
+          unsigned int i, j;
+          tilePixel(tileX, tileY, k, i, j);
+
+          const Ray ray = packet.rays[k];
+          IntersectInfo info;
+          scene.intersect(ray, info);
+          const TraversalCounters counters = TraversalStats::lastQuery();
+          aov.traversalCost.setPixel(i, j,
+                                     counters.nodes + counters.primitives);
+        }
+      }
+
+      IntersectInfo info[RayPacket::SIZE];
+      const uint32_t hitMask = scene.intersectPacket(packet, activeMask, info);
+      for (uint32_t bits = hitMask; bits > 0; bits &= bits - 1) {
+        const int k = std::countr_zero(bits);
+        unsigned int i, j;
+        tilePixel(tileX, tileY, k, i, j);
+
+        aov.depth.setPixel(i, j, info[k].t);
+        aov.position.setPixel(i, j, info[k].surfaceInfo.position);
+        aov.normal.setPixel(i, j, 0.5f * (info[k].surfaceInfo.normal + 1.0f));
+        aov.barycentric.setPixel(i, j, info[k].barycentric);
+        aov.texcoords.setPixel(i, j, info[k].surfaceInfo.uv);
+        aov.baseColor.setPixel(
+            i, j, info[k].hitPrimitive->baseColor(info[k].surfaceInfo));
+      }
+    });
+  });
 }
 
 Renderer::Renderer(unsigned int width, unsigned int height,
                    const std::shared_ptr<Camera>& camera,
                    const std::shared_ptr<Integrator>& integrator,
-                   const std::shared_ptr<Sampler>& sampler)
+                   const std::shared_ptr<Sampler>& sampler,
+                   unsigned int tileSize, TileOrder tileOrder)
     : width(width),
       height(height),
       camera{camera},
       integrator{integrator},
       sampler{sampler},
-      aov{width, height} {}
+      aov{width, height},
+      scheduler{width, height,
+                (std::max(tileSize, 1u) + TILE_WIDTH - 1) / TILE_WIDTH *
+                    TILE_WIDTH,
+                tileOrder},
+      film{width, height, scheduler.getTiles()} {
+  static_assert(TILE_WIDTH % TILE_HEIGHT == 0,
+                "tile of multiple of TILE_WIDTH must hold whole packet tiles");
+}
+
+Renderer::~Renderer() { stop(); }
 
 void Renderer::focus(const Vec3& p) { camera->focus(p); }
 
@@ -81,139 +263,278 @@ void Renderer::focus(const Scene& scene) {
 }
 
 void Renderer::render(const Scene& scene, unsigned int samples) {
+  // NOTE: with adaptive sampling, samples x pixels is spent as a whole, so
+  // that samples saved on converged pixels are spent on noisy pixels
+  if (convergence.threshold > 0) {
+    beginProgressive(scene);
+    spdlog::info("[Renderer] sample budget: {0} per pixel", samples);
+    renderProgressive(scene, {}, CancellationToken(),
+                      uint64_t(samples) * width * height);
+    aov.beauty = film.snapshot();
+    return;
+  }
+
   renderFirstHitAOV(scene);
+  TraversalStats::reset();
 
   spdlog::info("[Renderer] samples: " + std::to_string(samples));
   spdlog::info("[Renderer] rendering started...");
 
+  // setup samplers of each thread
+  // NOTE: samplers are reseeded for pixels of each packet tile, so that render
+  // loop doesn't allocate
+  const std::vector<std::unique_ptr<Sampler>> threadSamplers =
+      cloneSamplers(RayPacket::SIZE * TileScheduler::maxThreads());
+
+  std::atomic<uint64_t> nAllocations{0};
   const auto startTime = std::chrono::steady_clock::now();
-#pragma omp parallel for schedule(dynamic, 1) collapse(2)
-  for (unsigned int j = 0; j < height; ++j) {
-    for (unsigned int i = 0; i < width; ++i) {
-      // setup sampler
-      std::unique_ptr<Sampler> sampler = this->sampler->clone();
-      sampler->setSeed(i + width * j);
-
-      // compute radiance
-      Vec3 radiance(0);
-      for (unsigned int sample = 0; sample < samples; ++sample) {
-        // compute (u, v) with SSAA
-        // NOTE: adding "-"" to flip uv
-        Vec2 uv;
-        uv[0] = -(2.0f * (i + sampler->getNext1D()) - width) / height;
-        uv[1] = -(height - 2.0f * (j + sampler->getNext1D())) / height;
+  scheduler.parallelForEach([&](const Tile& tile, int thread) {
+    countAllocations(nAllocations, [&] {
+      const auto samplers = threadSamplers.begin() + RayPacket::SIZE * thread;
+
+      forEachPacketTile(tile, [&](unsigned int tileX, unsigned int tileY) {
+        // setup sampler of each pixel
+        Sampler* samplerPtrs[RayPacket::SIZE] = {};
+        for (int k = 0; k < RayPacket::SIZE; ++k) {
+          unsigned int i, j;
+          if (!tilePixel(tileX, tileY, k, i, j)) continue;
+          samplers[k]->setSeed(i + width * j);
+          samplerPtrs[k] = samplers[k].get();
+        }
 
-        // generate camera ray
-        Ray ray;
-        Vec3 wi;
-        float pdf;
-        if (camera->sampleRay(uv, *sampler, ray, wi, pdf)) {
-          // evaluate We
-          const Vec3 We = camera->We(uv, wi);
-
-          // evaluate cos
-          const float cos = std::max(dot(wi, camera->getCameraForward()), 0.0f);
-
-          // integrate light transport equation
-          const Vec3 dPhi =
-              We * integrator->integrate(ray, scene, *sampler) * cos / pdf;
-          if (dPhi.isNan()) {
-            spdlog::error("[Renderer] radiance has NaN");
-            continue;
-            // std::exit(EXIT_FAILURE);
+        // compute radiance
+        Vec3 radiance[RayPacket::SIZE];
+        for (unsigned int sample = 0; sample < samples; ++sample) {
+          Vec3 dPhi[RayPacket::SIZE];
+          uint32_t mask =
+              integrateTile(scene, tileX, tileY, samplerPtrs, dPhi);
+          for (; mask > 0; mask &= mask - 1) {
+            const int k = std::countr_zero(mask);
+            radiance[k] += dPhi[k];
           }
-
-          radiance += dPhi;
         }
-      }
 
-      // take average
-      radiance /= samples;
-      aov.beauty.setPixel(i, j, radiance);
-    }
-  }
+        // take average
+        for (int k = 0; k < RayPacket::SIZE; ++k) {
+          unsigned int i, j;
+          if (!tilePixel(tileX, tileY, k, i, j)) continue;
+          aov.beauty.setPixel(i, j, radiance[k] / samples);
+          aov.sampleCount.setPixel(i, j, samples);
+        }
+      });
+    });
+  });
   const auto endTime = std::chrono::steady_clock::now();
   const auto ms =
       std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime)
           .count();
   spdlog::info("[Renderer] rendering finished in " + std::to_string(ms) +
                " ms");
+  renderAllocations = nAllocations.load();
+  checkAllocations(nAllocations, 1);
+
+  if constexpr (TraversalStats::ENABLED) {
+    TraversalStats::log(TraversalStats::collect());
+  }
 }
 
 void Renderer::renderWithInLimitTime(const Scene& scene,
                                      unsigned int limitTime) {
-  renderFirstHitAOV(scene);
+  start(scene);
 
-  spdlog::info("[Renderer] rendering started...");
-  const auto startTime = std::chrono::steady_clock::now();
-
-  // setup sampler
-  std::vector<std::unique_ptr<Sampler>> samplers(width * height);
-  for (unsigned int j = 0; j < height; ++j) {
-    for (unsigned int i = 0; i < width; ++i) {
-      samplers[i + width * j] = this->sampler->clone();
-      samplers[i + width * j]->setSeed(i + width * j);
-    }
+  // NOTE: rendering finishes before limit time when all pixels are converged
+  const auto endTime = std::chrono::steady_clock::now() +
+                       std::chrono::milliseconds(limitTime);
+  while (isRendering() && std::chrono::steady_clock::now() < endTime) {
+    std::this_thread::sleep_for(std::min(
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            endTime - std::chrono::steady_clock::now()),
+        std::chrono::milliseconds(10)));
   }
+  stop();
+  aov.beauty = film.snapshot();
+}
 
-  // render beauty
-  unsigned int nSamples = 0;
-  for (unsigned int samples = 0; true; samples++) {
-    // exit rendering if elapsed time is bigger than limit time
-    const auto elapsedTime =
-        std::chrono::duration_cast<std::chrono::milliseconds>(
-            std::chrono::steady_clock::now() - startTime)
-            .count();
-    if (elapsedTime >= limitTime) {
-      break;
-    }
+void Renderer::beginProgressive(const Scene& scene) {
+  renderFirstHitAOV(scene);
+  TraversalStats::reset();
 
-    nSamples++;
-#pragma omp parallel for schedule(dynamic, 1) collapse(2)
-    for (unsigned int j = 0; j < height; ++j) {
-      for (unsigned int i = 0; i < width; ++i) {
-        const std::unique_ptr<Sampler>& sampler = samplers[i + width * j];
+  film.setConvergenceCriterion(convergence);
+  film.clear();
+  completedPasses = 0;
+}
 
-        // compute (u, v) with SSAA
-        // NOTE: adding "-"" to flip uv
-        Vec2 uv;
-        uv[0] = -(2.0f * (i + sampler->getNext1D()) - width) / height;
-        uv[1] = -(height - 2.0f * (j + sampler->getNext1D())) / height;
+void Renderer::renderProgressive(const Scene& scene,
+                                 const PassCallback& onPass,
+                                 const CancellationToken& token,
+                                 uint64_t sampleBudget) {
+  spdlog::info("[Renderer] progressive rendering started...");
+  const auto startTime = std::chrono::steady_clock::now();
 
-        // generate camera ray
-        Ray ray;
-        Vec3 wi;
-        float pdf;
-        if (camera->sampleRay(uv, *sampler, ray, wi, pdf)) {
-          // evaluate We
-          const Vec3 We = camera->We(uv, wi);
-
-          // evaluate cos
-          const float cos = std::max(dot(wi, camera->getCameraForward()), 0.0f);
-
-          // integrate light transport equation
-          const Vec3 radiance =
-              We * integrator->integrate(ray, scene, *sampler) * cos / pdf;
-          if (radiance.isNan()) {
-            spdlog::error("[Renderer] radiance has NaN");
-            continue;
-            // std::exit(EXIT_FAILURE);
+  // setup samplers of each thread
+  // NOTE: samplers are reseeded for pixels of each packet tile and each pass,
+  // as fixed sample rendering
+  const std::vector<std::unique_ptr<Sampler>> threadSamplers =
+      cloneSamplers(RayPacket::SIZE * TileScheduler::maxThreads());
+
+  // number of passes finished by each tile
+  // NOTE: written only by thread rendering the tile, under progressMutex
+  const std::vector<Tile>& tiles = scheduler.getTiles();
+  std::vector<unsigned int> tilePasses(tiles.size(), 0);
+  // number of tiles which finished pass completedPasses + 1
+  std::size_t nTilesReached = 0;
+  std::mutex progressMutex;
+
+  // NOTE: passes may complete at the same time on different threads, so
+  // that callback is serialized and stale pass is skipped
+  unsigned int lastNotifiedPass = 0;
+  std::mutex callbackMutex;
+
+  std::atomic<uint64_t> nSamples{0};
+  std::atomic<unsigned int> nConverged{0};
+  std::atomic<uint64_t> nAllocations{0};
+  scheduler.parallelRepeat(
+      [&](std::size_t tileIdx, int thread) {
+        const Tile& tile = tiles[tileIdx];
+        const unsigned int nPasses = tilePasses[tileIdx] + 1;
+
+        // add one sample to each pixel of the tile which is not converged
+        unsigned int nTileSamples = 0;
+        unsigned int nTileConverged = 0;
+        countAllocations(nAllocations, [&] {
+          const auto samplers =
+              threadSamplers.begin() + RayPacket::SIZE * thread;
+
+          forEachPacketTile(tile, [&](unsigned int tileX, unsigned int tileY) {
+            // seed of sampler is distinct for each pixel and pass
+            Sampler* samplerPtrs[RayPacket::SIZE] = {};
+            uint32_t sampledMask = 0;
+            for (int k = 0; k < RayPacket::SIZE; ++k) {
+              unsigned int i, j;
+              if (!tilePixel(tileX, tileY, k, i, j)) continue;
+              if (film.isConverged(i, j)) continue;
+              samplers[k]->setSeed(passSeed(i + width * j, nPasses - 1));
+              samplerPtrs[k] = samplers[k].get();
+              sampledMask |= 1u << k;
+            }
+            if (sampledMask == 0) return;
+
+            Vec3 radiance[RayPacket::SIZE];
+            const uint32_t mask =
+                integrateTile(scene, tileX, tileY, samplerPtrs, radiance);
+
+            // NOTE: sample without radiance(e.g. camera ray is not
+            // generated) is counted as black, as fixed sample rendering
+            for (uint32_t bits = sampledMask; bits > 0; bits &= bits - 1) {
+              const int k = std::countr_zero(bits);
+              unsigned int i, j;
+              tilePixel(tileX, tileY, k, i, j);
+              if (film.addSample(i, j,
+                                 (mask >> k) & 1 ? radiance[k] : Vec3(0))) {
+                nTileConverged++;
+              }
+            }
+            nTileSamples += std::popcount(sampledMask);
+          });
+        });
+
+        film.publish(tileIdx);
+
+        // finish when sample budget is spent or all pixels are converged
+        nSamples += nTileSamples;
+        if (sampleBudget > 0 && nSamples >= sampleBudget) {
+          token.cancel();
+        }
+        if (nTileConverged > 0 &&
+            (nConverged += nTileConverged) == width * height) {
+          token.cancel();
+        }
+
+        // pass is completed when all tiles have finished it
+        unsigned int passCompleted = 0;
+        {
+          std::lock_guard<std::mutex> lock(progressMutex);
+          tilePasses[tileIdx] = nPasses;
+          if (nPasses == completedPasses + 1) {
+            nTilesReached++;
           }
+          while (nTilesReached == tiles.size()) {
+            passCompleted = ++completedPasses;
+            nTilesReached = std::count_if(
+                tilePasses.begin(), tilePasses.end(),
+                [&](unsigned int n) { return n > passCompleted; });
+          }
+        }
 
-          // accumulate radiance
-          aov.beauty.addPixel(i, j, radiance);
+        if (passCompleted > 0 && onPass) {
+          std::lock_guard<std::mutex> lock(callbackMutex);
+          if (passCompleted > lastNotifiedPass) {
+            lastNotifiedPass = passCompleted;
+            onPass(passCompleted);
+          }
         }
-      }
-    }
-  }
-  aov.beauty /= Vec3(nSamples);
+      },
+      token);
 
   const auto elapsedTime =
       std::chrono::duration_cast<std::chrono::milliseconds>(
           std::chrono::steady_clock::now() - startTime)
           .count();
   spdlog::info("[Renderer] rendering finished in {0} ms", elapsedTime);
-  spdlog::info("[Renderer] samples: {0}", nSamples);
+  spdlog::info("[Renderer] samples: {0} passes, {1:.2f} per pixel",
+               completedPasses.load(),
+               double(nSamples) / (width * height));
+  if (convergence.threshold > 0) {
+    spdlog::info("[Renderer] converged pixels: {0} / {1}", nConverged.load(),
+                 width * height);
+  }
+  renderAllocations = nAllocations.load();
+  checkAllocations(nAllocations, completedPasses);
+  aov.sampleCount = film.sampleCounts();
+
+  if constexpr (TraversalStats::ENABLED) {
+    TraversalStats::log(TraversalStats::collect());
+  }
+}
+
+void Renderer::start(const Scene& scene, const PassCallback& onPass,
+                     const CancellationToken& token) {
+  stop();
+
+  beginProgressive(scene);
+  renderToken = token;
+  rendering = true;
+  renderThread = std::thread([this, &scene, onPass, token] {
+    renderProgressive(scene, onPass, token, 0);
+    rendering = false;
+  });
+}
+
+void Renderer::stop() {
+  renderToken.cancel();
+  if (renderThread.joinable()) {
+    renderThread.join();
+  }
+}
+
+void Renderer::setAdaptiveSampling(const ConvergenceCriterion& criterion) {
+  convergence = criterion;
+}
+
+bool Renderer::isRendering() const { return rendering; }
+
+unsigned int Renderer::getCompletedPasses() const { return completedPasses; }
+
+uint64_t Renderer::getRenderAllocations() const { return renderAllocations; }
+
+const AOV& Renderer::getAOV() const { return aov; }
+
+Image<Vec3> Renderer::snapshot() const { return film.snapshot(); }
+
+void Renderer::writeSnapshotPPM(const std::filesystem::path& filepath) const {
+  Image<Vec3> image = snapshot();
+  gammaCorrection(image);
+  ImageWriter::writeImage(image, filepath);
 }
 
 void Renderer::writePPM(const std::filesystem::path& filepath,
@@ -249,6 +570,19 @@ void Renderer::writePPM(const std::filesystem::path& filepath,
       ImageWriter::writeImage(aov.baseColor, filepath);
       break;
     }
+    case AOVType::TRAVERSAL_COST: {
+      if constexpr (!TraversalStats::ENABLED) {
+        spdlog::warn(
+            "[Renderer] traversal cost is not measured, define "
+            "LTRE_TRAVERSAL_STATS to measure it");
+      }
+      ImageWriter::writeImage(heatmap(aov.traversalCost), filepath);
+      break;
+    }
+    case AOVType::SAMPLE_COUNT: {
+      ImageWriter::writeImage(heatmap(aov.sampleCount), filepath);
+      break;
+    }
   }
 }
 
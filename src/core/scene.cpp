@@ -1,35 +1,99 @@
 #include "LTRE/core/scene.hpp"
 
+#include <bit>
+
+#include "LTRE/intersector/bvh.hpp"
+#include "LTRE/intersector/qbvh.hpp"
+#include "LTRE/intersector/traversal-stats.hpp"
+#include "LTRE/shape/instance.hpp"
+
 namespace LTRE {
 
-Scene::Scene() {}
+Scene::Scene() : flatten(false) {}
 
 Scene::Scene(const std::shared_ptr<Intersector<Primitive>>& intersector,
-             const std::shared_ptr<Light>& sky)
-    : intersector(intersector), sky(sky) {}
+             const std::shared_ptr<Light>& sky, bool flatten)
+    : Scene(intersector, sky,
+            flatten ? std::make_shared<
+                          QBVH<SceneTriangle, BVHSplitStrategy::SAH>>()
+                    : nullptr) {}
+
+Scene::Scene(
+    const std::shared_ptr<Intersector<Primitive>>& intersector,
+    const std::shared_ptr<Light>& sky,
+    const std::shared_ptr<Intersector<SceneTriangle>>& triangleIntersector)
+    : intersector(intersector),
+      sky(sky),
+      flatten(triangleIntersector != nullptr),
+      triangleIntersector(triangleIntersector) {}
 
 void Scene::addPrimitive(const Primitive& primitive) {
-  intersector->addPrimitive(primitive);
+  // NOTE: mesh builds its own tree only when it's not flattened
+  const auto mesh = std::dynamic_pointer_cast<Mesh>(primitive.getShapePtr());
+  if (flatten && mesh) {
+    meshPrimitives.push_back(primitive);
+  } else {
+    if (mesh) mesh->buildIntersector();
+    intersector->addPrimitive(primitive);
+  }
 }
 
 void Scene::addModel(const Model& model) {
-  // for each meshes
+  // create Material of each mesh, shared by all instances of the mesh
+  std::vector<std::shared_ptr<Material>> materials;
   for (unsigned int i = 0; i < model.meshes.size(); ++i) {
+    materials.push_back(model.createMaterial(i));
+  }
+
+  // for each instances
+  for (const Model::MeshInstance& instance : model.instances) {
     // create Primitive
-    const std::shared_ptr<Mesh> shape = model.meshes[i];
-    const auto material = model.createMaterial(i);
-    const auto areaLight = model.createAreaLight(i);
-    const Primitive prim = Primitive(shape, material, areaLight);
+    // NOTE: mesh without transform is added as it is, so that rays are not
+    // transformed
+    const unsigned int idx = instance.meshIdx;
+    std::shared_ptr<Shape> shape = model.meshes[idx];
+    if (!instance.transform.isIdentity()) {
+      // NOTE: instanced mesh is traversed through tree of its own
+      model.meshes[idx]->buildIntersector();
+      shape = std::make_shared<Instance>(shape, instance.transform);
+    }
+    const auto areaLight = model.createAreaLight(idx, shape);
+    const Primitive prim = Primitive(shape, materials[idx], areaLight);
 
     // add Primitive to intersector
-    intersector->addPrimitive(prim);
+    addPrimitive(prim);
   }
 }
 
 void Scene::build() {
+  // put triangles of meshes in one BVH
+  AABB sceneAABB;
+  if (flatten) {
+    for (uint32_t primID = 0; primID < meshPrimitives.size(); ++primID) {
+      const auto mesh =
+          std::static_pointer_cast<Mesh>(meshPrimitives[primID].getShapePtr());
+      for (unsigned int f = 0; f < mesh->nFaces(); ++f) {
+        triangleIntersector->addPrimitive(
+            SceneTriangle(mesh->getTriangle(f), primID));
+      }
+    }
+    spdlog::info("[Scene] flattened {0} meshes into {1} triangles",
+                 meshPrimitives.size(),
+                 triangleIntersector->getPrimitivesRef().size());
+
+    if (!triangleIntersector->build()) {
+      spdlog::warn("[Scene] falling back to BVH of triangles");
+      triangleIntersector =
+          std::make_shared<BVH<SceneTriangle, BVHSplitStrategy::SAH>>(
+              triangleIntersector->getPrimitivesRef());
+      triangleIntersector->build();
+    }
+    sceneAABB = triangleIntersector->aabb();
+  }
+
   // build intersector
   intersector->build();
-  const AABB sceneAABB = intersector->aabb();
+  sceneAABB = mergeAABB(sceneAABB, intersector->aabb());
   spdlog::info("[Scene] scene bounds: ({0}, {1}, {2}), ({3}, {4}, {5})",
                sceneAABB.bounds[0][0], sceneAABB.bounds[0][1],
                sceneAABB.bounds[0][2], sceneAABB.bounds[1][0],
@@ -37,13 +101,19 @@ void Scene::build() {
 
   // initialize lights
   // NOTE: only add lights which has power greater than 0
-  for (const auto& prim : intersector->getPrimitivesRef()) {
+  const auto addAreaLight = [&](const Primitive& prim) {
     if (prim.hasArealight()) {
       const auto light = prim.getAreaLightPtr();
       if (light->power() > Vec3(0)) {
         lights.push_back(light);
       }
     }
+  };
+  for (const auto& prim : meshPrimitives) {
+    addAreaLight(prim);
+  }
+  for (const auto& prim : intersector->getPrimitivesRef()) {
+    addAreaLight(prim);
   }
   // add sky to lights
   if (sky->power() > Vec3(0)) {
@@ -52,14 +122,58 @@ void Scene::build() {
   spdlog::info("[Scene] number of lights: {}", lights.size());
 }
 
+void Scene::refit() {
+  if (flatten) triangleIntersector->refit();
+  intersector->refit();
+}
+
+// NOTE: hit shortens ray.tmax, so that intersector only reports hits closer
+// than triangles of flattened meshes
+// NOTE: queries of triangleIntersector and intersector are counted as one
+// query of scene
 bool Scene::intersect(const Ray& ray, IntersectInfo& info) const {
-  return intersector->intersect(ray, info);
+  TraversalStats::Scope scope(TraversalQuery::CLOSEST);
+  bool hit = false;
+  if (flatten && triangleIntersector->intersect(ray, info)) {
+    info.hitPrimitive = &meshPrimitives[info.primID];
+    hit = true;
+  }
+  if (intersector->intersect(ray, info)) hit = true;
+  if (!hit) return false;
+
+  // compute surface info only once for the closest hit
+  info.surfaceInfo = info.hitPrimitive->computeSurfaceInfo(ray, info);
+  return true;
 }
 
 bool Scene::intersectP(const Ray& ray) const {
+  TraversalStats::Scope scope(TraversalQuery::OCCLUSION);
+  if (flatten && triangleIntersector->intersectP(ray)) return true;
   return intersector->intersectP(ray);
 }
 
+uint32_t Scene::intersectPacket(const RayPacket& packet, uint32_t activeMask,
+                                IntersectInfo info[RayPacket::SIZE]) const {
+  TraversalStats::Scope scope(TraversalQuery::PACKET);
+  uint32_t hitMask = 0;
+  if (flatten) {
+    hitMask = triangleIntersector->intersectPacket(packet, activeMask, info);
+    for (uint32_t bits = hitMask; bits > 0; bits &= bits - 1) {
+      const int r = std::countr_zero(bits);
+      info[r].hitPrimitive = &meshPrimitives[info[r].primID];
+    }
+  }
+  hitMask |= intersector->intersectPacket(packet, activeMask, info);
+
+  // compute surface info only once for the closest hit of each ray
+  for (uint32_t bits = hitMask; bits > 0; bits &= bits - 1) {
+    const int r = std::countr_zero(bits);
+    info[r].surfaceInfo =
+        info[r].hitPrimitive->computeSurfaceInfo(packet.rays[r], info[r]);
+  }
+  return hitMask;
+}
+
 Vec3 Scene::getSkyRadiance(const Ray& ray) const {
   // TODO: more nice way?
   SurfaceInfo dummy;
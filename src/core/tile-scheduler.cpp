@@ -0,0 +1,156 @@
+#include "LTRE/core/tile-scheduler.hpp"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+
+namespace LTRE {
+
+// index of (x, y) along Morton curve
+static uint64_t mortonIndex(uint32_t x, uint32_t y) {
+  uint64_t ret = 0;
+  for (int i = 0; i < 32; ++i) {
+    ret |= static_cast<uint64_t>((x >> i) & 1) << (2 * i);
+    ret |= static_cast<uint64_t>((y >> i) & 1) << (2 * i + 1);
+  }
+  return ret;
+}
+
+// index of (x, y) along Hilbert curve which fills n x n grid(n is power of 2)
+// https://en.wikipedia.org/wiki/Hilbert_curve
+static uint64_t hilbertIndex(uint32_t n, uint32_t x, uint32_t y) {
+  uint64_t ret = 0;
+  for (uint32_t s = n / 2; s > 0; s /= 2) {
+    const uint32_t rx = (x & s) > 0;
+    const uint32_t ry = (y & s) > 0;
+    ret += static_cast<uint64_t>(s) * s * ((3 * rx) ^ ry);
+    // rotate quadrant, so that the curve is continuous
+    if (ry == 0) {
+      if (rx == 1) {
+        x = n - 1 - x;
+        y = n - 1 - y;
+      }
+      std::swap(x, y);
+    }
+  }
+  return ret;
+}
+
+TileScheduler::TileScheduler(unsigned int width, unsigned int height,
+                             unsigned int tileSize, TileOrder order) {
+  const unsigned int nTilesX = (width + tileSize - 1) / tileSize;
+  const unsigned int nTilesY = (height + tileSize - 1) / tileSize;
+  const uint32_t n = std::bit_ceil(std::max(nTilesX, nTilesY));
+
+  std::vector<std::pair<uint64_t, Tile>> keyedTiles;
+  for (unsigned int ty = 0; ty < nTilesY; ++ty) {
+    for (unsigned int tx = 0; tx < nTilesX; ++tx) {
+      uint64_t key = 0;
+      switch (order) {
+        case TileOrder::SCANLINE: {
+          key = tx + nTilesX * ty;
+          break;
+        }
+        case TileOrder::MORTON: {
+          key = mortonIndex(tx, ty);
+          break;
+        }
+        case TileOrder::HILBERT: {
+          key = hilbertIndex(n, tx, ty);
+          break;
+        }
+      }
+      const Tile tile{tileSize * tx, tileSize * ty,
+                      std::min(tileSize * (tx + 1), width),
+                      std::min(tileSize * (ty + 1), height)};
+      keyedTiles.emplace_back(key, tile);
+    }
+  }
+  std::sort(keyedTiles.begin(), keyedTiles.end(),
+            [](const auto& t1, const auto& t2) { return t1.first < t2.first; });
+
+  for (const auto& [key, tile] : keyedTiles) {
+    tiles.push_back(tile);
+  }
+}
+
+const std::vector<Tile>& TileScheduler::getTiles() const { return tiles; }
+
+int TileScheduler::maxThreads() { return omp_get_max_threads(); }
+
+void TileScheduler::distributeTiles(int n) {
+  if (nRanges != n) {
+    nRanges = n;
+    ranges = std::make_unique<WorkRange[]>(nRanges);
+  }
+  for (int i = 0; i < nRanges; ++i) {
+    WorkRange& range = ranges[i];
+    range.first = range.begin = tiles.size() * i / nRanges;
+    range.last = range.end = tiles.size() * (i + 1) / nRanges;
+    range.pending = range.last - range.first;
+    range.pass = 0;
+  }
+}
+
+bool TileScheduler::popTile(int id, uint32_t& tileIdx) {
+  WorkRange& range = ranges[id];
+  std::lock_guard<std::mutex> lock(range.mutex);
+  if (range.begin == range.end) return false;
+  tileIdx = range.begin++;
+  return true;
+}
+
+bool TileScheduler::stealTiles(int id, uint32_t& tileIdx) {
+  for (int k = 1; k < nRanges; ++k) {
+    WorkRange& victim = ranges[(id + k) % nRanges];
+    uint32_t begin, end;
+    {
+      std::lock_guard<std::mutex> lock(victim.mutex);
+      const uint32_t nLeft = victim.end - victim.begin;
+      if (nLeft == 0) continue;
+      begin = victim.end - (nLeft + 1) / 2;
+      end = victim.end;
+      victim.end = begin;
+    }
+
+    WorkRange& own = ranges[id];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    own.begin = begin + 1;
+    own.end = end;
+    tileIdx = begin;
+    return true;
+  }
+  return false;
+}
+
+bool TileScheduler::refillTiles(int id, uint32_t& tileIdx) {
+  WorkRange& own = ranges[id];
+  const uint32_t pass = own.pass;
+  for (int k = 0; k < nRanges; ++k) {
+    if (ranges[k].pass < pass) return false;
+  }
+
+  std::lock_guard<std::mutex> lock(own.mutex);
+  if (own.pending > 0) return false;
+  own.pass = pass + 1;
+  // NOTE: empty run only advances pass, so that it doesn't hold back others
+  if (own.first == own.last) return false;
+  own.begin = own.first + 1;
+  own.end = own.last;
+  own.pending = own.last - own.first;
+  tileIdx = own.first;
+  return true;
+}
+
+void TileScheduler::finishTile(uint32_t tileIdx) {
+  // NOTE: run i starts at floor(tiles.size() * i / nRanges), see
+  // distributeTiles
+  const int i = (uint64_t(tileIdx + 1) * nRanges - 1) / tiles.size();
+  WorkRange& range = ranges[i];
+  std::lock_guard<std::mutex> lock(range.mutex);
+  range.pending--;
+}
+
+}  // namespace LTRE
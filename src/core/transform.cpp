@@ -0,0 +1,160 @@
+#include "LTRE/core/transform.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+#include "spdlog/spdlog.h"
+
+namespace LTRE {
+
+Transform::Transform(const float m[3][4], const float mInv[3][4]) {
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      this->m[i][j] = m[i][j];
+      this->mInv[i][j] = mInv[i][j];
+    }
+  }
+}
+
+Transform::Transform() {
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      m[i][j] = mInv[i][j] = i == j ? 1.0f : 0.0f;
+    }
+  }
+}
+
+Transform::Transform(const float m[3][4]) {
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      this->m[i][j] = m[i][j];
+    }
+  }
+
+  const float det = determinant();
+  if (det == 0) {
+    spdlog::error("[Transform] singular matrix detected.");
+    std::exit(EXIT_FAILURE);
+  }
+
+  // inverse of linear part by cofactors
+  const float invDet = 1.0f / det;
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      const int i1 = (j + 1) % 3, i2 = (j + 2) % 3;
+      const int j1 = (i + 1) % 3, j2 = (i + 2) % 3;
+      mInv[i][j] = invDet * (m[i1][j1] * m[i2][j2] - m[i1][j2] * m[i2][j1]);
+    }
+  }
+
+  // inverse of translation
+  for (int i = 0; i < 3; ++i) {
+    mInv[i][3] = -(mInv[i][0] * m[0][3] + mInv[i][1] * m[1][3] +
+                   mInv[i][2] * m[2][3]);
+  }
+}
+
+bool Transform::isIdentity() const {
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      if (m[i][j] != (i == j ? 1.0f : 0.0f)) return false;
+    }
+  }
+  return true;
+}
+
+float Transform::determinant() const {
+  return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+         m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+         m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+}
+
+Transform Transform::inverse() const { return Transform(mInv, m); }
+
+Transform Transform::operator*(const Transform& t) const {
+  // compose 3x4 matrices as 4x4 matrices whose last row is (0, 0, 0, 1)
+  const auto compose = [](const float a[3][4], const float b[3][4],
+                          float ret[3][4]) {
+    for (int i = 0; i < 3; ++i) {
+      for (int j = 0; j < 4; ++j) {
+        ret[i][j] = a[i][0] * b[0][j] + a[i][1] * b[1][j] + a[i][2] * b[2][j];
+      }
+      ret[i][3] += a[i][3];
+    }
+  };
+
+  float retM[3][4], retMInv[3][4];
+  compose(m, t.m, retM);
+  compose(t.mInv, mInv, retMInv);
+  return Transform(retM, retMInv);
+}
+
+Vec3 Transform::applyPoint(const Vec3& p) const {
+  Vec3 ret;
+  for (int i = 0; i < 3; ++i) {
+    ret[i] = m[i][0] * p[0] + m[i][1] * p[1] + m[i][2] * p[2] + m[i][3];
+  }
+  return ret;
+}
+
+Vec3 Transform::applyVector(const Vec3& v) const {
+  Vec3 ret;
+  for (int i = 0; i < 3; ++i) {
+    ret[i] = m[i][0] * v[0] + m[i][1] * v[1] + m[i][2] * v[2];
+  }
+  return ret;
+}
+
+Vec3 Transform::applyNormal(const Vec3& n) const {
+  Vec3 ret;
+  for (int i = 0; i < 3; ++i) {
+    ret[i] = mInv[0][i] * n[0] + mInv[1][i] * n[1] + mInv[2][i] * n[2];
+  }
+  return ret;
+}
+
+AABB Transform::applyAABB(const AABB& bbox) const {
+  if (bbox.isEmpty()) return AABB();
+
+  // accumulate contribution of each axis separately(Arvo, Graphics Gems)
+  Vec3 pMin, pMax;
+  for (int i = 0; i < 3; ++i) {
+    pMin[i] = pMax[i] = m[i][3];
+    for (int j = 0; j < 3; ++j) {
+      const float a = m[i][j] * bbox.bounds[0][j];
+      const float b = m[i][j] * bbox.bounds[1][j];
+      pMin[i] += std::min(a, b);
+      pMax[i] += std::max(a, b);
+    }
+  }
+  return AABB(pMin, pMax);
+}
+
+Transform translate(const Vec3& t) {
+  const float m[3][4] = {
+      {1, 0, 0, t[0]}, {0, 1, 0, t[1]}, {0, 0, 1, t[2]}};
+  return Transform(m);
+}
+
+Transform scale(const Vec3& s) {
+  const float m[3][4] = {{s[0], 0, 0, 0}, {0, s[1], 0, 0}, {0, 0, s[2], 0}};
+  return Transform(m);
+}
+
+Transform rotate(float angle, const Vec3& axis) {
+  // Rodrigues' rotation formula
+  const Vec3 a = normalize(axis);
+  const float c = std::cos(angle);
+  const float s = std::sin(angle);
+  const float m[3][4] = {
+      {c + a[0] * a[0] * (1 - c), a[0] * a[1] * (1 - c) - a[2] * s,
+       a[0] * a[2] * (1 - c) + a[1] * s, 0},
+      {a[1] * a[0] * (1 - c) + a[2] * s, c + a[1] * a[1] * (1 - c),
+       a[1] * a[2] * (1 - c) - a[0] * s, 0},
+      {a[2] * a[0] * (1 - c) - a[1] * s, a[2] * a[1] * (1 - c) + a[0] * s,
+       c + a[2] * a[2] * (1 - c), 0}};
+  return Transform(m);
+}
+
+}  // namespace LTRE
@@ -0,0 +1,358 @@
+#include "LTRE/core/wavefront-renderer.hpp"
+
+#include <omp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <numeric>
+#include <typeinfo>
+
+#include "spdlog/spdlog.h"
+//
+#include "LTRE/core/io.hpp"
+
+namespace LTRE {
+
+// slot which has no path yet
+static constexpr uint32_t NO_PIXEL = std::numeric_limits<uint32_t>::max();
+
+// append slot to list, safe to call in parallel loop
+static void append(std::vector<uint32_t>& list, uint32_t& size,
+                   uint32_t slot) {
+  uint32_t idx;
+#pragma omp atomic capture
+  idx = size++;
+  list[idx] = slot;
+}
+
+// sort list[0, size) in parallel, sorted runs of each thread are merged
+// pairwise through scratch
+// NOTE: scratch must be as large as list, so that sorting doesn't allocate
+template <typename Less>
+static void parallelSort(std::vector<uint32_t>& list, uint32_t size,
+                         std::vector<uint32_t>& scratch, const Less& less) {
+  const int nRuns = std::min<int>(omp_get_max_threads(), size / 1024 + 1);
+  const auto runBegin = [&](int run) {
+    return static_cast<uint32_t>(uint64_t(size) * std::min(run, nRuns) /
+                                 nRuns);
+  };
+
+#pragma omp parallel for schedule(static)
+  for (int run = 0; run < nRuns; ++run) {
+    std::sort(list.begin() + runBegin(run), list.begin() + runBegin(run + 1),
+              less);
+  }
+
+  uint32_t* src = list.data();
+  uint32_t* dst = scratch.data();
+  for (int width = 1; width < nRuns; width *= 2) {
+#pragma omp parallel for schedule(static)
+    for (int run = 0; run < nRuns; run += 2 * width) {
+      const uint32_t begin = runBegin(run);
+      const uint32_t middle = runBegin(run + width);
+      const uint32_t end = runBegin(run + 2 * width);
+      std::merge(src + begin, src + middle, src + middle, src + end,
+                 dst + begin, less);
+    }
+    std::swap(src, dst);
+  }
+  if (src != list.data()) std::copy(src, src + size, list.data());
+}
+
+// return false if path is terminated
+static bool russianRoulette(Sampler& sampler, Vec3& throughput) {
+  const float russianRouletteProb = std::min(
+      std::max(throughput[0], std::max(throughput[1], throughput[2])), 1.0f);
+  if (sampler.getNext1D() > russianRouletteProb) return false;
+  throughput /= russianRouletteProb;
+  return true;
+}
+
+void PathQueue::resize(std::size_t size) {
+  pixel.resize(size);
+  cameraWeight.resize(size);
+  ray.resize(size);
+  throughput.resize(size);
+  radiance.resize(size);
+  depth.resize(size);
+  info.resize(size);
+  hit.resize(size);
+}
+
+void ShadowQueue::resize(std::size_t size) {
+  path.resize(size);
+  ray.resize(size);
+  contribution.resize(size);
+}
+
+WavefrontRenderer::WavefrontRenderer(unsigned int width, unsigned int height,
+                                     const std::shared_ptr<Camera>& camera,
+                                     const std::shared_ptr<Sampler>& sampler,
+                                     int maxDepth, unsigned int queueSize)
+    : width(width),
+      height(height),
+      camera{camera},
+      sampler{sampler},
+      maxDepth(maxDepth),
+      queueSize(queueSize),
+      beauty{width, height},
+      nActive(0),
+      nNext(0),
+      nFree(0),
+      nShadowRays(0) {}
+
+void WavefrontRenderer::regenerate(uint32_t& nextPixel) {
+  // accumulate radiance of finished paths
+  // NOTE: paths in flight belong to distinct pixels
+#pragma omp parallel for schedule(static)
+  for (uint32_t k = 0; k < nFree; ++k) {
+    const uint32_t slot = freeSlots[k];
+    const uint32_t pixel = paths.pixel[slot];
+    if (pixel == NO_PIXEL) continue;
+
+    const Vec3 radiance = paths.cameraWeight[slot] * paths.radiance[slot];
+    if (radiance.isNan()) {
+      spdlog::error("[WavefrontRenderer] radiance has NaN");
+      continue;
+    }
+    beauty.addPixel(pixel % width, pixel / width, radiance);
+  }
+
+  // start camera paths in free slots
+  // NOTE: paths terminated before their first hit are returned to free list
+  const uint32_t nStart = std::min(nFree, width * height - nextPixel);
+  nNext = 0;
+#pragma omp parallel for schedule(static)
+  for (uint32_t k = 0; k < nStart; ++k) {
+    const uint32_t slot = freeSlots[k];
+    const uint32_t pixel = nextPixel + k;
+    const unsigned int i = pixel % width;
+    const unsigned int j = pixel / width;
+    Sampler& sampler = *samplers[pixel];
+
+    paths.pixel[slot] = pixel;
+    paths.throughput[slot] = Vec3(1);
+    paths.radiance[slot] = Vec3(0);
+    paths.depth[slot] = 0;
+
+    // compute (u, v) with SSAA
+    // NOTE: adding "-"" to flip uv
+    Vec2 uv;
+    uv[0] = -(2.0f * (i + sampler.getNext1D()) - width) / height;
+    uv[1] = -(height - 2.0f * (j + sampler.getNext1D())) / height;
+
+    // generate camera ray
+    Vec3 wi;
+    float pdf;
+    if (!camera->sampleRay(uv, sampler, paths.ray[slot], wi, pdf) ||
+        !russianRoulette(sampler, paths.throughput[slot])) {
+      paths.cameraWeight[slot] = Vec3(0);
+      append(nextPaths, nNext, slot);
+      continue;
+    }
+
+    // evaluate We and cos
+    const Vec3 We = camera->We(uv, wi);
+    const float cos = std::max(dot(wi, camera->getCameraForward()), 0.0f);
+    paths.cameraWeight[slot] = We * cos / pdf;
+
+    append(activePaths, nActive, slot);
+  }
+  nextPixel += nStart;
+
+  std::swap(freeSlots, nextPaths);
+  nFree = nNext;
+}
+
+void WavefrontRenderer::extend(const Scene& scene) {
+#pragma omp parallel for schedule(dynamic, 256)
+  for (uint32_t k = 0; k < nActive; ++k) {
+    const uint32_t slot = activePaths[k];
+    paths.hit[slot] = scene.intersect(paths.ray[slot], paths.info[slot]);
+  }
+}
+
+void WavefrontRenderer::shade(const Scene& scene) {
+  // sort paths by material type, then by material
+  // NOTE: missed paths come first
+#pragma omp parallel for schedule(static)
+  for (uint32_t k = 0; k < nActive; ++k) {
+    const uint32_t slot = activePaths[k];
+    if (paths.hit[slot]) {
+      const Material* material = paths.info[slot].hitPrimitive->getMaterial();
+      materialKeys[slot] = {typeid(*material).hash_code(), material};
+    } else {
+      materialKeys[slot] = {0, nullptr};
+    }
+  }
+  parallelSort(activePaths, nActive, sortScratch,
+               [&](uint32_t slot1, uint32_t slot2) {
+                 return materialKeys[slot1] < materialKeys[slot2];
+               });
+
+  nNext = 0;
+  nShadowRays = 0;
+#pragma omp parallel for schedule(dynamic, 256)
+  for (uint32_t k = 0; k < nActive; ++k) {
+    const uint32_t slot = activePaths[k];
+    Sampler& sampler = *samplers[paths.pixel[slot]];
+    const Ray& ray = paths.ray[slot];
+    const IntersectInfo& info = paths.info[slot];
+    Vec3& throughput = paths.throughput[slot];
+    Vec3& radiance = paths.radiance[slot];
+    int& depth = paths.depth[slot];
+
+    if (!paths.hit[slot]) {
+      // first hit sky case
+      if (depth == 0) {
+        radiance += throughput * scene.getSkyRadiance(ray);
+      }
+      append(freeSlots, nFree, slot);
+      continue;
+    }
+
+    const Primitive& hitPrimitive = *info.hitPrimitive;
+
+    // first hit area light case
+    if (depth == 0 && hitPrimitive.hasArealight()) {
+      radiance += throughput * hitPrimitive.Le(ray.direction, info.surfaceInfo);
+      append(freeSlots, nFree, slot);
+      continue;
+    }
+
+    // light sampling
+    {
+      // sample light
+      float lightChoosePdf;
+      const std::shared_ptr<Light> light =
+          scene.sampleLight(sampler, lightChoosePdf);
+
+      // sample direction and get Le
+      Vec3 dir;
+      float distToLight;
+      float lightPdf;
+      const Vec3 le = light->sampleDirection(info.surfaceInfo, sampler, dir,
+                                             distToLight, lightPdf);
+
+      // push shadow ray, its visibility is tested in shadow stage
+      uint32_t idx;
+#pragma omp atomic capture
+      idx = nShadowRays++;
+      const Vec3 bsdf =
+          hitPrimitive.evaluateBSDF(-ray.direction, dir, info.surfaceInfo);
+      const float cos = std::max(dot(dir, info.surfaceInfo.normal), 0.0f);
+      shadowRays.path[idx] = slot;
+      shadowRays.ray[idx] = Ray(info.surfaceInfo.position, dir);
+      shadowRays.ray[idx].tmax = distToLight;
+      shadowRays.contribution[idx] =
+          throughput * bsdf * cos * le / (lightChoosePdf * lightPdf);
+    }
+
+    // BRDF Sampling
+    Vec3 wi;
+    float pdf;
+    const Vec3 bsdf = hitPrimitive.sampleBSDF(-ray.direction, info.surfaceInfo,
+                                              sampler, wi, pdf);
+
+    // update throughput
+    const float cos = std::max(dot(wi, info.surfaceInfo.normal), 0.0f);
+    throughput *= bsdf * cos / pdf;
+
+    // update ray
+    paths.ray[slot] = Ray(info.surfaceInfo.position, wi);
+    depth++;
+
+    // russian roulette of next bounce
+    if (depth >= maxDepth || !russianRoulette(sampler, throughput)) {
+      append(freeSlots, nFree, slot);
+      continue;
+    }
+    append(nextPaths, nNext, slot);
+  }
+}
+
+void WavefrontRenderer::shadow(const Scene& scene) {
+  // NOTE: a path has at most one shadow ray
+#pragma omp parallel for schedule(dynamic, 256)
+  for (uint32_t k = 0; k < nShadowRays; ++k) {
+    if (!scene.intersectP(shadowRays.ray[k])) {
+      paths.radiance[shadowRays.path[k]] += shadowRays.contribution[k];
+    }
+  }
+}
+
+void WavefrontRenderer::focus(const Scene& scene) {
+  Ray ray(camera->getCameraPosition(), camera->getCameraForward());
+  IntersectInfo info;
+  if (scene.intersect(ray, info)) {
+    camera->focus(info.surfaceInfo.position);
+  }
+}
+
+void WavefrontRenderer::render(const Scene& scene, unsigned int samples) {
+  spdlog::info("[WavefrontRenderer] samples: " + std::to_string(samples));
+  spdlog::info("[WavefrontRenderer] rendering started...");
+  const auto startTime = std::chrono::steady_clock::now();
+
+  // setup sampler
+  const uint32_t nPixels = width * height;
+  samplers.resize(nPixels);
+  for (unsigned int j = 0; j < height; ++j) {
+    for (unsigned int i = 0; i < width; ++i) {
+      samplers[i + width * j] = this->sampler->clone();
+      samplers[i + width * j]->setSeed(i + width * j);
+    }
+  }
+
+  // setup queues
+  const uint32_t size = std::min(queueSize, nPixels);
+  paths.resize(size);
+  shadowRays.resize(size);
+  activePaths.resize(size);
+  nextPaths.resize(size);
+  freeSlots.resize(size);
+  materialKeys.resize(size);
+  sortScratch.resize(size);
+
+  // render beauty
+  // NOTE: each sample is rendered as one pass over all pixels, so that a
+  // pixel has at most one path in flight
+  beauty = Image<Vec3>(width, height);
+  for (unsigned int sample = 0; sample < samples; ++sample) {
+    std::fill(paths.pixel.begin(), paths.pixel.end(), NO_PIXEL);
+    std::iota(freeSlots.begin(), freeSlots.end(), 0);
+    nFree = size;
+    nActive = 0;
+
+    uint32_t nextPixel = 0;
+    while (true) {
+      regenerate(nextPixel);
+      if (nActive == 0 && nFree == 0) break;
+
+      extend(scene);
+      shade(scene);
+      shadow(scene);
+
+      std::swap(activePaths, nextPaths);
+      nActive = nNext;
+    }
+  }
+  beauty /= Vec3(samples);
+
+  const auto endTime = std::chrono::steady_clock::now();
+  const auto ms =
+      std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime)
+          .count();
+  spdlog::info("[WavefrontRenderer] rendering finished in " +
+               std::to_string(ms) + " ms");
+}
+
+const Image<Vec3>& WavefrontRenderer::getBeauty() const { return beauty; }
+
+void WavefrontRenderer::writePPM(const std::filesystem::path& filepath) {
+  gammaCorrection(beauty);
+  ImageWriter::writeImage(beauty, filepath);
+}
+
+}  // namespace LTRE
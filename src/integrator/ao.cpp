@@ -1,17 +1,13 @@
 #include "LTRE/integrator/ao.hpp"
 
+#include <bit>
+
 namespace LTRE {
 
 AO::AO(float occulusionDistance) : occulusionDistance(occulusionDistance) {}
 
-Vec3 AO::integrate(const Ray& ray_in, const Scene& scene,
-                   Sampler& sampler) const {
-  IntersectInfo info;
-  if (!scene.intersect(ray_in, info)) {
-    // sky
-    return scene.getSkyRadiance(ray_in);
-  }
-
+Vec3 AO::shade(const Ray& ray_in, const IntersectInfo& info,
+               const Scene& scene, Sampler& sampler) const {
   const Primitive& hitPrimitive = *info.hitPrimitive;
 
   // BRDF Sampling
@@ -31,4 +27,33 @@ Vec3 AO::integrate(const Ray& ray_in, const Scene& scene,
   return bsdf * cos / pdf;
 }
 
-}  // namespace LTRE
\ No newline at end of file
+Vec3 AO::integrate(const Ray& ray_in, const Scene& scene,
+                   Sampler& sampler) const {
+  IntersectInfo info;
+  if (!scene.intersect(ray_in, info)) {
+    // sky
+    return scene.getSkyRadiance(ray_in);
+  }
+
+  return shade(ray_in, info, scene, sampler);
+}
+
+void AO::integratePacket(const RayPacket& packet, uint32_t activeMask,
+                         const Scene& scene,
+                         Sampler* const samplers[RayPacket::SIZE],
+                         Vec3 radiance[RayPacket::SIZE]) const {
+  IntersectInfo info[RayPacket::SIZE];
+  const uint32_t hitMask = scene.intersectPacket(packet, activeMask, info);
+
+  for (; activeMask > 0; activeMask &= activeMask - 1) {
+    const int r = std::countr_zero(activeMask);
+    if (hitMask & (1u << r)) {
+      radiance[r] = shade(packet.rays[r], info[r], scene, *samplers[r]);
+    } else {
+      // sky
+      radiance[r] = scene.getSkyRadiance(packet.rays[r]);
+    }
+  }
+}
+
+}  // namespace LTRE
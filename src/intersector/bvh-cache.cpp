@@ -0,0 +1,158 @@
+#include "LTRE/intersector/bvh-cache.hpp"
+
+#include <fstream>
+#include <random>
+#include <system_error>
+
+#include "spdlog/spdlog.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace LTRE {
+
+ContentHash& ContentHash::add(const void* data, std::size_t size) {
+  constexpr uint64_t PRIME = 0x100000001b3;
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+  std::size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, bytes + i, 8);
+    value = (value ^ word) * PRIME;
+  }
+  for (; i < size; ++i) {
+    value = (value ^ bytes[i]) * PRIME;
+  }
+  return *this;
+}
+
+BVHCacheFile::~BVHCacheFile() { close(); }
+
+void BVHCacheFile::close() {
+#ifndef _WIN32
+  if (data != nullptr && buffer.empty()) {
+    munmap(const_cast<char*>(data), size);
+  }
+#endif
+  data = nullptr;
+  size = 0;
+  buffer.clear();
+}
+
+bool BVHCacheFile::open(const std::filesystem::path& filepath,
+                        const char* layout, uint32_t nodeSize, uint64_t key) {
+  close();
+
+#ifndef _WIN32
+  const int fd = ::open(filepath.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+  void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (mapped == MAP_FAILED) return false;
+  data = static_cast<const char*>(mapped);
+  size = st.st_size;
+#else
+  std::ifstream stream(filepath, std::ios::binary | std::ios::ate);
+  if (!stream) return false;
+  buffer.resize(stream.tellg());
+  stream.seekg(0);
+  if (buffer.empty() || !stream.read(buffer.data(), buffer.size())) {
+    buffer.clear();
+    return false;
+  }
+  data = buffer.data();
+  size = buffer.size();
+#endif
+
+  // validate header
+  // NOTE: counts are bounded by size of file before sizes of arrays are
+  // computed, so that corrupt counts can't wrap them around
+  const BVHCacheHeader& h = header();
+  const auto arraysFit = [&] {
+    const uint64_t arraysSize = size - NODES_OFFSET;
+    if (h.nNodes > arraysSize / h.nodeSize) return false;
+    const uint64_t faceIDsSize = arraysSize - h.nNodes * h.nodeSize;
+    return h.nPrimitives <= faceIDsSize / sizeof(uint32_t) &&
+           faceIDsSize == h.nPrimitives * sizeof(uint32_t);
+  };
+  const bool valid =
+      size >= NODES_OFFSET &&
+      std::strncmp(h.magic, "LTREBVH", sizeof(h.magic)) == 0 &&
+      h.version == BVH_CACHE_VERSION && h.nodeSize == nodeSize &&
+      std::strncmp(h.layout, layout, sizeof(h.layout)) == 0 && h.key == key &&
+      arraysFit();
+  if (!valid) {
+    spdlog::warn("[BVHCacheFile] " + filepath.string() +
+                 " is stale or broken, ignored.");
+    close();
+    return false;
+  }
+
+  return true;
+}
+
+const BVHCacheHeader& BVHCacheFile::header() const {
+  return *reinterpret_cast<const BVHCacheHeader*>(data);
+}
+
+const void* BVHCacheFile::nodes() const { return data + NODES_OFFSET; }
+
+const uint32_t* BVHCacheFile::faceIDs() const {
+  return reinterpret_cast<const uint32_t*>(data + NODES_OFFSET +
+                                           header().nNodes *
+                                               header().nodeSize);
+}
+
+bool BVHCacheFile::write(const std::filesystem::path& filepath,
+                         const BVHCacheHeader& header, const void* nodes,
+                         const std::vector<uint32_t>& faceIDs) {
+  static_assert(sizeof(BVHCacheHeader) <= NODES_OFFSET);
+
+  std::error_code ec;
+  std::filesystem::create_directories(filepath.parent_path(), ec);
+
+  // NOTE: temporary file name is randomized, several processes may write the
+  // same cache at once
+  std::filesystem::path tmpPath = filepath;
+  tmpPath += "." + std::to_string(std::random_device()()) + ".tmp";
+  {
+    std::ofstream stream(tmpPath, std::ios::binary);
+    if (!stream) {
+      spdlog::warn("[BVHCacheFile] failed to write " + tmpPath.string());
+      return false;
+    }
+
+    char headerBytes[NODES_OFFSET] = {};
+    std::memcpy(headerBytes, &header, sizeof(BVHCacheHeader));
+    stream.write(headerBytes, NODES_OFFSET);
+    stream.write(static_cast<const char*>(nodes),
+                 header.nNodes * header.nodeSize);
+    stream.write(reinterpret_cast<const char*>(faceIDs.data()),
+                 faceIDs.size() * sizeof(uint32_t));
+    if (!stream) {
+      spdlog::warn("[BVHCacheFile] failed to write " + tmpPath.string());
+      std::filesystem::remove(tmpPath, ec);
+      return false;
+    }
+  }
+
+  std::filesystem::rename(tmpPath, filepath, ec);
+  if (ec) {
+    spdlog::warn("[BVHCacheFile] failed to write " + filepath.string());
+    std::filesystem::remove(tmpPath, ec);
+    return false;
+  }
+  return true;
+}
+
+}  // namespace LTRE
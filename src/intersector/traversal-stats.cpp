@@ -0,0 +1,107 @@
+#include "LTRE/intersector/traversal-stats.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <mutex>
+#include <string>
+
+#include "spdlog/spdlog.h"
+
+namespace LTRE {
+
+static std::mutex registryMutex;
+
+static int bucket(uint64_t count) { return std::bit_width(count); }
+
+TraversalStats::QueryStats& TraversalStats::QueryStats::operator+=(
+    const QueryStats& stats) {
+  nQueries += stats.nQueries;
+  total += stats.total;
+  for (int i = 0; i < N_BUCKETS; ++i) {
+    nodes[i] += stats.nodes[i];
+    primitives[i] += stats.primitives[i];
+  }
+  return *this;
+}
+
+std::vector<std::unique_ptr<TraversalStats::ThreadState>>&
+TraversalStats::registry() {
+  static std::vector<std::unique_ptr<ThreadState>> states;
+  return states;
+}
+
+TraversalStats::ThreadState* TraversalStats::registerThread() {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  registry().push_back(std::make_unique<ThreadState>());
+  return registry().back().get();
+}
+
+void TraversalStats::recordQuery(ThreadState& s) {
+  QueryStats& stats = s.report.queries[static_cast<int>(s.query)];
+  stats.nQueries++;
+  stats.total += s.current;
+  stats.nodes[std::min(bucket(s.current.nodes), N_BUCKETS - 1)]++;
+  stats.primitives[std::min(bucket(s.current.primitives), N_BUCKETS - 1)]++;
+  s.last = s.current;
+}
+
+TraversalStats::Report TraversalStats::collect() {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  Report report;
+  for (const auto& s : registry()) {
+    for (std::size_t i = 0; i < report.queries.size(); ++i) {
+      report.queries[i] += s->report.queries[i];
+    }
+  }
+  return report;
+}
+
+void TraversalStats::reset() {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  for (const auto& s : registry()) {
+    s->report = Report();
+  }
+}
+
+static std::string histogramString(const TraversalStats::Histogram& histogram) {
+  std::string ret;
+  for (int i = 0; i < TraversalStats::N_BUCKETS; ++i) {
+    if (histogram[i] == 0) continue;
+    const uint64_t lower = i == 0 ? 0 : uint64_t(1) << (i - 1);
+    ret += " [" + std::to_string(lower) + ", " +
+           std::to_string(uint64_t(1) << i) +
+           "): " + std::to_string(histogram[i]);
+  }
+  return ret;
+}
+
+void TraversalStats::log(const Report& report) {
+  if constexpr (!ENABLED) {
+    spdlog::warn(
+        "[TraversalStats] disabled, define LTRE_TRAVERSAL_STATS to count "
+        "traversal");
+    return;
+  }
+
+  constexpr const char* names[] = {"closest", "occlusion", "packet"};
+  for (std::size_t i = 0; i < report.queries.size(); ++i) {
+    const QueryStats& stats = report.queries[i];
+    if (stats.nQueries == 0) continue;
+
+    const double n = stats.nQueries;
+    spdlog::info("[TraversalStats] {0} queries: {1}", names[i],
+                 stats.nQueries);
+    spdlog::info(
+        "[TraversalStats] {0} nodes: {1} ({2:.2f} per query), boxes: {3} "
+        "({4:.2f} per query), primitives: {5} ({6:.2f} per query)",
+        names[i], stats.total.nodes, stats.total.nodes / n, stats.total.boxes,
+        stats.total.boxes / n, stats.total.primitives,
+        stats.total.primitives / n);
+    spdlog::info("[TraversalStats] {0} nodes histogram:{1}", names[i],
+                 histogramString(stats.nodes));
+    spdlog::info("[TraversalStats] {0} primitives histogram:{1}", names[i],
+                 histogramString(stats.primitives));
+  }
+}
+
+}  // namespace LTRE
@@ -0,0 +1,269 @@
+#include "LTRE/intersector/triangle-blocks.hpp"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+namespace LTRE {
+
+namespace {
+
+// thin wrapper of SIMD instructions, so that kernel is written only once
+#ifdef __AVX__
+using FloatLanes = __m256;
+inline FloatLanes set1(float x) { return _mm256_set1_ps(x); }
+inline FloatLanes load(const float* p) { return _mm256_load_ps(p); }
+inline void store(float* p, FloatLanes x) { _mm256_storeu_ps(p, x); }
+inline FloatLanes add(FloatLanes a, FloatLanes b) {
+  return _mm256_add_ps(a, b);
+}
+inline FloatLanes sub(FloatLanes a, FloatLanes b) {
+  return _mm256_sub_ps(a, b);
+}
+inline FloatLanes mul(FloatLanes a, FloatLanes b) {
+  return _mm256_mul_ps(a, b);
+}
+inline FloatLanes div(FloatLanes a, FloatLanes b) {
+  return _mm256_div_ps(a, b);
+}
+inline FloatLanes vand(FloatLanes a, FloatLanes b) {
+  return _mm256_and_ps(a, b);
+}
+inline FloatLanes vor(FloatLanes a, FloatLanes b) { return _mm256_or_ps(a, b); }
+// (!a) & b
+inline FloatLanes vandnot(FloatLanes a, FloatLanes b) {
+  return _mm256_andnot_ps(a, b);
+}
+inline FloatLanes cmpge(FloatLanes a, FloatLanes b) {
+  return _mm256_cmp_ps(a, b, _CMP_GE_OQ);
+}
+inline FloatLanes cmple(FloatLanes a, FloatLanes b) {
+  return _mm256_cmp_ps(a, b, _CMP_LE_OQ);
+}
+inline FloatLanes cmplt(FloatLanes a, FloatLanes b) {
+  return _mm256_cmp_ps(a, b, _CMP_LT_OQ);
+}
+inline FloatLanes cmpgt(FloatLanes a, FloatLanes b) {
+  return _mm256_cmp_ps(a, b, _CMP_GT_OQ);
+}
+inline FloatLanes cmpeq(FloatLanes a, FloatLanes b) {
+  return _mm256_cmp_ps(a, b, _CMP_EQ_OQ);
+}
+inline FloatLanes cmpneq(FloatLanes a, FloatLanes b) {
+  return _mm256_cmp_ps(a, b, _CMP_NEQ_OQ);
+}
+inline FloatLanes blend(FloatLanes a, FloatLanes b, FloatLanes mask) {
+  return _mm256_blendv_ps(a, b, mask);
+}
+inline int movemask(FloatLanes x) { return _mm256_movemask_ps(x); }
+// a * b - c * d computed in double, see diffOfProducts
+inline FloatLanes diffOfProducts(FloatLanes a, FloatLanes b, FloatLanes c,
+                                 FloatLanes d) {
+  const auto half = [&](auto extract) {
+    return _mm256_cvtpd_ps(_mm256_sub_pd(
+        _mm256_mul_pd(_mm256_cvtps_pd(extract(a)),
+                      _mm256_cvtps_pd(extract(b))),
+        _mm256_mul_pd(_mm256_cvtps_pd(extract(c)),
+                      _mm256_cvtps_pd(extract(d)))));
+  };
+  const __m128 lo = half([](__m256 x) { return _mm256_castps256_ps128(x); });
+  const __m128 hi = half([](__m256 x) { return _mm256_extractf128_ps(x, 1); });
+  return _mm256_set_m128(hi, lo);
+}
+#else
+using FloatLanes = __m128;
+inline FloatLanes set1(float x) { return _mm_set1_ps(x); }
+inline FloatLanes load(const float* p) { return _mm_load_ps(p); }
+inline void store(float* p, FloatLanes x) { _mm_storeu_ps(p, x); }
+inline FloatLanes add(FloatLanes a, FloatLanes b) { return _mm_add_ps(a, b); }
+inline FloatLanes sub(FloatLanes a, FloatLanes b) { return _mm_sub_ps(a, b); }
+inline FloatLanes mul(FloatLanes a, FloatLanes b) { return _mm_mul_ps(a, b); }
+inline FloatLanes div(FloatLanes a, FloatLanes b) { return _mm_div_ps(a, b); }
+inline FloatLanes vand(FloatLanes a, FloatLanes b) { return _mm_and_ps(a, b); }
+inline FloatLanes vor(FloatLanes a, FloatLanes b) { return _mm_or_ps(a, b); }
+// (!a) & b
+inline FloatLanes vandnot(FloatLanes a, FloatLanes b) {
+  return _mm_andnot_ps(a, b);
+}
+inline FloatLanes cmpge(FloatLanes a, FloatLanes b) {
+  return _mm_cmpge_ps(a, b);
+}
+inline FloatLanes cmple(FloatLanes a, FloatLanes b) {
+  return _mm_cmple_ps(a, b);
+}
+inline FloatLanes cmplt(FloatLanes a, FloatLanes b) {
+  return _mm_cmplt_ps(a, b);
+}
+inline FloatLanes cmpgt(FloatLanes a, FloatLanes b) {
+  return _mm_cmpgt_ps(a, b);
+}
+inline FloatLanes cmpeq(FloatLanes a, FloatLanes b) {
+  return _mm_cmpeq_ps(a, b);
+}
+// NOTE: false for NaN, as AVX version
+inline FloatLanes cmpneq(FloatLanes a, FloatLanes b) {
+  return _mm_andnot_ps(_mm_cmpeq_ps(a, b), _mm_cmpord_ps(a, b));
+}
+inline FloatLanes blend(FloatLanes a, FloatLanes b, FloatLanes mask) {
+  return _mm_or_ps(_mm_andnot_ps(mask, a), _mm_and_ps(mask, b));
+}
+inline int movemask(FloatLanes x) { return _mm_movemask_ps(x); }
+// a * b - c * d computed in double, see diffOfProducts
+inline FloatLanes diffOfProducts(FloatLanes a, FloatLanes b, FloatLanes c,
+                                 FloatLanes d) {
+  const auto half = [&](auto extract) {
+    return _mm_cvtpd_ps(
+        _mm_sub_pd(_mm_mul_pd(_mm_cvtps_pd(extract(a)),
+                              _mm_cvtps_pd(extract(b))),
+                   _mm_mul_pd(_mm_cvtps_pd(extract(c)),
+                              _mm_cvtps_pd(extract(d)))));
+  };
+  const __m128 lo = half([](__m128 x) { return x; });
+  const __m128 hi = half([](__m128 x) { return _mm_movehl_ps(x, x); });
+  return _mm_movelh_ps(lo, hi);
+}
+#endif
+
+// TriangleRay broadcasted to all lanes
+struct RayLanes {
+  FloatLanes origin[3];  // in permuted order
+  FloatLanes Sx, Sy, Sz;
+  FloatLanes tmin;
+  int kx, ky, kz;
+};
+
+RayLanes prepareRay(const Ray& ray, const TriangleRay& triRay) {
+  RayLanes ret;
+  ret.kx = triRay.kx;
+  ret.ky = triRay.ky;
+  ret.kz = triRay.kz;
+  ret.origin[0] = set1(triRay.origin[triRay.kx]);
+  ret.origin[1] = set1(triRay.origin[triRay.ky]);
+  ret.origin[2] = set1(triRay.origin[triRay.kz]);
+  ret.Sx = set1(triRay.Sx);
+  ret.Sy = set1(triRay.Sy);
+  ret.Sz = set1(triRay.Sz);
+  ret.tmin = set1(ray.tmin);
+  return ret;
+}
+
+// shear and scale vertex of all lanes, see intersectTriangle
+inline void shearVertex(const float p[3][TriangleBlocks::WIDTH],
+                        const RayLanes& ray, FloatLanes& x, FloatLanes& y,
+                        FloatLanes& z) {
+  const FloatLanes px = sub(load(p[ray.kx]), ray.origin[0]);
+  const FloatLanes py = sub(load(p[ray.ky]), ray.origin[1]);
+  const FloatLanes pz = sub(load(p[ray.kz]), ray.origin[2]);
+  x = sub(px, mul(ray.Sx, pz));
+  y = sub(py, mul(ray.Sy, pz));
+  z = mul(ray.Sz, pz);
+}
+
+// watertight test on all lanes of block, return mask of hit lanes
+// https://jcgt.org/published/0002/01/05/
+inline FloatLanes intersectBlock(const TriangleBlocks::Block& block,
+                                 const RayLanes& ray, FloatLanes tmax,
+                                 FloatLanes& t, FloatLanes& u, FloatLanes& v) {
+  FloatLanes Ax, Ay, Az, Bx, By, Bz, Cx, Cy, Cz;
+  shearVertex(block.v0, ray, Ax, Ay, Az);
+  shearVertex(block.v1, ray, Bx, By, Bz);
+  shearVertex(block.v2, ray, Cx, Cy, Cz);
+
+  // edge functions
+  const FloatLanes U = diffOfProducts(Cx, By, Cy, Bx);
+  const FloatLanes V = diffOfProducts(Ax, Cy, Ay, Cx);
+  const FloatLanes W = diffOfProducts(Bx, Ay, By, Ax);
+
+  // ray passes inside triangle when all edge functions have the same sign
+  const FloatLanes zero = set1(0.0f);
+  const FloatLanes anyNegative =
+      vor(vor(cmplt(U, zero), cmplt(V, zero)), cmplt(W, zero));
+  const FloatLanes anyPositive =
+      vor(vor(cmpgt(U, zero), cmpgt(V, zero)), cmpgt(W, zero));
+  const FloatLanes det = add(add(U, V), W);
+  // NOTE: padding lanes are rejected here, since their det is NaN
+  FloatLanes mask =
+      vandnot(vand(anyNegative, anyPositive), cmpneq(det, zero));
+
+  const FloatLanes T = add(add(mul(U, Az), mul(V, Bz)), mul(W, Cz));
+  const FloatLanes invDet = div(set1(1.0f), det);
+  t = mul(T, invDet);
+  mask = vand(mask, cmpge(t, ray.tmin));
+  mask = vand(mask, cmple(t, tmax));
+
+  u = mul(V, invDet);
+  v = mul(W, invDet);
+  return mask;
+}
+
+}  // namespace
+
+void TriangleBlocks::clear() {
+  blocks.clear();
+  leafBlockOffset.clear();
+}
+
+int TriangleBlocks::intersect(uint32_t primStart, uint32_t nPrims,
+                              const Ray& ray, const TriangleRay& triRay,
+                              float& u, float& v) const {
+  if (nPrims == 0) return -1;
+
+  const RayLanes rayLanes = prepareRay(ray, triRay);
+  const uint32_t blockStart = leafBlockOffset[primStart];
+  const uint32_t nBlocks = (nPrims + WIDTH - 1) / WIDTH;
+
+  int hitPrimIdx = -1;
+  for (uint32_t b = 0; b < nBlocks; ++b) {
+    FloatLanes t, uLanes, vLanes;
+    const FloatLanes mask = intersectBlock(blocks[blockStart + b], rayLanes,
+                                           set1(ray.tmax), t, uLanes, vLanes);
+    if (movemask(mask) == 0) continue;
+
+    // find the closest lane
+    t = blend(set1(std::numeric_limits<float>::infinity()), t, mask);
+    alignas(4 * WIDTH) float tArray[WIDTH];
+    store(tArray, t);
+    float tMin = tArray[0];
+    for (int i = 1; i < WIDTH; ++i) {
+      tMin = std::min(tMin, tArray[i]);
+    }
+    const int lane =
+        std::countr_zero(static_cast<unsigned int>(
+            movemask(vand(mask, cmpeq(t, set1(tMin))))));
+
+    alignas(4 * WIDTH) float uArray[WIDTH], vArray[WIDTH];
+    store(uArray, uLanes);
+    store(vArray, vLanes);
+    u = uArray[lane];
+    v = vArray[lane];
+    ray.tmax = tMin;
+    hitPrimIdx = primStart + b * WIDTH + lane;
+  }
+
+  return hitPrimIdx;
+}
+
+int TriangleBlocks::intersectP(uint32_t primStart, uint32_t nPrims,
+                               const Ray& ray,
+                               const TriangleRay& triRay) const {
+  if (nPrims == 0) return -1;
+
+  const RayLanes rayLanes = prepareRay(ray, triRay);
+  const uint32_t blockStart = leafBlockOffset[primStart];
+  const uint32_t nBlocks = (nPrims + WIDTH - 1) / WIDTH;
+  const FloatLanes tmax = set1(ray.tmax);
+  for (uint32_t b = 0; b < nBlocks; ++b) {
+    FloatLanes t, u, v;
+    const int hitMask = movemask(
+        intersectBlock(blocks[blockStart + b], rayLanes, tmax, t, u, v));
+    if (hitMask != 0) {
+      return primStart + WIDTH * b +
+             std::countr_zero(static_cast<unsigned int>(hitMask));
+    }
+  }
+  return -1;
+}
+
+}  // namespace LTRE
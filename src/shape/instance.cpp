@@ -0,0 +1,72 @@
+#include "LTRE/shape/instance.hpp"
+
+#include <cmath>
+
+namespace LTRE {
+
+Instance::Instance(const std::shared_ptr<Shape>& shape,
+                   const Transform& localToWorld)
+    : shape(shape), worldToLocal(localToWorld.inverse()) {}
+
+Ray Instance::toLocal(const Ray& ray, float& tScale) const {
+  const Vec3 direction = worldToLocal.applyVector(ray.direction);
+  tScale = length(direction);
+
+  Ray ret(worldToLocal.applyPoint(ray.origin), direction / tScale);
+  ret.tmin = tScale * ray.tmin;
+  ret.tmax = tScale * ray.tmax;
+  return ret;
+}
+
+bool Instance::intersect(const Ray& ray, IntersectInfo& info) const {
+  float tScale;
+  const Ray localRay = toLocal(ray, tScale);
+  if (!shape->intersect(localRay, info)) return false;
+
+  info.t /= tScale;
+  return true;
+}
+
+bool Instance::intersectP(const Ray& ray) const {
+  float tScale;
+  return shape->intersectP(toLocal(ray, tScale));
+}
+
+SurfaceInfo Instance::computeSurfaceInfo(const Ray& ray,
+                                         const IntersectInfo& info) const {
+  float tScale;
+  const Ray localRay = toLocal(ray, tScale);
+  IntersectInfo localInfo = info;
+  localInfo.t = tScale * info.t;
+
+  const Transform localToWorld = worldToLocal.inverse();
+  SurfaceInfo ret = shape->computeSurfaceInfo(localRay, localInfo);
+  ret.position = localToWorld.applyPoint(ret.position);
+  ret.normal = normalize(localToWorld.applyNormal(ret.normal));
+  return ret;
+}
+
+AABB Instance::aabb() const {
+  return worldToLocal.inverse().applyAABB(shape->aabb());
+}
+
+float Instance::surfaceArea() const {
+  // area is scaled by square of uniform scale
+  const float det = std::abs(worldToLocal.determinant());
+  return shape->surfaceArea() / std::cbrt(det * det);
+}
+
+SurfaceInfo Instance::samplePoint(Sampler& sampler, float& pdf) const {
+  SurfaceInfo ret = shape->samplePoint(sampler, pdf);
+
+  // area of surface element is scaled by |det(M)| * |M^-T n|
+  const Transform localToWorld = worldToLocal.inverse();
+  const Vec3 normal = localToWorld.applyNormal(normalize(ret.normal));
+  pdf /= std::abs(localToWorld.determinant()) * length(normal);
+
+  ret.position = localToWorld.applyPoint(ret.position);
+  ret.normal = normalize(normal);
+  return ret;
+}
+
+}  // namespace LTRE
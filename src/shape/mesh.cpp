@@ -1,7 +1,16 @@
 #include "LTRE/shape/mesh.hpp"
 
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "LTRE/intersector/bvh-cache.hpp"
+
 namespace LTRE {
 
+std::filesystem::path Mesh::bvhCacheDirectory;
+bool Mesh::compressBVH = false;
+
 MeshTriangle::MeshTriangle()
     : positions(nullptr),
       indices(nullptr),
@@ -57,9 +66,7 @@ std::tuple<Vec3, Vec3, Vec3> MeshTriangle::getTangents() const {
   return {tangents[i1], tangents[i2], tangents[i3]};
 }
 
-AABB MeshTriangle::aabb() const {
-  const auto [v1, v2, v3] = getPositions();
-
+static AABB triangleAABB(const Vec3& v1, const Vec3& v2, const Vec3& v3) {
   constexpr float EPS = 1e-8f;
   Vec3 pMin, pMax;
   for (int i = 0; i < 3; ++i) {
@@ -69,37 +76,15 @@ AABB MeshTriangle::aabb() const {
   return AABB(pMin - EPS, pMax + EPS);
 }
 
-bool MeshTriangle::intersect(const Ray& ray, IntersectInfo& info) const {
+AABB MeshTriangle::aabb() const {
   const auto [v1, v2, v3] = getPositions();
+  return triangleAABB(v1, v2, v3);
+}
 
-  // https://www.tandfonline.com/doi/abs/10.1080/10867651.1997.10487468
-  constexpr float EPS = 1e-8;
-  const Vec3 e1 = v2 - v1;
-  const Vec3 e2 = v3 - v1;
-
-  const Vec3 pvec = cross(ray.direction, e2);
-  const float det = dot(e1, pvec);
-
-  if (det > -EPS && det < EPS) return false;
-  const float invDet = 1.0f / det;
-
-  const Vec3 tvec = ray.origin - v1;
-  const float u = dot(tvec, pvec) * invDet;
-  if (u < 0.0f || u > 1.0f) return false;
-
-  const Vec3 qvec = cross(tvec, e1);
-  const float v = dot(ray.direction, qvec) * invDet;
-  if (v < 0.0f || u + v > 1.0f) return false;
-
-  const float t = dot(e2, qvec) * invDet;
-  if (t < ray.tmin || t > ray.tmax) return false;
-
-  info.t = t;
-  info.barycentric[0] = u;
-  info.barycentric[1] = v;
-
+SurfaceInfo MeshTriangle::computeSurfaceInfo(const Vec3& position, float u,
+                                             float v) const {
   SurfaceInfo surfaceInfo;
-  surfaceInfo.position = ray(t);
+  surfaceInfo.position = position;
 
   // calc normal
   const float w = 1.0f - u - v;
@@ -109,7 +94,8 @@ bool MeshTriangle::intersect(const Ray& ray, IntersectInfo& info) const {
     surfaceInfo.normal = w * n1 + u * n2 + v * n3;
   } else {
     // face normal
-    surfaceInfo.normal = normalize(cross(e1, e2));
+    const auto [v1, v2, v3] = getPositions();
+    surfaceInfo.normal = normalize(cross(v2 - v1, v3 - v1));
   }
 
   // calc texcoords
@@ -122,7 +108,22 @@ bool MeshTriangle::intersect(const Ray& ray, IntersectInfo& info) const {
     surfaceInfo.uv[0] = u;
     surfaceInfo.uv[1] = v;
   }
-  info.surfaceInfo = surfaceInfo;
+
+  return surfaceInfo;
+}
+
+bool MeshTriangle::intersect(const Ray& ray, IntersectInfo& info) const {
+  const auto [v1, v2, v3] = getPositions();
+
+  float t, u, v;
+  if (!intersectTriangle(v1, v2, v3, ray, TriangleRay(ray), t, u, v)) {
+    return false;
+  }
+
+  info.t = t;
+  info.barycentric[0] = u;
+  info.barycentric[1] = v;
+  info.faceID = faceID;
 
   return true;
 }
@@ -130,68 +131,137 @@ bool MeshTriangle::intersect(const Ray& ray, IntersectInfo& info) const {
 bool MeshTriangle::intersectP(const Ray& ray) const {
   const auto [v1, v2, v3] = getPositions();
 
-  // https://www.tandfonline.com/doi/abs/10.1080/10867651.1997.10487468
-  constexpr float EPS = 1e-8;
-  const Vec3 e1 = v2 - v1;
-  const Vec3 e2 = v3 - v1;
+  float t, u, v;
+  return intersectTriangle(v1, v2, v3, ray, TriangleRay(ray), t, u, v);
+}
 
-  const Vec3 pvec = cross(ray.direction, e2);
-  const float det = dot(e1, pvec);
+SceneTriangle::SceneTriangle()
+    : positions(nullptr), indices(nullptr), faceID(0), primID(0) {}
 
-  if (det > -EPS && det < EPS) return false;
-  const float invDet = 1.0f / det;
+SceneTriangle::SceneTriangle(const MeshTriangle& triangle, uint32_t primID)
+    : positions(triangle.positions),
+      indices(triangle.indices),
+      faceID(triangle.faceID),
+      primID(primID) {}
 
-  const Vec3 tvec = ray.origin - v1;
-  const float u = dot(tvec, pvec) * invDet;
-  if (u < 0.0f || u > 1.0f) return false;
+std::tuple<Vec3, Vec3, Vec3> SceneTriangle::getPositions() const {
+  const unsigned int idx = 3 * faceID;
+  return {positions[indices[idx]], positions[indices[idx + 1]],
+          positions[indices[idx + 2]]};
+}
 
-  const Vec3 qvec = cross(tvec, e1);
-  const float v = dot(ray.direction, qvec) * invDet;
-  if (v < 0.0f || u + v > 1.0f) return false;
+AABB SceneTriangle::aabb() const {
+  const auto [v1, v2, v3] = getPositions();
+  return triangleAABB(v1, v2, v3);
+}
 
-  const float t = dot(e2, qvec) * invDet;
-  if (t < ray.tmin || t > ray.tmax) return false;
+bool SceneTriangle::intersect(const Ray& ray, IntersectInfo& info) const {
+  const auto [v1, v2, v3] = getPositions();
+
+  float t, u, v;
+  if (!intersectTriangle(v1, v2, v3, ray, TriangleRay(ray), t, u, v)) {
+    return false;
+  }
+
+  info.t = t;
+  info.barycentric[0] = u;
+  info.barycentric[1] = v;
+  info.faceID = faceID;
+  info.primID = primID;
 
   return true;
 }
 
-void Mesh::setupIntersector() {
+bool SceneTriangle::intersectP(const Ray& ray) const {
+  const auto [v1, v2, v3] = getPositions();
+
+  float t, u, v;
+  return intersectTriangle(v1, v2, v3, ray, TriangleRay(ray), t, u, v);
+}
+
+MeshTriangle Mesh::getTriangle(unsigned int faceID) const {
+  MeshTriangle triangle;
+  triangle.positions = positions.data();
+  triangle.indices = indices.data();
+  triangle.faceID = faceID;
+  if (normals.size() > 0) {
+    triangle.normals = normals.data();
+  }
+  if (texcoords.size() > 0) {
+    triangle.texcoords = texcoords.data();
+  }
+  if (tangents.size() > 0) {
+    triangle.tangents = tangents.data();
+  }
+  if (dndus.size() > 0) {
+    triangle.dndus = dndus.data();
+  }
+  if (dndvs.size() > 0) {
+    triangle.dndvs = dndvs.data();
+  }
+  return triangle;
+}
+
+void Mesh::setupIntersector() const {
   // choose intersector
-  if (nFaces() > 4) {
-    intersector = std::make_shared<BVH<MeshTriangle, BVHSplitStrategy::SAH>>();
+  // NOTE: 4-wide SIMD traversal pays off when the tree is deep enough
+  if (nFaces() > 64 && compressBVH) {
+    intersector =
+        std::make_shared<CBVH8<MeshTriangle, BVHSplitStrategy::SAH>>();
+  } else if (nFaces() > 64) {
+    intersector = std::make_shared<QBVH<MeshTriangle, BVHSplitStrategy::SAH>>();
   } else {
     intersector = std::make_shared<BVH<MeshTriangle, BVHSplitStrategy::SAH>>();
   }
 
-  // populate intersector
-  for (unsigned int i = 0; i < nFaces(); i++) {
-    // make MeshTriangle
-    MeshTriangle triangle;
-    triangle.positions = positions.data();
-    triangle.indices = indices.data();
-    triangle.faceID = i;
-    if (normals.size() > 0) {
-      triangle.normals = normals.data();
-    }
-    if (texcoords.size() > 0) {
-      triangle.texcoords = texcoords.data();
-    }
-    if (tangents.size() > 0) {
-      triangle.tangents = tangents.data();
-    }
-    if (dndus.size() > 0) {
-      triangle.dndus = dndus.data();
-    }
-    if (dndvs.size() > 0) {
-      triangle.dndvs = dndvs.data();
+  // load intersector from cache, if the same mesh was built before
+  // NOTE: intersector is chosen by number of faces and compressBVH, so key
+  // covers it
+  std::filesystem::path cachePath;
+  uint64_t key = 0;
+  if (!bvhCacheDirectory.empty()) {
+    key = ContentHash().add(positions).add(indices).add(compressBVH).get();
+    std::stringstream filename;
+    filename << std::hex << std::setw(16) << std::setfill('0') << key
+             << ".bvh";
+    cachePath = bvhCacheDirectory / filename.str();
+
+    if (intersector->loadCache(
+            cachePath, key, nFaces(),
+            [this](unsigned int faceID) { return getTriangle(faceID); })) {
+      spdlog::info("[Mesh] BVH loaded from " + cachePath.string());
+      return;
     }
+  }
 
-    // add MeshTriangle to intersector
-    intersector->addPrimitive(triangle);
+  // populate intersector
+  for (unsigned int i = 0; i < nFaces(); i++) {
+    intersector->addPrimitive(getTriangle(i));
   }
 
   // build intersector
   intersector->build();
+
+  if (!cachePath.empty()) {
+    intersector->saveCache(cachePath, key);
+  }
+}
+
+float Mesh::computeSurfaceArea() const {
+  float ret = 0;
+  for (unsigned int f = 0; f < nFaces(); ++f) {
+    const auto [p1, p2, p3] = getTriangle(f).getPositions();
+    ret += 0.5f * length(cross(p2 - p1, p3 - p1));
+  }
+  return ret;
+}
+
+AABB Mesh::computeAABB() const {
+  AABB ret;
+  for (unsigned int f = 0; f < nFaces(); ++f) {
+    ret = mergeAABB(ret, getTriangle(f).aabb());
+  }
+  return ret;
 }
 
 Mesh::Mesh(const std::vector<Vec3>& positions,
@@ -211,36 +281,75 @@ Mesh::Mesh(const std::vector<Vec3>& positions,
     std::exit(EXIT_FAILURE);
   }
 
-  // compute surface area
-  surfaceArea_ = 0;
-  for (unsigned int f = 0; f < nFaces(); f += 3) {
-    const int idx1 = indices[3 * f];
-    const int idx2 = indices[3 * f + 1];
-    const int idx3 = indices[3 * f + 2];
-    const Vec3 p1 = positions[idx1];
-    const Vec3 p2 = positions[idx2];
-    const Vec3 p3 = positions[idx3];
-    surfaceArea_ += 0.5f * length(cross(p2 - p1, p3 - p1));
-  }
+  // compute surface area and bounds
+  surfaceArea_ = computeSurfaceArea();
+  aabb_ = computeAABB();
+}
 
-  setupIntersector();
+void Mesh::setBVHCacheDirectory(const std::filesystem::path& directory) {
+  bvhCacheDirectory = directory;
 }
 
+void Mesh::setCompressBVH(bool compress) { compressBVH = compress; }
+
 unsigned int Mesh::nVertices() const { return indices.size(); }
 
 unsigned int Mesh::nFaces() const { return indices.size() / 3; }
 
 float Mesh::getSurfaceArea() const { return surfaceArea_; }
 
+void Mesh::buildIntersector() const {
+  std::call_once(intersectorFlag, [this] { setupIntersector(); });
+}
+
+void Mesh::updatePositions(const std::vector<Vec3>& positions,
+                           const std::vector<Vec3>& normals) {
+  if (positions.size() != this->positions.size()) {
+    spdlog::error("[Mesh] number of positions doesn't match.");
+    std::exit(EXIT_FAILURE);
+  }
+  if (normals.size() > 0 && normals.size() != this->normals.size()) {
+    spdlog::error("[Mesh] number of normals doesn't match.");
+    std::exit(EXIT_FAILURE);
+  }
+
+  // NOTE: overwrite in place, since triangles in intersector point to these
+  // arrays
+  std::copy(positions.begin(), positions.end(), this->positions.begin());
+  if (normals.size() > 0) {
+    std::copy(normals.begin(), normals.end(), this->normals.begin());
+  }
+  surfaceArea_ = computeSurfaceArea();
+  aabb_ = computeAABB();
+
+  // NOTE: intersector which is not built yet is built from new positions
+  if (intersector) intersector->refit();
+}
+
 bool Mesh::intersect(const Ray& ray, IntersectInfo& info) const {
+  buildIntersector();
   return intersector->intersect(ray, info);
 }
 
 bool Mesh::intersectP(const Ray& ray) const {
+  buildIntersector();
   return intersector->intersectP(ray);
 }
 
-AABB Mesh::aabb() const { return intersector->aabb(); }
+uint32_t Mesh::intersectPacket(const RayPacket& packet, uint32_t activeMask,
+                               IntersectInfo info[RayPacket::SIZE]) const {
+  buildIntersector();
+  return intersector->intersectPacket(packet, activeMask, info);
+}
+
+SurfaceInfo Mesh::computeSurfaceInfo(const Ray& ray,
+                                     const IntersectInfo& info) const {
+  return getTriangle(info.faceID)
+      .computeSurfaceInfo(ray(info.t), info.barycentric[0],
+                          info.barycentric[1]);
+}
+
+AABB Mesh::aabb() const { return aabb_; }
 
 float Mesh::surfaceArea() const { return surfaceArea_; }
 
@@ -27,11 +27,6 @@ bool Plane::intersect(const Ray& ray, IntersectInfo& info) const {
 
   info.t = t;
   info.barycentric = Vec2(dx / rightLength, dy / upLength);
-  SurfaceInfo surfaceInfo;
-  surfaceInfo.position = ray(t);
-  surfaceInfo.normal = normal;
-  surfaceInfo.uv = info.barycentric;
-  info.surfaceInfo = surfaceInfo;
   return true;
 }
 
@@ -48,6 +43,15 @@ bool Plane::intersectP(const Ray& ray) const {
   return true;
 }
 
+SurfaceInfo Plane::computeSurfaceInfo(const Ray& ray,
+                                      const IntersectInfo& info) const {
+  SurfaceInfo ret;
+  ret.position = ray(info.t);
+  ret.normal = normal;
+  ret.uv = info.barycentric;
+  return ret;
+}
+
 AABB Plane::aabb() const {
   return AABB(leftCornerPoint - Vec3(EPS),
               leftCornerPoint + right + up + Vec3(EPS));
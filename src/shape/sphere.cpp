@@ -23,10 +23,6 @@ bool Sphere::intersect(const Ray& ray, IntersectInfo& info) const {
   }
 
   info.t = t;
-  SurfaceInfo surfaceInfo;
-  surfaceInfo.position = ray(t);
-  surfaceInfo.normal = normalize(surfaceInfo.position - center);
-  info.surfaceInfo = surfaceInfo;
   return true;
 }
 
@@ -47,6 +43,15 @@ bool Sphere::intersectP(const Ray& ray) const {
   return true;
 }
 
+// TODO: set uv
+SurfaceInfo Sphere::computeSurfaceInfo(const Ray& ray,
+                                       const IntersectInfo& info) const {
+  SurfaceInfo ret;
+  ret.position = ray(info.t);
+  ret.normal = normalize(ret.position - center);
+  return ret;
+}
+
 AABB Sphere::aabb() const {
   constexpr float EPS = 1e-8f;
   return AABB(center - Vec3(radius + EPS), center + Vec3(radius + EPS));
@@ -0,0 +1,181 @@
+#include "LTRE/intersector/bvh.hpp"
+
+#include "gtest/gtest.h"
+#include "triangle-soup.hpp"
+
+using namespace LTRE;
+
+TEST(BVHIntersection, SAH) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareWithLinearIntersector<BVH<MeshTriangle, BVHSplitStrategy::SAH>>(
+        nFaces);
+  }
+}
+
+TEST(BVHIntersection, CENTER) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareWithLinearIntersector<BVH<MeshTriangle, BVHSplitStrategy::CENTER>>(
+        nFaces);
+  }
+}
+
+TEST(BVHIntersection, EQUAL) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareWithLinearIntersector<BVH<MeshTriangle, BVHSplitStrategy::EQUAL>>(
+        nFaces);
+  }
+}
+
+TEST(BVHIntersection, ParallelBuild) {
+  // large enough to build subtrees as tasks and bin nodes in chunks
+  compareWithLinearIntersector<BVH<MeshTriangle, BVHSplitStrategy::SAH>>(
+      100000);
+}
+
+TEST(BVHIntersection, SBVH) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareWithLinearIntersector<BVH<MeshTriangle, BVHSplitStrategy::SBVH>>(
+        nFaces);
+  }
+}
+
+TEST(BVHBuild, SBVHReferenceBudget) {
+  const TriangleSoup soup(10000, 0);
+  for (const float budget : {0.0f, 0.1f}) {
+    BVH<MeshTriangle, BVHSplitStrategy::SBVH> bvh(soup.triangles);
+    bvh.setReferenceBudget(budget);
+    bvh.build();
+    EXPECT_EQ(bvh.getPrimitivesRef().size(), soup.triangles.size());
+    EXPECT_GE(bvh.nLeafPrimitives(), soup.triangles.size());
+    EXPECT_LE(bvh.nLeafPrimitives(), (1.0f + budget) * soup.triangles.size());
+  }
+}
+
+TEST(BVHBuild, SBVHRebuild) {
+  // spatial splits duplicate references, but never primitives
+  const TriangleSoup soup(1000, 1000);
+  BVH<MeshTriangle, BVHSplitStrategy::SBVH> bvh(soup.triangles);
+  bvh.build();
+  EXPECT_GT(bvh.nLeafPrimitives(), soup.triangles.size());
+  EXPECT_EQ(bvh.getPrimitivesRef().size(), soup.triangles.size());
+
+  bvh.build();
+  EXPECT_EQ(bvh.getPrimitivesRef().size(), soup.triangles.size());
+  compareWithLinearIntersector(bvh, soup.triangles);
+
+  // refit falling back to rebuild
+  bvh.setRebuildThreshold(0.0f);
+  bvh.refit();
+  EXPECT_EQ(bvh.getPrimitivesRef().size(), soup.triangles.size());
+  compareWithLinearIntersector(bvh, soup.triangles);
+}
+
+TEST(BVHIntersection, LBVH) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareWithLinearIntersector<BVH<MeshTriangle, BVHSplitStrategy::LBVH>>(
+        nFaces);
+  }
+}
+
+TEST(BVHIntersection, ParallelLBVHBuild) {
+  // large enough to sort and gather references in chunks
+  compareWithLinearIntersector<BVH<MeshTriangle, BVHSplitStrategy::LBVH>>(
+      100000);
+}
+
+TEST(BVHBuild, LBVHDuplicatedCentroids) {
+  // all triangles share the same Morton code, split in the middle
+  TriangleSoup soup(100, 0);
+  for (std::size_t i = 0; i < soup.positions.size(); i += 3) {
+    soup.positions[i] = Vec3(0.0f, 0.0f, 0.0f);
+    soup.positions[i + 1] = Vec3(1.0f, 0.0f, 0.0f);
+    soup.positions[i + 2] = Vec3(0.0f, 1.0f, 0.0f);
+  }
+  BVH<MeshTriangle, BVHSplitStrategy::LBVH> bvh(soup.triangles);
+  bvh.build();
+  EXPECT_EQ(bvh.getPrimitivesRef().size(), soup.triangles.size());
+
+  const Ray ray(Vec3(0.25f, 0.25f, 1.0f), Vec3(0.0f, 0.0f, -1.0f));
+  IntersectInfo info;
+  EXPECT_TRUE(bvh.intersect(ray, info));
+  EXPECT_FLOAT_EQ(info.t, 1.0f);
+}
+
+TEST(BVHIntersection, Refit) {
+  using BVHSAH = BVH<MeshTriangle, BVHSplitStrategy::SAH>;
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    // refit only, then rebuild by degraded SAH cost
+    compareRefitWithLinearIntersector<BVHSAH>(
+        nFaces, std::numeric_limits<float>::max());
+    compareRefitWithLinearIntersector<BVHSAH>(nFaces, 1.0f);
+  }
+}
+
+TEST(BVHIntersection, Cache) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareCachedWithLinearIntersector<
+        BVH<MeshTriangle, BVHSplitStrategy::SAH>>(nFaces);
+    compareCachedWithLinearIntersector<
+        BVH<MeshTriangle, BVHSplitStrategy::SBVH>>(nFaces);
+  }
+}
+
+TEST(BVHIntersection, Packet) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    comparePacketWithLinearIntersector<
+        BVH<MeshTriangle, BVHSplitStrategy::SAH>>(nFaces);
+  }
+}
+
+TEST(BVHIntersection, Occlusion) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareOcclusionWithLinearIntersector<
+        BVH<MeshTriangle, BVHSplitStrategy::SAH>>(nFaces);
+  }
+}
+
+TEST(BVHIntersection, Watertight) {
+  for (const unsigned int n : {4, 16, 64}) {
+    checkWatertight<BVH<MeshTriangle, BVHSplitStrategy::SAH>>(n);
+  }
+}
+
+// depth of binary bvh built over triangle chain, size of leaves is also
+// checked
+template <BVHSplitStrategy strategy>
+int buildChainDepth(unsigned int nFaces) {
+  using Builder = BVHBuilder<MeshTriangle, strategy>;
+  const TriangleChain chain(nFaces);
+  Builder builder;
+  builder.build(chain.triangles);
+  const std::vector<BVHBuildNode>& nodes = builder.getNodesRef();
+
+  int maxDepth = 0;
+  std::vector<std::pair<uint32_t, int>> stack = {{0, 0}};
+  while (!stack.empty()) {
+    const auto [nodeIdx, depth] = stack.back();
+    stack.pop_back();
+    maxDepth = std::max(maxDepth, depth);
+    if (nodes[nodeIdx].isLeaf()) {
+      EXPECT_LE(nodes[nodeIdx].nRefs, Builder::MAX_PRIMITIVES_IN_LEAF);
+      continue;
+    }
+    stack.push_back({nodes[nodeIdx].child[0], depth + 1});
+    stack.push_back({nodes[nodeIdx].child[1], depth + 1});
+  }
+  return maxDepth;
+}
+
+TEST(BVHBuild, DepthBound) {
+  constexpr unsigned int nFaces = 80;
+  EXPECT_LE(buildChainDepth<BVHSplitStrategy::CENTER>(nFaces), BVH_MAX_DEPTH);
+  EXPECT_LE(buildChainDepth<BVHSplitStrategy::EQUAL>(nFaces), BVH_MAX_DEPTH);
+  EXPECT_LE(buildChainDepth<BVHSplitStrategy::SAH>(nFaces), BVH_MAX_DEPTH);
+  EXPECT_LE(buildChainDepth<BVHSplitStrategy::SBVH>(nFaces), BVH_MAX_DEPTH);
+  EXPECT_LE(buildChainDepth<BVHSplitStrategy::LBVH>(nFaces), BVH_MAX_DEPTH);
+}
+
+TEST(BVHIntersection, DeepChain) {
+  checkDeepChain<BVH<MeshTriangle, BVHSplitStrategy::CENTER>>(40);
+  checkDeepChain<BVH<MeshTriangle, BVHSplitStrategy::SAH>>(40);
+}
@@ -0,0 +1,75 @@
+#include "LTRE/intersector/bvh8.hpp"
+
+#include "gtest/gtest.h"
+#include "triangle-soup.hpp"
+
+using namespace LTRE;
+
+TEST(BVH8Intersection, SAH) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareWithLinearIntersector<BVH8<MeshTriangle, BVHSplitStrategy::SAH>>(
+        nFaces);
+  }
+}
+
+TEST(BVH8Intersection, CENTER) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareWithLinearIntersector<
+        BVH8<MeshTriangle, BVHSplitStrategy::CENTER>>(nFaces);
+  }
+}
+
+TEST(BVH8Intersection, EQUAL) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareWithLinearIntersector<BVH8<MeshTriangle, BVHSplitStrategy::EQUAL>>(
+        nFaces);
+  }
+}
+
+TEST(BVH8Intersection, SBVH) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareWithLinearIntersector<BVH8<MeshTriangle, BVHSplitStrategy::SBVH>>(
+        nFaces);
+  }
+}
+
+TEST(BVH8Intersection, LBVH) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareWithLinearIntersector<BVH8<MeshTriangle, BVHSplitStrategy::LBVH>>(
+        nFaces);
+  }
+}
+
+TEST(BVH8Intersection, Refit) {
+  using BVH8SAH = BVH8<MeshTriangle, BVHSplitStrategy::SAH>;
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    // refit only, then rebuild by degraded SAH cost
+    compareRefitWithLinearIntersector<BVH8SAH>(
+        nFaces, std::numeric_limits<float>::max());
+    compareRefitWithLinearIntersector<BVH8SAH>(nFaces, 1.0f);
+  }
+}
+
+TEST(BVH8Intersection, Cache) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareCachedWithLinearIntersector<
+        BVH8<MeshTriangle, BVHSplitStrategy::SAH>>(nFaces);
+  }
+}
+
+TEST(BVH8Intersection, Occlusion) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareOcclusionWithLinearIntersector<
+        BVH8<MeshTriangle, BVHSplitStrategy::SAH>>(nFaces);
+  }
+}
+
+TEST(BVH8Intersection, Watertight) {
+  for (const unsigned int n : {4, 16, 64}) {
+    checkWatertight<BVH8<MeshTriangle, BVHSplitStrategy::SAH>>(n);
+  }
+}
+
+TEST(BVH8Intersection, DeepChain) {
+  checkDeepChain<BVH8<MeshTriangle, BVHSplitStrategy::CENTER>>(40);
+}
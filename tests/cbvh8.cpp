@@ -0,0 +1,160 @@
+#include "LTRE/intersector/cbvh8.hpp"
+
+#include "LTRE/intersector/bvh8.hpp"
+#include "gtest/gtest.h"
+#include "triangle-soup.hpp"
+
+using namespace LTRE;
+
+TEST(CBVH8Intersection, SAH) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareWithLinearIntersector<CBVH8<MeshTriangle, BVHSplitStrategy::SAH>>(
+        nFaces);
+  }
+}
+
+TEST(CBVH8Intersection, CENTER) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareWithLinearIntersector<
+        CBVH8<MeshTriangle, BVHSplitStrategy::CENTER>>(nFaces);
+  }
+}
+
+TEST(CBVH8Intersection, EQUAL) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareWithLinearIntersector<
+        CBVH8<MeshTriangle, BVHSplitStrategy::EQUAL>>(nFaces);
+  }
+}
+
+TEST(CBVH8Intersection, SBVH) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareWithLinearIntersector<CBVH8<MeshTriangle, BVHSplitStrategy::SBVH>>(
+        nFaces);
+  }
+}
+
+TEST(CBVH8Intersection, LBVH) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareWithLinearIntersector<CBVH8<MeshTriangle, BVHSplitStrategy::LBVH>>(
+        nFaces);
+  }
+}
+
+TEST(CBVH8Intersection, Refit) {
+  using CBVH8SAH = CBVH8<MeshTriangle, BVHSplitStrategy::SAH>;
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    // refit only, then rebuild by degraded SAH cost
+    compareRefitWithLinearIntersector<CBVH8SAH>(
+        nFaces, std::numeric_limits<float>::max());
+    compareRefitWithLinearIntersector<CBVH8SAH>(nFaces, 1.0f);
+  }
+}
+
+TEST(CBVH8Intersection, Cache) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareCachedWithLinearIntersector<
+        CBVH8<MeshTriangle, BVHSplitStrategy::SAH>>(nFaces);
+    compareCachedWithLinearIntersector<
+        CBVH8<MeshTriangle, BVHSplitStrategy::SBVH>>(nFaces);
+  }
+}
+
+TEST(CBVH8Intersection, CacheAmbiguousChild) {
+  using CBVH8SAH = CBVH8<MeshTriangle, BVHSplitStrategy::SAH>;
+  const unsigned int nFaces = 40;
+  const TriangleSoup soup(nFaces, nFaces);
+  const auto makePrimitive = [&](unsigned int faceID) {
+    return soup.triangles[faceID];
+  };
+  const std::filesystem::path cachePath =
+      std::filesystem::temp_directory_path() / "ltre-CBVH8-ambiguous.bvh";
+  {
+    CBVH8SAH cbvh(soup.triangles);
+    cbvh.build();
+    ASSERT_TRUE(cbvh.saveCache(cachePath, nFaces));
+  }
+
+  // offsets of internalMask and nPrimitives in node
+  constexpr std::size_t INTERNAL_MASK_OFFSET = 15;
+  constexpr std::size_t N_PRIMITIVES_OFFSET = 24;
+  std::fstream stream(cachePath,
+                      std::ios::binary | std::ios::in | std::ios::out);
+  uint8_t internalMask;
+  uint32_t nPrimitives;
+  stream.seekg(BVHCacheFile::NODES_OFFSET + INTERNAL_MASK_OFFSET);
+  stream.read(reinterpret_cast<char*>(&internalMask), sizeof(internalMask));
+  stream.seekg(BVHCacheFile::NODES_OFFSET + N_PRIMITIVES_OFFSET);
+  stream.read(reinterpret_cast<char*>(&nPrimitives), sizeof(nPrimitives));
+  // NOTE: root has both internal and leaf children with this many faces
+  ASSERT_NE(internalMask, 0);
+  ASSERT_NE(nPrimitives, 0);
+  const auto writeNPrimitives = [&](uint32_t value) {
+    stream.seekp(BVHCacheFile::NODES_OFFSET + N_PRIMITIVES_OFFSET);
+    stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    stream.flush();
+  };
+
+  // internal child which is also leaf is rejected
+  CBVH8SAH cbvh;
+  const int internal = std::countr_zero(internalMask);
+  writeNPrimitives(nPrimitives | (1u << (4 * internal)));
+  EXPECT_FALSE(cbvh.loadCache(cachePath, nFaces, nFaces, makePrimitive));
+
+  // child which is neither internal nor leaf, but has bounds is rejected
+  int leaf = 0;
+  while ((nPrimitives >> (4 * leaf) & 0xf) == 0) leaf++;
+  writeNPrimitives(nPrimitives & ~(0xfu << (4 * leaf)));
+  EXPECT_FALSE(cbvh.loadCache(cachePath, nFaces, nFaces, makePrimitive));
+
+  writeNPrimitives(nPrimitives);
+  EXPECT_TRUE(cbvh.loadCache(cachePath, nFaces, nFaces, makePrimitive));
+  stream.close();
+  std::filesystem::remove(cachePath);
+}
+
+TEST(CBVH8Build, NodeMemory) {
+  // nodes are 80Byte instead of 256Byte of BVH8, same number of nodes
+  const TriangleSoup soup(10000, 0);
+  CBVH8<MeshTriangle, BVHSplitStrategy::SAH> cbvh(soup.triangles);
+  cbvh.build();
+  BVH8<MeshTriangle, BVHSplitStrategy::SAH> bvh8(soup.triangles);
+  bvh8.build();
+  EXPECT_EQ(cbvh.nInternalNodes(), bvh8.nInternalNodes());
+  EXPECT_LE(3 * cbvh.nodeMemory(), bvh8.nInternalNodes() * std::size_t(256));
+}
+
+TEST(CBVH8Intersection, Occlusion) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareOcclusionWithLinearIntersector<
+        CBVH8<MeshTriangle, BVHSplitStrategy::SAH>>(nFaces);
+  }
+}
+
+TEST(CBVH8Intersection, Watertight) {
+  for (const unsigned int n : {4, 16, 64}) {
+    checkWatertight<CBVH8<MeshTriangle, BVHSplitStrategy::SAH>>(n);
+  }
+}
+
+TEST(CBVH8Intersection, DeepChain) {
+  checkDeepChain<CBVH8<MeshTriangle, BVHSplitStrategy::CENTER>>(40);
+}
+
+TEST(CBVH8Intersection, FlatNode) {
+  // degenerate triangles far from origin have AABB of a point, so that grid
+  // of node has no room to invert boxes of empty children
+  const Vec3 p(1 << 26, 1 << 26, 1 << 26);
+  for (const unsigned int nFaces : {1, 20}) {
+    TriangleSoup soup(nFaces, nFaces);
+    std::fill(soup.positions.begin(), soup.positions.end(), p);
+    CBVH8<MeshTriangle, BVHSplitStrategy::SAH> cbvh(soup.triangles);
+    cbvh.build();
+
+    // ray passes through the point, where all children are hit
+    const Ray ray(p + Vec3(64.0f), normalize(Vec3(-1.0f)));
+    IntersectInfo info;
+    EXPECT_FALSE(cbvh.intersect(ray, info));
+    EXPECT_FALSE(cbvh.intersectP(ray));
+  }
+}
@@ -0,0 +1,75 @@
+#include "LTRE/core/film.hpp"
+
+#include <random>
+
+#include "gtest/gtest.h"
+
+using namespace LTRE;
+
+TEST(Film, PublishAverage) {
+  Film film(4, 2, {Tile{0, 0, 4, 2}});
+  film.addSample(1, 1, Vec3(1, 2, 3));
+  film.addSample(1, 1, Vec3(3, 2, 1));
+  film.addSample(2, 0, Vec3(4));
+
+  // NOTE: samples are not visible until published
+  EXPECT_EQ(film.snapshot().getPixel(1, 1), Vec3(0));
+
+  film.publish(0);
+  const Image<Vec3> image = film.snapshot();
+  EXPECT_EQ(image.getPixel(1, 1), Vec3(2));
+  EXPECT_EQ(image.getPixel(2, 0), Vec3(4));
+  EXPECT_EQ(image.getPixel(0, 0), Vec3(0));
+
+  const Image<float> counts = film.sampleCounts();
+  EXPECT_EQ(counts.getPixel(1, 1), 2);
+  EXPECT_EQ(counts.getPixel(2, 0), 1);
+}
+
+TEST(Film, PublishTile) {
+  Film film(4, 2, {Tile{0, 0, 2, 2}, Tile{2, 0, 4, 2}});
+  film.addSample(1, 1, Vec3(1));
+  film.addSample(3, 1, Vec3(2));
+
+  // only pixels of published tile are visible
+  film.publish(1);
+  Image<Vec3> image = film.snapshot();
+  EXPECT_EQ(image.getPixel(1, 1), Vec3(0));
+  EXPECT_EQ(image.getPixel(3, 1), Vec3(2));
+
+  film.publish(0);
+  image = film.snapshot();
+  EXPECT_EQ(image.getPixel(1, 1), Vec3(1));
+  EXPECT_EQ(image.getPixel(3, 1), Vec3(2));
+
+  // clear removes published pixels as well
+  film.clear();
+  EXPECT_EQ(film.snapshot().getPixel(3, 1), Vec3(0));
+}
+
+TEST(Film, Convergence) {
+  Film film(3, 1, {Tile{0, 0, 3, 1}});
+  film.setConvergenceCriterion(ConvergenceCriterion{0.01f, 16});
+
+  std::mt19937 mt(0);
+  std::uniform_real_distribution<float> dist(0.0f, 2.0f);
+  for (unsigned int n = 1; n <= 1000; ++n) {
+    // constant pixel converges as soon as minSamples are taken
+    const bool converged = film.addSample(0, 0, Vec3(0.5f));
+    EXPECT_EQ(converged, n == 16);
+    // black pixel converges as well
+    film.addSample(1, 0, Vec3(0));
+    // noisy pixel needs about (stddev / mean / threshold)^2 = 3333 samples
+    film.addSample(2, 0, Vec3(dist(mt)));
+  }
+  EXPECT_TRUE(film.isConverged(0, 0));
+  EXPECT_TRUE(film.isConverged(1, 0));
+  EXPECT_FALSE(film.isConverged(2, 0));
+
+  // adaptive sampling is disabled by default
+  Film fixed(1, 1, {Tile{0, 0, 1, 1}});
+  for (int n = 0; n < 100; ++n) {
+    EXPECT_FALSE(fixed.addSample(0, 0, Vec3(1)));
+  }
+  EXPECT_FALSE(fixed.isConverged(0, 0));
+}
@@ -0,0 +1,112 @@
+#include "LTRE/shape/instance.hpp"
+
+#include "LTRE/shape/mesh.hpp"
+#include "LTRE/shape/sphere.hpp"
+#include "gtest/gtest.h"
+#include "triangle-soup.hpp"
+
+using namespace LTRE;
+
+namespace {
+
+const Transform TRANSFORM = translate(Vec3(0.3f, -0.2f, 0.5f)) *
+                            rotate(0.7f, Vec3(1.0f, 2.0f, 3.0f)) *
+                            scale(Vec3(1.5f, 0.5f, 2.0f));
+
+void expectNear(const Vec3& v1, const Vec3& v2, float eps) {
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_NEAR(v1[i], v2[i], eps);
+  }
+}
+
+// mesh without vertex attributes
+std::shared_ptr<Mesh> makeMesh(const std::vector<Vec3>& positions,
+                               const std::vector<unsigned int>& indices) {
+  return std::make_shared<Mesh>(positions, indices, std::vector<Vec3>(),
+                                std::vector<Vec2>(), std::vector<Vec3>(),
+                                std::vector<Vec3>(), std::vector<Vec3>());
+}
+
+}  // namespace
+
+TEST(Transform, Inverse) {
+  const Transform identity = TRANSFORM * TRANSFORM.inverse();
+  const Vec3 p(0.1f, 0.2f, 0.3f);
+  expectNear(identity.applyPoint(p), p, 1e-5f);
+  expectNear(TRANSFORM.inverse().applyPoint(TRANSFORM.applyPoint(p)), p,
+             1e-5f);
+  expectNear(TRANSFORM.inverse().applyVector(TRANSFORM.applyVector(p)), p,
+             1e-5f);
+  EXPECT_TRUE(Transform().isIdentity());
+  EXPECT_FALSE(TRANSFORM.isIdentity());
+}
+
+TEST(Transform, Normal) {
+  // transformed normal stays perpendicular to transformed tangent
+  const Vec3 n(0.0f, 0.0f, 1.0f);
+  const Vec3 t(1.0f, 1.0f, 0.0f);
+  EXPECT_NEAR(dot(TRANSFORM.applyNormal(n), TRANSFORM.applyVector(t)), 0.0f,
+              1e-5f);
+}
+
+TEST(Instance, MeshIntersection) {
+  // instance of mesh should be same as mesh transformed in advance
+  const TriangleSoup soup(1000, 0);
+  std::vector<Vec3> transformedPositions;
+  for (const Vec3& p : soup.positions) {
+    transformedPositions.push_back(TRANSFORM.applyPoint(p));
+  }
+  const auto mesh = makeMesh(soup.positions, soup.indices);
+  const auto transformedMesh = makeMesh(transformedPositions, soup.indices);
+  const Instance instance(mesh, TRANSFORM);
+
+  const AABB bbox = instance.aabb();
+  const AABB bboxRef = transformedMesh->aabb();
+  EXPECT_TRUE(bbox.bounds[0] <= bboxRef.bounds[0]);
+  EXPECT_TRUE(bbox.bounds[1] >= bboxRef.bounds[1]);
+
+  std::mt19937 mt(0);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  for (int i = 0; i < 1000; ++i) {
+    const Ray ray(3.0f * Vec3(dist(mt), dist(mt), dist(mt)),
+                  normalize(Vec3(dist(mt), dist(mt), dist(mt))));
+    const float tmax = ray.tmax;
+
+    IntersectInfo info, infoRef;
+    const bool hit = instance.intersect(ray, info);
+    ray.tmax = tmax;
+    const bool hitRef = transformedMesh->intersect(ray, infoRef);
+    ray.tmax = tmax;
+    const bool hitP = instance.intersectP(ray);
+
+    EXPECT_EQ(hit, hitRef);
+    EXPECT_EQ(hitP, hitRef);
+    if (hit && hitRef) {
+      EXPECT_NEAR(info.t, infoRef.t, 1e-3f);
+      EXPECT_EQ(info.faceID, infoRef.faceID);
+
+      const SurfaceInfo surf = instance.computeSurfaceInfo(ray, info);
+      const SurfaceInfo surfRef =
+          transformedMesh->computeSurfaceInfo(ray, infoRef);
+      expectNear(surf.position, surfRef.position, 1e-3f);
+      expectNear(surf.normal, surfRef.normal, 1e-3f);
+    }
+  }
+}
+
+TEST(Instance, SphereIntersection) {
+  // sphere assumes normalized ray direction, while transform scales it
+  const auto sphere = std::make_shared<Sphere>(Vec3(0.0f), 1.0f);
+  const Instance instance(sphere, translate(Vec3(0.0f, 0.0f, -5.0f)) *
+                                      scale(Vec3(2.0f)));
+
+  const Ray ray(Vec3(0.0f), Vec3(0.0f, 0.0f, -1.0f));
+  IntersectInfo info;
+  ASSERT_TRUE(instance.intersect(ray, info));
+  EXPECT_NEAR(info.t, 3.0f, 1e-5f);
+
+  const SurfaceInfo surf = instance.computeSurfaceInfo(ray, info);
+  expectNear(surf.position, Vec3(0.0f, 0.0f, -3.0f), 1e-5f);
+  expectNear(surf.normal, Vec3(0.0f, 0.0f, 1.0f), 1e-5f);
+  EXPECT_NEAR(instance.surfaceArea(), 4.0f * sphere->surfaceArea(), 1e-3f);
+}
@@ -3,6 +3,7 @@
 #include <iostream>
 
 #include "gtest/gtest.h"
+#include "triangle-soup.hpp"
 
 using namespace LTRE;
 
@@ -49,4 +50,80 @@ TEST(SIMDIntersection, BasicAssertions) {
   EXPECT_GT(hitChild[1], 0);
   EXPECT_EQ(hitChild[2], 0);
   EXPECT_EQ(hitChild[3], 0);
-}
\ No newline at end of file
+}
+
+TEST(QBVHIntersection, SAH) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareWithLinearIntersector<QBVH<MeshTriangle, BVHSplitStrategy::SAH>>(
+        nFaces);
+  }
+}
+
+TEST(QBVHIntersection, CENTER) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareWithLinearIntersector<
+        QBVH<MeshTriangle, BVHSplitStrategy::CENTER>>(nFaces);
+  }
+}
+
+TEST(QBVHIntersection, EQUAL) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareWithLinearIntersector<QBVH<MeshTriangle, BVHSplitStrategy::EQUAL>>(
+        nFaces);
+  }
+}
+
+TEST(QBVHIntersection, SBVH) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareWithLinearIntersector<QBVH<MeshTriangle, BVHSplitStrategy::SBVH>>(
+        nFaces);
+  }
+}
+
+TEST(QBVHIntersection, LBVH) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareWithLinearIntersector<QBVH<MeshTriangle, BVHSplitStrategy::LBVH>>(
+        nFaces);
+  }
+}
+
+TEST(QBVHIntersection, Refit) {
+  using QBVHSAH = QBVH<MeshTriangle, BVHSplitStrategy::SAH>;
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    // refit only, then rebuild by degraded SAH cost
+    compareRefitWithLinearIntersector<QBVHSAH>(
+        nFaces, std::numeric_limits<float>::max());
+    compareRefitWithLinearIntersector<QBVHSAH>(nFaces, 1.0f);
+  }
+}
+
+TEST(QBVHIntersection, Cache) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareCachedWithLinearIntersector<
+        QBVH<MeshTriangle, BVHSplitStrategy::SAH>>(nFaces);
+  }
+}
+
+TEST(QBVHIntersection, Packet) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    comparePacketWithLinearIntersector<
+        QBVH<MeshTriangle, BVHSplitStrategy::SAH>>(nFaces);
+  }
+}
+
+TEST(QBVHIntersection, Occlusion) {
+  for (const unsigned int nFaces : {1, 3, 17, 1000}) {
+    compareOcclusionWithLinearIntersector<
+        QBVH<MeshTriangle, BVHSplitStrategy::SAH>>(nFaces);
+  }
+}
+
+TEST(QBVHIntersection, Watertight) {
+  for (const unsigned int n : {4, 16, 64}) {
+    checkWatertight<QBVH<MeshTriangle, BVHSplitStrategy::SAH>>(n);
+  }
+}
+
+TEST(QBVHIntersection, DeepChain) {
+  checkDeepChain<QBVH<MeshTriangle, BVHSplitStrategy::CENTER>>(40);
+}
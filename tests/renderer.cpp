@@ -0,0 +1,56 @@
+#include "LTRE/core/renderer.hpp"
+
+#include "LTRE/camera/pinhole-camera.hpp"
+#include "LTRE/core/allocation-counter.hpp"
+#include "LTRE/core/scene.hpp"
+#include "LTRE/integrator/pt.hpp"
+#include "LTRE/intersector/bvh.hpp"
+#include "LTRE/light/sky/uniform-sky.hpp"
+#include "LTRE/sampling/uniform.hpp"
+#include "LTRE/shape/plane.hpp"
+#include "LTRE/shape/sphere.hpp"
+#include "gtest/gtest.h"
+
+using namespace LTRE;
+
+namespace {
+
+// spheres of each material on a plane, lit by sky
+Scene makeScene() {
+  Scene scene(std::make_shared<BVH<Primitive, BVHSplitStrategy::SAH>>(),
+              std::make_shared<UniformSky>(Vec3(1)));
+  const auto tex = std::make_shared<UniformTexture<Vec3>>(Vec3(0.8));
+  scene.addPrimitive(
+      Primitive(std::make_shared<Plane>(Vec3(-5, -1, -5), Vec3(0, 0, 10),
+                                        Vec3(10, 0, 0)),
+                std::make_shared<Diffuse>(tex, 0.2f)));
+  scene.addPrimitive(
+      Primitive(std::make_shared<Sphere>(Vec3(-2, 0, 0), 1),
+                std::make_shared<DisneyPrincipledBRDF>(tex, 1, 1, 0, 0, 0, 0,
+                                                       0, 0, 0)));
+  scene.addPrimitive(Primitive(std::make_shared<Sphere>(Vec3(2, 0, 0), 1),
+                               std::make_shared<Glass>(1.5f, 0.2f)));
+  scene.build();
+  return scene;
+}
+
+}  // namespace
+
+TEST(Renderer, NoAllocations) {
+  if constexpr (!AllocationCounter::ENABLED) {
+    GTEST_SKIP() << "allocations are counted with COUNT_ALLOCATIONS";
+  }
+  const Scene scene = makeScene();
+
+  Renderer renderer(16, 16,
+                    std::make_shared<PinholeCamera>(Vec3(0, 1, 8),
+                                                    normalize(Vec3(0, -1, -8))),
+                    std::make_shared<PT>(), std::make_shared<UniformSampler>(),
+                    8);
+  renderer.render(scene, 4);
+  EXPECT_EQ(renderer.getRenderAllocations(), 0);
+
+  renderer.renderWithInLimitTime(scene, 100);
+  EXPECT_GT(renderer.getCompletedPasses(), 0);
+  EXPECT_EQ(renderer.getRenderAllocations(), 0);
+}
@@ -0,0 +1,158 @@
+#include "LTRE/core/scene.hpp"
+
+#include "LTRE/intersector/bvh.hpp"
+#include "LTRE/intersector/bvh8.hpp"
+#include "LTRE/intersector/linear-intersector.hpp"
+#include "LTRE/intersector/traversal-stats.hpp"
+#include "LTRE/light/sky/uniform-sky.hpp"
+#include "LTRE/shape/sphere.hpp"
+#include "gtest/gtest.h"
+#include "triangle-soup.hpp"
+
+using namespace LTRE;
+
+namespace {
+
+// triangle intersector which always fails to build and never hits, so that
+// scene only reports hits of triangles through its fallback
+class FailingIntersector : public LinearIntersector<SceneTriangle> {
+ public:
+  bool build() override { return false; }
+  bool intersect(const Ray&, IntersectInfo&) const override { return false; }
+  bool intersectP(const Ray&) const override { return false; }
+};
+
+// overlapping meshes and spheres, primitive is identified by base color
+Scene makeScene(Scene scene) {
+  const auto makeMaterial = [](float id) {
+    return std::make_shared<Diffuse>(
+        std::make_shared<UniformTexture<Vec3>>(Vec3(id)), 0.0f);
+  };
+
+  for (unsigned int m = 0; m < 8; ++m) {
+    const TriangleSoup soup(200, m);
+    const auto mesh = std::make_shared<Mesh>(
+        soup.positions, soup.indices, std::vector<Vec3>(),
+        std::vector<Vec2>(), std::vector<Vec3>(), std::vector<Vec3>(),
+        std::vector<Vec3>());
+    scene.addPrimitive(Primitive(mesh, makeMaterial(m)));
+  }
+  for (unsigned int s = 0; s < 3; ++s) {
+    const auto sphere = std::make_shared<Sphere>(
+        Vec3(0.5f * s - 0.5f, 0.0f, 0.0f), 0.2f);
+    scene.addPrimitive(Primitive(sphere, makeMaterial(8 + s)));
+  }
+
+  scene.build();
+  return scene;
+}
+
+Scene makeScene(bool flatten) {
+  return makeScene(
+      Scene(std::make_shared<BVH<Primitive, BVHSplitStrategy::SAH>>(),
+            std::make_shared<UniformSky>(Vec3(0)), flatten));
+}
+
+Scene makeScene(
+    const std::shared_ptr<Intersector<SceneTriangle>>& triangleIntersector) {
+  return makeScene(
+      Scene(std::make_shared<BVH<Primitive, BVHSplitStrategy::SAH>>(),
+            std::make_shared<UniformSky>(Vec3(0)), triangleIntersector));
+}
+
+// closest hits of random rays agree with those of scene without flattening
+void checkFlattened(const Scene& flattened) {
+  const Scene scene = makeScene(false);
+
+  std::mt19937 mt(0);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  for (int i = 0; i < 1000; ++i) {
+    const Ray ray(2.0f * Vec3(dist(mt), dist(mt), dist(mt)),
+                  normalize(Vec3(dist(mt), dist(mt), dist(mt))));
+    const float tmax = ray.tmax;
+
+    IntersectInfo info, infoRef;
+    const bool hit = flattened.intersect(ray, info);
+    ray.tmax = tmax;
+    const bool hitRef = scene.intersect(ray, infoRef);
+    ray.tmax = tmax;
+
+    EXPECT_EQ(hit, hitRef);
+    EXPECT_EQ(flattened.intersectP(ray), hitRef);
+    if (hit && hitRef) {
+      EXPECT_NEAR(info.t, infoRef.t, 1e-4f);
+      EXPECT_EQ(info.faceID, infoRef.faceID);
+      EXPECT_EQ(info.hitPrimitive->baseColor(info.surfaceInfo),
+                infoRef.hitPrimitive->baseColor(infoRef.surfaceInfo));
+    }
+  }
+}
+
+}  // namespace
+
+TEST(Scene, Flatten) { checkFlattened(makeScene(true)); }
+
+TEST(Scene, FlattenIntersector) {
+  using TriangleBVH8 = BVH8<SceneTriangle, BVHSplitStrategy::SAH>;
+  checkFlattened(makeScene(std::make_shared<TriangleBVH8>()));
+}
+
+TEST(Scene, FlattenFallback) {
+  // scene falls back to BVH when triangle intersector fails to build
+  checkFlattened(makeScene(std::make_shared<FailingIntersector>()));
+}
+
+TEST(Scene, FlattenTraversalStats) {
+  if constexpr (!TraversalStats::ENABLED) {
+    GTEST_SKIP() << "traversal is counted with TRAVERSAL_STATS";
+  }
+  const Scene flattened = makeScene(true);
+
+  // both trees of flattened scene are counted as one query
+  TraversalStats::reset();
+  const Ray ray(Vec3(0, 0, 5), Vec3(0, 0, -1));
+  IntersectInfo info;
+  ASSERT_TRUE(flattened.intersect(ray, info));
+  // NOTE: last query has cost of both trees, as heatmap of traversal cost
+  const TraversalCounters last = TraversalStats::lastQuery();
+  EXPECT_FALSE(flattened.intersectP(Ray(Vec3(0, 0, 5), Vec3(0, 0, 1))));
+
+  const TraversalStats::Report report = TraversalStats::collect();
+  EXPECT_EQ(report[TraversalQuery::CLOSEST].nQueries, 1);
+  EXPECT_EQ(report[TraversalQuery::OCCLUSION].nQueries, 1);
+  EXPECT_EQ(last.nodes, report[TraversalQuery::CLOSEST].total.nodes);
+  EXPECT_EQ(last.primitives, report[TraversalQuery::CLOSEST].total.primitives);
+}
+
+TEST(Scene, FlattenPacket) {
+  const Scene scene = makeScene(false);
+  const Scene flattened = makeScene(true);
+
+  std::mt19937 mt(0);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  for (int i = 0; i < 200; ++i) {
+    const Vec3 origin = 2.0f * Vec3(dist(mt), dist(mt), dist(mt));
+    RayPacket packet, packetRef;
+    for (int r = 0; r < RayPacket::SIZE; ++r) {
+      packet.rays[r] =
+          Ray(origin,
+              normalize(-origin + 0.5f * Vec3(dist(mt), dist(mt), dist(mt))));
+      packetRef.rays[r] = packet.rays[r];
+    }
+
+    IntersectInfo info[RayPacket::SIZE], infoRef[RayPacket::SIZE];
+    const uint32_t activeMask = (1u << RayPacket::SIZE) - 1;
+    const uint32_t hitMask =
+        flattened.intersectPacket(packet, activeMask, info);
+    const uint32_t hitMaskRef =
+        scene.intersectPacket(packetRef, activeMask, infoRef);
+
+    EXPECT_EQ(hitMask, hitMaskRef);
+    for (uint32_t bits = hitMask & hitMaskRef; bits > 0; bits &= bits - 1) {
+      const int r = std::countr_zero(bits);
+      EXPECT_NEAR(info[r].t, infoRef[r].t, 1e-4f);
+      EXPECT_EQ(info[r].hitPrimitive->baseColor(info[r].surfaceInfo),
+                infoRef[r].hitPrimitive->baseColor(infoRef[r].surfaceInfo));
+    }
+  }
+}
@@ -0,0 +1,103 @@
+#include "LTRE/core/tile-scheduler.hpp"
+
+#include <atomic>
+#include <memory>
+
+#include "gtest/gtest.h"
+
+using namespace LTRE;
+
+namespace {
+
+// every pixel is covered by exactly one tile, and each tile is run once
+void checkCoverage(unsigned int width, unsigned int height,
+                   unsigned int tileSize, TileOrder order) {
+  TileScheduler scheduler(width, height, tileSize, order);
+
+  std::vector<int> covered(width * height, 0);
+  for (const Tile& tile : scheduler.getTiles()) {
+    EXPECT_LE(tile.x1 - tile.x0, tileSize);
+    EXPECT_LE(tile.y1 - tile.y0, tileSize);
+    for (unsigned int j = tile.y0; j < tile.y1; ++j) {
+      for (unsigned int i = tile.x0; i < tile.x1; ++i) {
+        covered[i + width * j]++;
+      }
+    }
+  }
+  for (const int c : covered) {
+    EXPECT_EQ(c, 1);
+  }
+
+  // NOTE: run twice, since work ranges are reused between calls
+  for (int run = 0; run < 2; ++run) {
+    const auto visited =
+        std::make_unique<std::atomic<int>[]>(width * height);
+    std::atomic<bool> validThread{true};
+    scheduler.parallelForEach([&](const Tile& tile, int thread) {
+      if (thread < 0 || thread >= TileScheduler::maxThreads()) {
+        validThread = false;
+      }
+      for (unsigned int j = tile.y0; j < tile.y1; ++j) {
+        for (unsigned int i = tile.x0; i < tile.x1; ++i) {
+          visited[i + width * j]++;
+        }
+      }
+    });
+    EXPECT_TRUE(validThread);
+    for (unsigned int p = 0; p < width * height; ++p) {
+      EXPECT_EQ(visited[p].load(), 1);
+    }
+  }
+}
+
+}  // namespace
+
+TEST(TileScheduler, Coverage) {
+  for (const TileOrder order :
+       {TileOrder::SCANLINE, TileOrder::MORTON, TileOrder::HILBERT}) {
+    checkCoverage(512, 512, 32, order);
+    checkCoverage(130, 97, 16, order);
+    checkCoverage(7, 3, 64, order);
+  }
+}
+
+TEST(TileScheduler, HilbertOrderIsContinuous) {
+  // consecutive tiles along Hilbert curve share an edge
+  const TileScheduler scheduler(256, 256, 16, TileOrder::HILBERT);
+  const std::vector<Tile>& tiles = scheduler.getTiles();
+  for (std::size_t t = 1; t < tiles.size(); ++t) {
+    const int dx = std::abs(int(tiles[t].x0) - int(tiles[t - 1].x0));
+    const int dy = std::abs(int(tiles[t].y0) - int(tiles[t - 1].y0));
+    EXPECT_EQ(dx + dy, 16);
+  }
+}
+
+TEST(TileScheduler, RepeatUntilCancelled) {
+  // tiles are repeated pass by pass, and the same tile never runs
+  // concurrently
+  TileScheduler scheduler(130, 97, 16, TileOrder::HILBERT);
+  const std::size_t nTiles = scheduler.getTiles().size();
+  const auto passes = std::make_unique<std::atomic<int>[]>(nTiles);
+  const auto running = std::make_unique<std::atomic<bool>[]>(nTiles);
+  std::atomic<bool> overlapped{false};
+  std::atomic<int> nCalls{0};
+
+  const CancellationToken token;
+  scheduler.parallelRepeat(
+      [&](std::size_t tileIdx, int) {
+        if (running[tileIdx].exchange(true)) overlapped = true;
+        passes[tileIdx]++;
+        running[tileIdx] = false;
+        if (++nCalls >= int(10 * nTiles)) token.cancel();
+      },
+      token);
+
+  EXPECT_FALSE(overlapped);
+  // NOTE: each thread may have taken a tile before cancellation, and passes
+  // of runs of tiles may differ by one
+  const int slack = (TileScheduler::maxThreads() + nTiles - 1) / nTiles + 1;
+  for (std::size_t t = 0; t < nTiles; ++t) {
+    EXPECT_GE(passes[t].load(), 10 - slack);
+    EXPECT_LE(passes[t].load(), 10 + slack);
+  }
+}
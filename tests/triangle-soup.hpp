@@ -0,0 +1,360 @@
+#ifndef _LTRE_TESTS_TRIANGLE_SOUP_H
+#define _LTRE_TESTS_TRIANGLE_SOUP_H
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <random>
+
+#include "LTRE/intersector/bvh-cache.hpp"
+#include "LTRE/intersector/linear-intersector.hpp"
+#include "LTRE/shape/mesh.hpp"
+#include "gtest/gtest.h"
+
+namespace LTRE {
+
+// random triangle soup in [-1, 1]^3
+struct TriangleSoup {
+  std::vector<Vec3> positions;
+  std::vector<unsigned int> indices;
+  std::vector<MeshTriangle> triangles;
+
+  TriangleSoup(unsigned int nFaces, unsigned int seed) {
+    std::mt19937 mt(seed);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    for (unsigned int f = 0; f < nFaces; ++f) {
+      const Vec3 center(dist(mt), dist(mt), dist(mt));
+      for (int k = 0; k < 3; ++k) {
+        positions.push_back(center +
+                            0.1f * Vec3(dist(mt), dist(mt), dist(mt)));
+        indices.push_back(3 * f + k);
+      }
+    }
+    for (unsigned int f = 0; f < nFaces; ++f) {
+      triangles.emplace_back(positions.data(), indices.data(), f);
+    }
+  }
+};
+
+// tilted grid of triangles sharing edges and vertices
+struct TriangleGrid {
+  std::vector<Vec3> positions;
+  std::vector<unsigned int> indices;
+  std::vector<MeshTriangle> triangles;
+
+  TriangleGrid(unsigned int n) {
+    const Vec3 a = normalize(Vec3(1, 0.3, 0.2));
+    const Vec3 b = normalize(cross(a, Vec3(0.1, 0.2, 1)));
+    for (unsigned int j = 0; j <= n; ++j) {
+      for (unsigned int i = 0; i <= n; ++i) {
+        positions.push_back((2.0f * i / n - 1.0f) * a +
+                            (2.0f * j / n - 1.0f) * b);
+      }
+    }
+    for (unsigned int j = 0; j < n; ++j) {
+      for (unsigned int i = 0; i < n; ++i) {
+        const unsigned int v00 = i + (n + 1) * j;
+        const unsigned int v10 = v00 + 1;
+        const unsigned int v01 = v00 + n + 1;
+        const unsigned int v11 = v01 + 1;
+        for (const unsigned int v : {v00, v10, v11, v00, v11, v01}) {
+          indices.push_back(v);
+        }
+      }
+    }
+    for (unsigned int f = 0; f < indices.size() / 3; ++f) {
+      triangles.emplace_back(positions.data(), indices.data(), f);
+    }
+  }
+};
+
+// triangles growing geometrically away from the origin, splitting them at
+// the center of their centroids peels only one triangle per level
+struct TriangleChain {
+  static constexpr float RATIO = 3.0f;
+
+  std::vector<Vec3> positions;
+  std::vector<unsigned int> indices;
+  std::vector<MeshTriangle> triangles;
+
+  TriangleChain(unsigned int nFaces) {
+    float s = 1.0f;
+    for (unsigned int f = 0; f < nFaces; ++f) {
+      const Vec3 center(s, s, 0.0f);
+      positions.push_back(center + 0.1f * s * Vec3(-1.0f, -1.0f, 0.0f));
+      positions.push_back(center + 0.1f * s * Vec3(1.0f, -1.0f, 0.0f));
+      positions.push_back(center + 0.1f * s * Vec3(0.0f, 1.0f, 0.0f));
+      for (int k = 0; k < 3; ++k) {
+        indices.push_back(3 * f + k);
+      }
+      s *= RATIO;
+    }
+    for (unsigned int f = 0; f < nFaces; ++f) {
+      triangles.emplace_back(positions.data(), indices.data(), f);
+    }
+  }
+
+  // ray hitting center of the face from above
+  Ray rayToFace(unsigned int faceID) const {
+    const Vec3 center = (positions[3 * faceID] + positions[3 * faceID + 1] +
+                         positions[3 * faceID + 2]) /
+                        3.0f;
+    return Ray(center + Vec3(0.0f, 0.0f, 1.0f), Vec3(0.0f, 0.0f, -1.0f));
+  }
+};
+
+// build intersector over triangle chain, which is deep when split naively,
+// then shoot rays at every face
+template <typename T>
+void checkDeepChain(unsigned int nFaces) {
+  const TriangleChain chain(nFaces);
+  T intersector(chain.triangles);
+  intersector.build();
+
+  for (unsigned int f = 0; f < nFaces; ++f) {
+    const Ray ray = chain.rayToFace(f);
+    IntersectInfo info;
+    EXPECT_TRUE(intersector.intersect(ray, info));
+    EXPECT_EQ(info.faceID, f);
+    ray.tmax = std::numeric_limits<float>::max();
+    EXPECT_TRUE(intersector.intersectP(ray));
+  }
+}
+
+// shoot rays at shared edges and vertices inside of grid, all of them must
+// hit the grid
+template <typename T>
+void checkWatertight(unsigned int n) {
+  const TriangleGrid grid(n);
+  T intersector(grid.triangles);
+  intersector.build();
+  LinearIntersector<MeshTriangle> reference(grid.triangles);
+
+  const Vec3 normal =
+      normalize(cross(grid.positions[1] - grid.positions[0],
+                      grid.positions[n + 1] - grid.positions[0]));
+
+  std::mt19937 mt(n);
+  // NOTE: edges of inner cells are shared by two faces
+  std::uniform_int_distribution<unsigned int> cell(1, n - 2);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  for (int k = 0; k < 10000; ++k) {
+    // target on an edge(or a vertex) of random face
+    const unsigned int faceID = 2 * (cell(mt) + n * cell(mt)) + k % 2;
+    const auto [v0, v1, v2] = grid.triangles[faceID].getPositions();
+    const Vec3 vertices[3] = {v0, v1, v2};
+    const int e = k % 3;
+    const float s = k % 4 == 0 ? 0.0f : 0.5f * (dist(mt) + 1.0f);
+    const Vec3 target = (1.0f - s) * vertices[e] + s * vertices[(e + 1) % 3];
+
+    Vec3 dir = normalize(Vec3(dist(mt), dist(mt), dist(mt)));
+    if (std::abs(dot(dir, normal)) < 0.1f) dir = normal;
+    const Ray ray(target - 3.0f * dir, dir);
+
+    IntersectInfo info;
+    EXPECT_TRUE(intersector.intersect(ray, info));
+    ray.tmax = std::numeric_limits<float>::max();
+    EXPECT_TRUE(intersector.intersectP(ray));
+    ray.tmax = std::numeric_limits<float>::max();
+    EXPECT_TRUE(reference.intersect(ray, info));
+  }
+}
+
+// compare built intersector with linear intersector over the same triangles
+template <typename T>
+void compareWithLinearIntersector(const T& intersector,
+                                  const std::vector<MeshTriangle>& triangles) {
+  LinearIntersector<MeshTriangle> reference(triangles);
+
+  std::mt19937 mt(0);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  for (int i = 0; i < 1000; ++i) {
+    const Ray ray(2.0f * Vec3(dist(mt), dist(mt), dist(mt)),
+                  normalize(Vec3(dist(mt), dist(mt), dist(mt))));
+    const float tmax = ray.tmax;
+
+    IntersectInfo info, infoRef;
+    const bool hit = intersector.intersect(ray, info);
+    ray.tmax = tmax;
+    const bool hitRef = reference.intersect(ray, infoRef);
+    ray.tmax = tmax;
+    const bool hitP = intersector.intersectP(ray);
+
+    EXPECT_EQ(hit, hitRef);
+    EXPECT_EQ(hitP, hitRef);
+    if (hit && hitRef) {
+      // NOTE: SIMD kernel rounds differently from scalar one
+      EXPECT_NEAR(info.t, infoRef.t, 1e-4f);
+      EXPECT_NEAR(info.barycentric[0], infoRef.barycentric[0], 1e-4f);
+      EXPECT_NEAR(info.barycentric[1], infoRef.barycentric[1], 1e-4f);
+      EXPECT_EQ(info.faceID, infoRef.faceID);
+    }
+  }
+}
+
+template <typename T>
+void compareWithLinearIntersector(unsigned int nFaces) {
+  const TriangleSoup soup(nFaces, nFaces);
+  T intersector(soup.triangles);
+  intersector.build();
+  compareWithLinearIntersector(intersector, soup.triangles);
+}
+
+// trace coherent shadow rays, whose occluder is likely to be the last one,
+// then compare occlusion with linear intersector
+template <typename T>
+void compareOcclusionWithLinearIntersector(unsigned int nFaces) {
+  const TriangleSoup soup(nFaces, nFaces);
+  T intersector(soup.triangles);
+  intersector.build();
+  LinearIntersector<MeshTriangle> reference(soup.triangles);
+
+  std::mt19937 mt(0);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  for (int i = 0; i < 100; ++i) {
+    const Vec3 origin = 2.0f * Vec3(dist(mt), dist(mt), dist(mt));
+    const Vec3 target = Vec3(dist(mt), dist(mt), dist(mt));
+    for (int j = 0; j < 10; ++j) {
+      const Vec3 p = target + 0.05f * Vec3(dist(mt), dist(mt), dist(mt));
+      const Ray ray(origin, normalize(p - origin));
+      ray.tmax = length(p - origin);
+      EXPECT_EQ(intersector.intersectP(ray), reference.intersectP(ray));
+    }
+  }
+}
+
+// trace coherent and incoherent packets with partial active masks, then
+// compare hits with linear intersector
+template <typename T>
+void comparePacketWithLinearIntersector(unsigned int nFaces) {
+  const TriangleSoup soup(nFaces, nFaces);
+  T intersector(soup.triangles);
+  intersector.build();
+  LinearIntersector<MeshTriangle> reference(soup.triangles);
+
+  std::mt19937 mt(0);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  for (int i = 0; i < 200; ++i) {
+    // NOTE: odd packets have rays with random directions
+    const float spread = i % 2 == 0 ? 0.05f : 1.0f;
+    const Vec3 origin = 2.0f * Vec3(dist(mt), dist(mt), dist(mt));
+    const Vec3 direction = -origin;
+    RayPacket packet;
+    for (int r = 0; r < RayPacket::SIZE; ++r) {
+      packet.rays[r] = Ray(
+          origin, normalize(direction +
+                            spread * Vec3(dist(mt), dist(mt), dist(mt))));
+    }
+    const uint32_t activeMask =
+        i % 3 == 0 ? (1u << RayPacket::SIZE) - 1 : mt() & 0xff;
+
+    IntersectInfo info[RayPacket::SIZE];
+    const uint32_t hitMask =
+        intersector.intersectPacket(packet, activeMask, info);
+    EXPECT_EQ(hitMask & ~activeMask, 0u);
+
+    for (int r = 0; r < RayPacket::SIZE; ++r) {
+      if (!(activeMask & (1u << r))) continue;
+      const Ray ray(packet.rays[r].origin, packet.rays[r].direction);
+      IntersectInfo infoRef;
+      const bool hitRef = reference.intersect(ray, infoRef);
+      const bool hit = hitMask & (1u << r);
+
+      EXPECT_EQ(hit, hitRef);
+      if (hit && hitRef) {
+        EXPECT_NEAR(info[r].t, infoRef.t, 1e-4f);
+        EXPECT_EQ(info[r].faceID, infoRef.faceID);
+      }
+    }
+  }
+}
+
+// deform triangle soup after build, then compare refitted intersector with
+// linear intersector
+template <typename T>
+void compareRefitWithLinearIntersector(unsigned int nFaces,
+                                       float rebuildThreshold) {
+  TriangleSoup soup(nFaces, nFaces);
+  T intersector(soup.triangles);
+  intersector.setRebuildThreshold(rebuildThreshold);
+  intersector.build();
+
+  // NOTE: triangles point to positions of soup, so they move together
+  std::mt19937 mt(nFaces);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  for (Vec3& p : soup.positions) {
+    p = 0.8f * p + 0.2f * Vec3(dist(mt), dist(mt), dist(mt));
+  }
+  intersector.refit();
+
+  compareWithLinearIntersector(intersector, soup.triangles);
+}
+
+// save intersector into cache, then compare intersector loaded from it with
+// linear intersector
+template <typename T>
+void compareCachedWithLinearIntersector(unsigned int nFaces) {
+  const TriangleSoup soup(nFaces, nFaces);
+  // NOTE: test binaries may run at once, so that file name is made unique
+  const std::string suiteName = ::testing::UnitTest::GetInstance()
+                                    ->current_test_info()
+                                    ->test_suite_name();
+  const std::filesystem::path cachePath =
+      std::filesystem::temp_directory_path() /
+      ("ltre-" + suiteName + "-" + std::to_string(nFaces) + ".bvh");
+  const auto makePrimitive = [&](unsigned int faceID) {
+    return soup.triangles[faceID];
+  };
+  {
+    T intersector(soup.triangles);
+    intersector.build();
+    ASSERT_TRUE(intersector.saveCache(cachePath, nFaces));
+  }
+
+  // cache referring faces out of mesh is rejected
+  T intersector;
+  EXPECT_FALSE(
+      intersector.loadCache(cachePath, nFaces + 1, nFaces, makePrimitive));
+  EXPECT_FALSE(
+      intersector.loadCache(cachePath, nFaces, nFaces - 1, makePrimitive));
+
+  // cache whose nodes are broken is rejected
+  const std::filesystem::path brokenPath = cachePath.string() + ".broken";
+  std::filesystem::copy_file(cachePath, brokenPath,
+                             std::filesystem::copy_options::overwrite_existing);
+  {
+    std::fstream stream(brokenPath,
+                        std::ios::binary | std::ios::in | std::ios::out);
+    BVHCacheHeader header;
+    stream.read(reinterpret_cast<char*>(&header), sizeof(header));
+    const std::vector<char> garbage(header.nNodes * header.nodeSize, '\xff');
+    stream.seekp(BVHCacheFile::NODES_OFFSET);
+    stream.write(garbage.data(), garbage.size());
+  }
+  EXPECT_FALSE(
+      intersector.loadCache(brokenPath, nFaces, nFaces, makePrimitive));
+
+  // cache whose counts wrap size of file around is rejected
+  std::filesystem::copy_file(cachePath, brokenPath,
+                             std::filesystem::copy_options::overwrite_existing);
+  {
+    std::fstream stream(brokenPath,
+                        std::ios::binary | std::ios::in | std::ios::out);
+    BVHCacheHeader header;
+    stream.read(reinterpret_cast<char*>(&header), sizeof(header));
+    header.nPrimitives += uint64_t(1) << 62;
+    stream.seekp(0);
+    stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  }
+  EXPECT_FALSE(
+      intersector.loadCache(brokenPath, nFaces, nFaces, makePrimitive));
+  std::filesystem::remove(brokenPath);
+
+  ASSERT_TRUE(intersector.loadCache(cachePath, nFaces, nFaces, makePrimitive));
+  std::filesystem::remove(cachePath);
+
+  compareWithLinearIntersector(intersector, soup.triangles);
+}
+
+}  // namespace LTRE
+
+#endif
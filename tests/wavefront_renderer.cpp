@@ -0,0 +1,79 @@
+#include "LTRE/core/wavefront-renderer.hpp"
+
+#include "LTRE/camera/pinhole-camera.hpp"
+#include "LTRE/core/renderer.hpp"
+#include "LTRE/integrator/nee.hpp"
+#include "LTRE/intersector/bvh.hpp"
+#include "LTRE/light/area-light.hpp"
+#include "LTRE/light/sky/uniform-sky.hpp"
+#include "LTRE/sampling/uniform.hpp"
+#include "LTRE/shape/plane.hpp"
+#include "LTRE/shape/sphere.hpp"
+#include "gtest/gtest.h"
+
+using namespace LTRE;
+
+namespace {
+
+// spheres of several materials on a plane, lit by area light and sky
+Scene makeScene() {
+  Scene scene(std::make_shared<BVH<Primitive, BVHSplitStrategy::SAH>>(),
+              std::make_shared<UniformSky>(Vec3(0.5)));
+  const auto white = std::make_shared<UniformTexture<Vec3>>(Vec3(0.8));
+  const auto red = std::make_shared<UniformTexture<Vec3>>(Vec3(0.8, 0.2, 0.2));
+  const auto diffuse = std::make_shared<Diffuse>(white, 0.2f);
+  scene.addPrimitive(
+      Primitive(std::make_shared<Plane>(Vec3(-5, -1, -5), Vec3(0, 0, 10),
+                                        Vec3(10, 0, 0)),
+                diffuse));
+  scene.addPrimitive(
+      Primitive(std::make_shared<Sphere>(Vec3(0), 1),
+                std::make_shared<DisneyPrincipledBRDF>(red, 0.5, 0, 0, 0, 0,
+                                                       0.5, 0, 0, 0)));
+  scene.addPrimitive(Primitive(std::make_shared<Sphere>(Vec3(2.5, 0, 0), 1),
+                               std::make_shared<Metal>(red, 0.3f)));
+  const auto lightShape =
+      std::make_shared<Plane>(Vec3(-1, 4, -1), Vec3(2, 0, 0), Vec3(0, 0, 2));
+  scene.addPrimitive(Primitive(
+      lightShape, diffuse,
+      std::make_shared<AreaLight>(
+          std::make_shared<UniformTexture<Vec3>>(Vec3(10)), lightShape)));
+  scene.build();
+  return scene;
+}
+
+}  // namespace
+
+TEST(WavefrontRenderer, SameAsNEE) {
+  // NOTE: enough pixels to sort paths of several threads in parallel
+  const unsigned int width = 64, height = 40;
+  const unsigned int samples = 2;
+  const Scene scene = makeScene();
+  const Vec3 camPos(0, 3, 10);
+  const auto camera = std::make_shared<PinholeCamera>(
+      camPos, normalize(Vec3(0, 0.5, 0) - camPos));
+  const auto sampler = std::make_shared<UniformSampler>();
+
+  Renderer renderer(width, height, camera, std::make_shared<NEE>(), sampler);
+  renderer.render(scene, samples);
+  const Image<Vec3>& reference = renderer.getAOV().beauty;
+
+  // NOTE: queue smaller than number of pixels reuses slots of finished paths
+  for (const unsigned int queueSize : {100u, width * height}) {
+    WavefrontRenderer wavefront(width, height, camera, sampler, 100,
+                                queueSize);
+    wavefront.render(scene, samples);
+    const Image<Vec3>& image = wavefront.getBeauty();
+
+    for (unsigned int j = 0; j < height; ++j) {
+      for (unsigned int i = 0; i < width; ++i) {
+        const Vec3 expected = reference.getPixel(i, j);
+        const Vec3 actual = image.getPixel(i, j);
+        for (int c = 0; c < 3; ++c) {
+          EXPECT_NEAR(actual[c], expected[c],
+                      1e-4f * std::max(std::abs(expected[c]), 1.0f));
+        }
+      }
+    }
+  }
+}